@@ -0,0 +1,211 @@
+// baseline.c
+// Calibrated per target baselines and the detection model they feed
+//
+// Copyright (C) 2010 Ricardo Gameiro
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+
+#include "baseline.h"
+
+
+// identify a target by its path and kind (64 bit FNV-1a of both)
+uint64_t bsl_id( const char * path, int type ) {
+
+    uint64_t h = (uint64_t)0xcbf29ce484222325UL;
+
+    for( ; *path; path++ ) {
+        h ^= (unsigned char)*path;
+        h *= (uint64_t)0x100000001b3UL;
+    }
+    h ^= (unsigned char)type;
+    h *= (uint64_t)0x100000001b3UL;
+    return( h );
+}
+
+
+// compare two baseline records by id, for qsort and bsearch
+int bsl_cmp( const void * a, const void * b ) {
+
+    uint64_t ia = ( (const struct bsl_target *)a )->id;
+    uint64_t ib = ( (const struct bsl_target *)b )->id;
+
+    return( ( ia > ib ) - ( ia < ib ) );
+}
+
+
+// probability of a run failing, i.e. the binomial probability of fewer
+// than 'successes' out of 'checks' checks succeeding (a run stops checking
+// once it has enough successes, which doesn't change whether it fails)
+double bsl_run_failure( double p, int checks, int successes ) {
+
+    int k, i;
+    double q = 0.0, term;
+
+    for( k = 0; k < successes; k++ ) {
+        // C( checks, k ) * ( 1 - p )^k * p^( checks - k )
+        term = 1.0;
+        for( i = 0; i < k; i++ )
+            term *= (double)( checks - i ) / ( i + 1 ) * ( 1.0 - p );
+        for( i = 0; i < checks - k; i++ )
+            term *= p;
+        q += term;
+    }
+    return( q );
+}
+
+
+// expected false alarms a year, i.e. the number of runs in a year times the
+// probability of a run starting a streak of 'runs' failed runs (following a
+// passed one)
+double bsl_false_alarms( double p, int checks, int successes, int runs,
+                         int interval ) {
+
+    int r;
+    double q = bsl_run_failure( p, checks, successes ), streak = 1.0 - q;
+
+    for( r = 0; r < runs; r++ )
+        streak *= q;
+    return( 365.0 * 86400.0 / interval * streak );
+}
+
+
+// worst case detection time in ms, a target lost right after its check
+// waits up to an interval for the next one, whose step fails its first run
+// once the deadline expires, and one more fails every interval after that
+int bsl_detection( int runs, int interval, int deadline ) {
+
+    return( runs * interval * 1000 + deadline );
+}
+
+
+// go through every configuration the controller accepts, keeping the one
+// making the fewest checks a second (a healthy run stops at 'successes'
+// checks) which meets both goals, and the one with the fewest false alarms
+// which meets the detection goal, in case none meets both
+int bsl_recommend( double p, int deadline, int detection, double false_alarms,
+                   struct bsl_config * config ) {
+
+    int c, s, r, i, found = 0;
+    double fa, cost, best_cost = 0.0;
+    struct bsl_config cand;
+
+    memset( config, 0, sizeof( *config ) );
+
+    for( i = 1; i <= BSL_INTERVAL_MAX; i++ ) {
+        for( r = 1; r <= BSL_RUNS_MAX; r++ ) {
+
+            if( bsl_detection( r, i, deadline ) > detection )
+                break;
+
+            for( c = 1; c <= BSL_CHECKS_MAX; c++ ) {
+                for( s = 1; s <= c; s++ ) {
+
+                    fa = bsl_false_alarms( p, c, s, r, i );
+                    cost = (double)s / i;
+                    cand.checks = c;
+                    cand.successes = s;
+                    cand.runs = r;
+                    cand.interval = i;
+                    cand.deadline = deadline;
+                    cand.detection = bsl_detection( r, i, deadline );
+                    cand.false_alarms = fa;
+
+                    if( fa <= false_alarms ) {
+                        // fewest checks a second, then quickest detection,
+                        // then fewest checks a run
+                        if( !found || ( cost < best_cost ) ||
+                            ( ( cost == best_cost ) &&
+                              ( ( cand.detection < config->detection ) ||
+                                ( ( cand.detection == config->detection ) &&
+                                  ( c < config->checks ) ) ) ) ) {
+                            *config = cand;
+                            best_cost = cost;
+                        }
+                        found = 1;
+                    } else if( !found && ( !config->checks ||
+                                           ( fa < config->false_alarms ) ) )
+                        *config = cand;
+                }
+            }
+        }
+    }
+
+    return( found ? 0 : -1 );
+}
+
+
+// write a baseline file, header first
+int bsl_write( char * path, struct bsl_header * header,
+               struct bsl_target * target ) {
+
+    int fd;
+    size_t len = header->targets * sizeof( struct bsl_target );
+
+    header->magic = BSL_MAGIC;
+    header->version = BSL_VERSION;
+    if( ( fd = open( path, O_WRONLY | O_CREAT | O_TRUNC, 0644 ) ) == EOF )
+        return( -1 );
+    if( ( write( fd, header, sizeof( *header ) ) != sizeof( *header ) ) ||
+        ( write( fd, target, len ) != (ssize_t)len ) ) {
+        close( fd );
+        return( -1 );
+    }
+    return( close( fd ) );
+}
+
+
+// read a baseline file, checking it's one we know how to read
+int bsl_read( char * path, struct bsl_header * header,
+              struct bsl_target * target, int max ) {
+
+    int fd, n;
+    ssize_t len;
+
+    if( ( fd = open( path, O_RDONLY ) ) == EOF )
+        return( -1 );
+    if( read( fd, header, sizeof( *header ) ) != sizeof( *header ) ) {
+        close( fd );
+        errno = EINVAL;
+        return( -1 );
+    }
+    if( ( header->magic != BSL_MAGIC ) || ( header->version != BSL_VERSION ) ) {
+        close( fd );
+        errno = EINVAL;
+        return( -1 );
+    }
+    // at most max records, both counts compared as unsigned once max is
+    n = ( max < 0 ) ? 0 : max;
+    if( header->targets < (uint32_t)n )
+        n = (int)header->targets;
+    len = n * sizeof( struct bsl_target );
+    if( read( fd, target, len ) != len ) {
+        close( fd );
+        errno = EINVAL;
+        return( -1 );
+    }
+    close( fd );
+    return( n );
+}
@@ -0,0 +1,125 @@
+// baseline.h
+// Calibrated per target baselines and the detection model they feed
+//
+// Copyright (C) 2010 Ricardo Gameiro
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+
+#ifndef BASELINE_H
+#define BASELINE_H
+
+#include <sys/types.h>
+
+// baseline file identification, the file is a header followed by 'targets'
+// records, in the writer's byte order (it's meant for the same machine)
+#define BSL_MAGIC       0x4d544c42      // 'MTLB'
+#define BSL_VERSION     2
+
+// shortest step deadline recommended, in ms, however fast a target was
+#define BSL_DEADLINE_MIN 50
+
+// the limits the controller accepts, which the recommendation stays within
+#define BSL_CHECKS_MAX   10
+#define BSL_RUNS_MAX     10
+#define BSL_INTERVAL_MAX 60
+
+// a configuration, as recommended for a detection time goal and a false
+// alarm rate goal, along with what it's expected to achieve
+struct bsl_config {
+    int checks;                          // checks per run
+    int successes;                       // successes for a run to pass
+    int runs;                            // failed runs threshold
+    int interval;                        // interval between runs in s
+    int deadline;                        // step deadline in ms
+    int detection;                       // worst case detection time in ms
+    double false_alarms;                 // expected per target a year
+};
+
+// the header of a baseline file
+struct bsl_header {
+    uint32_t magic;                      // BSL_MAGIC
+    uint32_t version;                    // BSL_VERSION
+    uint64_t time;                       // calibration start, s since epoch
+    uint32_t period;                     // calibration length in s
+    uint32_t targets;                    // num of target records
+    int32_t checks;                      // recommended configuration (0
+    int32_t successes;                   // checks when none met the goals)
+    int32_t runs;
+    int32_t interval;
+    int32_t deadline;
+    int32_t pad;
+};
+
+// the baseline of a target, latencies in us
+struct bsl_target {
+    uint64_t id;                         // bsl_id() of its path and kind
+    uint32_t probes;                     // num of probes made
+    uint32_t failures;                   // num of them failed
+    uint32_t p50;                        // latency quantiles, and longest
+    uint32_t p99;
+    uint32_t p999;
+    uint32_t max;
+    uint32_t deadline;                   // its own step deadline in ms
+    int32_t type;                        // kind of target
+    uint32_t query;                      // its own query step deadline in
+                                         // ms (read targets, 0 for none)
+    uint32_t pad;
+};
+
+// identify a target by its path and kind, so that baselines are only
+// applied to the targets they were measured on
+uint64_t bsl_id( const char * path, int type );
+
+// compare two baseline records (struct bsl_target) by id, for qsort and
+// bsearch
+int bsl_cmp( const void * a, const void * b );
+
+// probability of a run failing, i.e. of fewer than 'successes' out of
+// 'checks' checks succeeding, when each one fails with probability p
+double bsl_run_failure( double p, int checks, int successes );
+
+// expected false alarms a year, i.e. of 'runs' consecutive failed runs, one
+// run every 'interval' s, for a healthy target whose checks fail with
+// probability p
+double bsl_false_alarms( double p, int checks, int successes, int runs,
+                         int interval );
+
+// worst case time, in ms, from a target being lost to the threshold being
+// reached: the step deadline, then a failed run every interval
+int bsl_detection( int runs, int interval, int deadline );
+
+// find the configuration which detects a lost target within 'detection' ms
+// and raises at most 'false_alarms' false alarms a year, making the fewest
+// checks a second, returns 0 if one was found (else *config is the one with
+// the fewest false alarms within the detection goal, or checks is 0 if the
+// deadline alone misses it)
+int bsl_recommend( double p, int deadline, int detection, double false_alarms,
+                   struct bsl_config * config );
+
+// write a baseline file, returns 0 on success
+int bsl_write( char * path, struct bsl_header * header,
+               struct bsl_target * target );
+
+// read a baseline file, up to 'max' target records, returns the num of
+// records read (or -1)
+int bsl_read( char * path, struct bsl_header * header,
+              struct bsl_target * target, int max );
+
+
+#endif // ifndef BASELINE_H
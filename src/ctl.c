@@ -0,0 +1,187 @@
+// ctl.c
+// Control socket protocol between the muttley server and its clients
+//
+// Copyright (C) 2010 Ricardo Gameiro
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+
+#include "ctl.h"
+
+
+// fill in a unix socket address for 'path', returns 0 on success
+int ctl_addr( char * path, struct sockaddr_un * addr ) {
+
+    if( strlen( path ) >= sizeof( addr->sun_path ) ) {
+        errno = ENAMETOOLONG;
+        return( -1 );
+    }
+    memset( addr, 0, sizeof( *addr ) );
+    addr->sun_family = AF_UNIX;
+    strcpy( addr->sun_path, path );
+    return( 0 );
+}
+
+
+// create the server's socket, only root may connect to it
+int ctl_listen( char * path ) {
+
+    int fd;
+    struct sockaddr_un addr;
+
+    if( ctl_addr( path, &addr ) ||
+        ( fd = socket( AF_UNIX, SOCK_STREAM, 0 ) ) == EOF )
+        return( -1 );
+
+    unlink( path );
+    if( bind( fd, (struct sockaddr *)&addr, sizeof( addr ) ) == EOF ||
+        chmod( path, S_IRUSR | S_IWUSR ) == EOF ||
+        listen( fd, SOMAXCONN ) == EOF ) {
+        close( fd );
+        return( -1 );
+    }
+
+    return( fd );
+}
+
+
+// connect to the server's socket
+int ctl_connect( char * path ) {
+
+    int fd;
+    struct sockaddr_un addr;
+
+    if( ctl_addr( path, &addr ) ||
+        ( fd = socket( AF_UNIX, SOCK_STREAM, 0 ) ) == EOF )
+        return( -1 );
+
+    if( connect( fd, (struct sockaddr *)&addr, sizeof( addr ) ) == EOF ) {
+        close( fd );
+        return( -1 );
+    }
+
+    return( fd );
+}
+
+
+// read exactly len bytes, returns 0 on success
+int ctl_read( int fd, void * data, uint32_t len ) {
+
+    ssize_t n;
+    char * p = data;
+
+    while( len ) {
+        if( ( n = read( fd, p, len ) ) <= 0 ) {
+            if( ( n < 0 ) && ( errno == EINTR ) )
+                continue;
+            if( !n )
+                errno = ECONNRESET;
+            return( -1 );
+        }
+        p += n;
+        len -= n;
+    }
+
+    return( 0 );
+}
+
+
+// send the header and the payload at once, in a single write when it fits
+// in the socket's buffer
+int ctl_send( int fd, int op, int result, int error, void * data,
+              uint32_t len ) {
+
+    ssize_t n;
+    struct ctl_hdr hdr;
+    struct iovec iov[ 2 ];
+    int c = 0;
+
+    hdr.magic = CTL_MAGIC;
+    hdr.version = CTL_VERSION;
+    hdr.op = op;
+    hdr.result = result;
+    hdr.error = error;
+    hdr.len = len;
+
+    iov[ 0 ].iov_base = (char *)&hdr;
+    iov[ 0 ].iov_len = sizeof( hdr );
+    iov[ 1 ].iov_base = data;
+    iov[ 1 ].iov_len = len;
+
+    while( c < 2 ) {
+        if( ( n = writev( fd, &iov[ c ], 2 - c ) ) < 0 ) {
+            if( errno == EINTR )
+                continue;
+            return( -1 );
+        }
+        // skip what was written, possibly part of an iovec
+        while( ( c < 2 ) && ( n >= (ssize_t)iov[ c ].iov_len ) )
+            n -= iov[ c++ ].iov_len;
+        if( c < 2 ) {
+            iov[ c ].iov_base = (char *)iov[ c ].iov_base + n;
+            iov[ c ].iov_len -= n;
+        }
+    }
+
+    return( 0 );
+}
+
+
+// receive a message, checking its header
+int ctl_recv( int fd, struct ctl_hdr * hdr, void * data, uint32_t size ) {
+
+    if( ctl_read( fd, hdr, sizeof( *hdr ) ) )
+        return( -1 );
+    if( ( hdr->magic != CTL_MAGIC ) || ( hdr->version != CTL_VERSION ) ||
+        ( hdr->len > size ) ) {
+        errno = EPROTO;
+        return( -1 );
+    }
+
+    return( ctl_read( fd, data, hdr->len ) );
+}
+
+
+// a request and its reply
+int ctl_call( int fd, int op, void * req, uint32_t req_len, void * rsp,
+              uint32_t rsp_size, int * result, int * error ) {
+
+    struct ctl_hdr hdr;
+
+    if( ctl_send( fd, op, 0, 0, req, req_len ) ||
+        ctl_recv( fd, &hdr, rsp, rsp_size ) )
+        return( -1 );
+    if( hdr.op != op ) {
+        errno = EPROTO;
+        return( -1 );
+    }
+
+    *result = hdr.result;
+    *error = hdr.error;
+    return( 0 );
+}
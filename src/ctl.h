@@ -0,0 +1,82 @@
+// ctl.h
+// Control socket protocol between the muttley server and its clients
+//
+// Copyright (C) 2010 Ricardo Gameiro
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+
+#ifndef CTL_H
+#define CTL_H
+
+#include <sys/types.h>
+
+// every message, either way, is a header followed by 'len' bytes of payload
+// in the sender's byte order (both ends are on the same machine)
+#define CTL_MAGIC       0x4d544c43      // 'MTLC'
+#define CTL_VERSION     2
+
+// what a client asks the server for, the reply carries the same op
+enum ctl_op {
+    ctl_op_status = 0,          // result is the kernel extension's kmid (0 if
+                                // not loaded), no payload
+    ctl_op_query,               // muttley_query, payload is an int query
+    ctl_op_snapshot,            // muttley_snapshot, payload is the int size of
+                                // the client's buffer, reply is the snapshot
+                                // (only up to its targets)
+    ctl_op_command,             // muttley_command, payload and reply are the
+                                // commands
+    ctl_op_start,               // start monitoring, payload is the
+                                // muttley_conf, followed by its targets' and
+                                // paths, result is 1 on success
+    ctl_op_stop,                // stop monitoring, result is 1 on success
+    ctl_op_sz
+};
+
+// message header, the result and error (errno) are only set in replies
+struct ctl_hdr {
+    uint32_t magic;                      // CTL_MAGIC
+    uint16_t version;                    // CTL_VERSION
+    uint16_t op;                         // enum ctl_op
+    int32_t result;                      // what the system call returned
+    int32_t error;                       // errno, when it failed
+    uint32_t len;                        // num of payload bytes following
+};
+
+// create the server's socket at 'path', removing a stale one, returns the
+// listening descriptor (or -1)
+int ctl_listen( char * path );
+
+// connect to the server's socket at 'path', returns the descriptor (or -1)
+int ctl_connect( char * path );
+
+// send a message, returns 0 on success
+int ctl_send( int fd, int op, int result, int error, void * data,
+              uint32_t len );
+
+// receive a message into *hdr and up to 'size' bytes of payload into data
+// (a longer payload is an error), returns 0 on success
+int ctl_recv( int fd, struct ctl_hdr * hdr, void * data, uint32_t size );
+
+// send a request and receive its reply, returns 0 on success with the
+// reply's result and error in *result and *error
+int ctl_call( int fd, int op, void * req, uint32_t req_len, void * rsp,
+              uint32_t rsp_size, int * result, int * error );
+
+
+#endif // ifndef CTL_H
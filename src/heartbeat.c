@@ -0,0 +1,81 @@
+// heartbeat.c
+// Shared disk heartbeat slots and peer liveness
+//
+// Copyright (C) 2010 Ricardo Gameiro
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+
+// note that this is built into both the kernel extension and the controller
+// (where it runs the same heartbeat in user space, to test with several
+// nodes on a single machine), so it must stick to plain integer arithmetic
+
+#include <sys/types.h>
+
+#include "heartbeat.h"
+
+
+// fill in a node's slot for its next write
+void hb_slot_fill( struct hb_slot * s, int node, uint64_t seq, uint64_t now,
+                   int interval ) {
+
+    int i;
+
+    s->magic = HB_MAGIC;
+    s->node = node;
+    s->seq = seq;
+    s->time = now;
+    s->interval = interval;
+    s->pad = 0;
+    for( i = 0; i < (int)sizeof( s->unused ); i++ )
+        s->unused[ i ] = 0;
+}
+
+
+// update a peer from its slot as read at 'now', returns 1 if the peer's
+// state changed (0 otherwise)
+int hb_peer_update( struct hb_peer * p, struct hb_slot * s, int node,
+                    uint64_t now, uint64_t timeout ) {
+
+    int state = p->state;
+
+    // a slot which isn't the peer's (never written, or overwritten by
+    // something else) is taken as a sequence number which didn't change
+    if( ( s->magic == HB_MAGIC ) && ( s->node == node ) &&
+        ( !p->seen || ( s->seq != p->seq ) ) ) {
+
+        // the first sequence number read may be left over from long ago,
+        // only a change proves the peer is alive
+        if( p->seen ) {
+            if( now - p->seen > p->gap_max )
+                p->gap_max = now - p->seen;
+            p->beats++;
+            p->state = hb_state_alive;
+        }
+        p->seq = s->seq;
+        p->time = s->time;
+        p->interval = s->interval;
+        p->seen = now;
+
+    } else if( ( p->state == hb_state_alive ) && ( now - p->seen > timeout ) ) {
+        p->state = hb_state_stalled;
+        p->stalls++;
+    }
+
+    return( p->state != state );
+}
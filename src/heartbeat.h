@@ -0,0 +1,82 @@
+// heartbeat.h
+// Shared disk heartbeat slots and peer liveness
+//
+// Copyright (C) 2010 Ricardo Gameiro
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+
+#ifndef HEARTBEAT_H
+#define HEARTBEAT_H
+
+#include <sys/types.h>
+
+// a heartbeat region is HB_SLOTS slots of HB_SLOT_SZ bytes (a sector each)
+// on a device shared by up to HB_SLOTS nodes, node n only ever writes slot n
+// and every node reads the whole region, i.e. all of its peers, at once
+#define HB_SLOT_SZ      512
+#define HB_SLOTS        16
+#define HB_REGION_SZ    ( HB_SLOT_SZ * HB_SLOTS )
+
+// heartbeat slot identification
+#define HB_MAGIC        0x4d544c48      // 'MTLH'
+
+// liveness of a peer, as seen by a node
+enum hb_state {
+    hb_state_unknown = 0,       // never seen beating (e.g. slot unused)
+    hb_state_alive,             // its sequence number keeps changing
+    hb_state_stalled,           // its sequence number stopped changing
+    hb_state_sz
+};
+
+// a heartbeat slot, as written on the shared device
+struct hb_slot {
+    uint32_t magic;                      // HB_MAGIC
+    int32_t node;                        // node owning the slot
+    uint64_t seq;                        // changes on every write
+    uint64_t time;                       // writer's clock in ns since epoch
+    uint32_t interval;                   // writer's heartbeat interval in ms
+    uint32_t pad;
+    char unused[ HB_SLOT_SZ - 32 ];
+};
+
+// a peer as tracked by a node, times are the node's own (the peer's clock
+// is only informational, so the nodes' clocks don't need to agree)
+struct hb_peer {
+    uint64_t seq;                        // latest sequence number read
+    uint64_t time;                       // peer's clock when it wrote it
+    uint64_t seen;                       // time seq last changed (0 never read)
+    uint64_t gap_max;                    // longest time seq didn't change
+    uint64_t beats;                      // num of seq changes seen
+    uint64_t stalls;                     // num of times it was found stalled
+    int state;                           // liveness (see enum hb_state)
+    int interval;                        // peer's heartbeat interval in ms
+};
+
+// fill in a node's slot for its next write
+void hb_slot_fill( struct hb_slot * s, int node, uint64_t seq, uint64_t now,
+                   int interval );
+
+// update a peer from its slot as read at 'now', it stalls once its sequence
+// number didn't change for more than 'timeout' ns, returns 1 if the peer's
+// state changed (0 otherwise)
+int hb_peer_update( struct hb_peer * p, struct hb_slot * s, int node,
+                    uint64_t now, uint64_t timeout );
+
+
+#endif // ifndef HEARTBEAT_H
@@ -0,0 +1,71 @@
+// intern.c
+// String arena interning each distinct string once
+//
+// Copyright (C) 2010 Ricardo Gameiro
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+
+#include <string.h>
+#include <sys/types.h>
+
+#include "intern.h"
+
+
+// set up an empty arena, nothing in it nor in its hash table
+void intern_init( struct intern * in, char * buf, int size, int * slot,
+                  int slots ) {
+
+    in->buf = buf;
+    in->size = size;
+    in->used = 0;
+    in->strings = 0;
+    in->slot = slot;
+    in->slots = slots;
+    memset( slot, 0, slots * sizeof( int ) );
+}
+
+
+// find s (32 bit FNV-1a, linear probing), or append it in the free slot
+// where the probe ended, strings which were appended are never removed
+int intern_add( struct intern * in, const char * s ) {
+
+    int i, n, len = strlen( s ) + 1;
+    uint32_t h = 2166136261U;
+
+    for( i = 0; s[ i ]; i++ ) {
+        h ^= (unsigned char)s[ i ];
+        h *= 16777619U;
+    }
+
+    for( n = 0; n < in->slots; n++ ) {
+        i = ( h + n ) & ( in->slots - 1 );
+        if( !in->slot[ i ] )
+            break;
+        if( !strcmp( in->buf + in->slot[ i ] - 1, s ) )
+            return( in->slot[ i ] - 1 );
+    }
+
+    if( ( n == in->slots ) || ( in->used + len > in->size ) )
+        return( -1 );
+    memcpy( in->buf + in->used, s, len );
+    in->slot[ i ] = in->used + 1;
+    in->used += len;
+    in->strings++;
+    return( in->slot[ i ] - 1 );
+}
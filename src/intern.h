@@ -0,0 +1,51 @@
+// intern.h
+// String arena interning each distinct string once
+//
+// Copyright (C) 2010 Ricardo Gameiro
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+
+#ifndef INTERN_H
+#define INTERN_H
+
+#include <sys/types.h>
+
+// an arena strings are appended to, NUL terminated, along with an open
+// addressing hash table of their offsets, so that a string added again is
+// found instead of being appended once more
+struct intern {
+    char * buf;                          // the arena
+    int size;                            // its size
+    int used;                            // num of bytes of it in use
+    int strings;                         // num of strings in it
+    int * slot;                          // hash table, offset + 1 (0 empty)
+    int slots;                           // its size, a power of 2 at least
+                                         // twice the num of strings
+};
+
+// set up an empty arena on 'buf' and its hash table on 'slot'
+void intern_init( struct intern * in, char * buf, int size, int * slot,
+                  int slots );
+
+// offset of string s in the arena, appending it if it isn't there yet,
+// returns -1 if the arena or the hash table are full
+int intern_add( struct intern * in, const char * s );
+
+
+#endif // ifndef INTERN_H
@@ -26,16 +26,38 @@
 #include <string.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <signal.h>
 #include <nlist.h>
 #include <dlfcn.h>
+#include <time.h>
+#include <poll.h>
+#include <pthread.h>
+#include <procinfo.h>
+#include <sys/ioctl.h>
+#include <sys/devinfo.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <sys/time.h>
 #include <sys/mode.h>
+#include <sys/stat.h>
+#include <sys/statfs.h>
 #include <sys/sysconfig.h>
+#include <sys/mntctl.h>
+#include <sys/vmount.h>
+#include <sys/atomic_op.h>
+#include <sys/processor.h>
+#include <sys/thread.h>
 
 
 #include "kexutil.h"
+#include "ctl.h"
+#include "baseline.h"
+#include "intern.h"
 #include "muttley.kex.h"
 
 #define MUTTLEY_NAME "muttley"
+#define MUTTLEY_SOCKET "/var/run/muttley.sock"
 
 const char * author  = "(c) 2010 Ricardo Gameiro\n\n";
 
@@ -45,7 +67,9 @@ const char * application =
 
 const char * help_message =
     "muttley is a kernel device monitoring and watch dog extension allowing\n"
-    "load, status, start, display, stop and unload actions to be performed.\n"
+    "load, status, start, display, top, rollup, trace, probe, pause, resume,\n"
+    "reset, tune, stop, unload, postmortem, hbpeer, discover, serve, bench,\n"
+    "scale, calibrate and validate actions to be performed.\n"
     "The extension monitors a device and (optionally) forces a kernel panic\n"
     "and dump, upon loss of access to that device.\n"
     "The monitored device will usually be a raw hard disk or logical volume."
@@ -54,36 +78,189 @@ const char * help_message =
     "  "MUTTLEY_NAME " -h\n"
     "  "MUTTLEY_NAME " load\n"
     "  "MUTTLEY_NAME " status\n"
-    "  "MUTTLEY_NAME " [-d device] [-c checks] [-s success] [-r runs]\\\n"
-    "          [-i run_int] [-b behaviour] [-f] start\n"
+    "  "MUTTLEY_NAME " [-d device] [-D directory] [-w device@offset]\\\n"
+    "          [-L target_file]\\\n"
+    "          [-c checks] [-s success] [-r runs] [-i run_int] [-W workers]\\\n"
+    "          [-N full_every] [-Q query_ms]\\\n"
+    "          [-b behaviour]\\\n"
+    "          [-l deadline] [-p recorder] [-H device@offset -n node]\\\n"
+    "          [-e hb_int] [-E hb_tmo] [-k hook] [-K hook_tmo] [-g] [-f]\\\n"
+    "          [-a alert_file] [-A alert_rate] [-C coalesce] [-B baseline]\\\n"
+    "          start\n"
     "  "MUTTLEY_NAME " [-i disp_int] [-t times] display\n"
+    "  "MUTTLEY_NAME " [-m refresh] [-o sort] top\n"
+    "  "MUTTLEY_NAME " rollup\n"
+    "  "MUTTLEY_NAME " trace\n"
+    "  "MUTTLEY_NAME " [-T target] probe | pause | resume | reset\n"
+    "  "MUTTLEY_NAME " [-c checks] [-s success] [-r runs] [-i run_int]\n"
+    "          [-N full_every] [-A alert_rate] tune\n"
     "  "MUTTLEY_NAME " stop\n"
-    "  "MUTTLEY_NAME " unload\n\n"
+    "  "MUTTLEY_NAME " unload\n"
+    "  "MUTTLEY_NAME " -p recorder postmortem\n"
+    "  "MUTTLEY_NAME " -H device@offset -n node [-e hb_int] [-E hb_tmo] [-f]\\\n"
+    "          hbpeer\n"
+    "  "MUTTLEY_NAME " discover\n"
+    "  "MUTTLEY_NAME " [-S socket] serve\n"
+    "  "MUTTLEY_NAME " [-S socket] [-t times] bench\n"
+    "  "MUTTLEY_NAME " [-d device] [-t times] [-m refresh] scale\n"
+    "  "MUTTLEY_NAME " [-d device] [-D directory] [-w device@offset] [-g]\\\n"
+    "          [-f] [-W workers] [-t period] [-m probe_int] [-x detect]\\\n"
+    "          [-F false_alarms] [-B baseline] calibrate\n"
+    "  "MUTTLEY_NAME " [-d device] [-D directory] [-w device@offset]\\\n"
+    "          [-L target_file] [-g] [-f] validate\n\n"
     "options:\n"
     "  -h             displays this help message\n"
-    "  -d device      path to device to monitor (default %s)\n"
+    "  -d device      path to device to monitor (default %s), may be given\n"
+    "                 multiple times to monitor several devices at once\n"
+    "  -D directory   directory of a filesystem to monitor with a canary file\n"
+    "                 (statfs, then create, write, fsync and unlink it), may\n"
+    "                 be given multiple times\n"
+    "  -w dev@offset  device to monitor by writing a sequence numbered %d\n"
+    "                 bytes block at offset (a multiple of that size) and\n"
+    "                 reading it back, THE BLOCK IS OVERWRITTEN, it must be\n"
+    "                 reserved for muttley, may be given multiple times\n"
+    "  -L target_file file of targets to monitor, one per line as 'read\n"
+    "                 device', 'canary directory' or 'write device@offset'\n"
+    "                 ('#' starts a comment), along with those given above\n"
     "  -c checks      number of checks to perform on each run (default %d)\n"
     "  -s success     number of successful checks per run to consider the\n"
     "                 device as available (default %d)\n"
     "  -r runs        consecutive failed run threshold to execute the defined\n"
     "                 behaviour (default %d)\n"
     "  -i run_int     interval between check runs in seconds (default %d)\n"
-    "  -b behaviour   behaviour on monitoring failure - none, panic\n"
+    "  -W workers     number of worker kernel procs the targets are sharded\n"
+    "                 across, each bound to a processor of its own as far as\n"
+    "                 there are, idle ones take over due targets from busy\n"
+    "                 ones (default %d, max %d)\n"
+    "  -N full_every  checks of a read target per full one (open, read and\n"
+    "                 close it, with direct i/o), the others only query its\n"
+    "                 held device (ioctl, or stat for a file) and read it at\n"
+    "                 once if that looks wrong (default %d, all full), a query\n"
+    "                 does no i/o to the device, so a lost path or LUN is only\n"
+    "                 caught by the next full check, i.e. this trades how soon\n"
+    "                 it is detected for less i/o\n"
+    "  -Q query_ms    interval between check runs in ms instead of run_int,\n"
+    "                 for tiered checks (-N) only, so that read targets are\n"
+    "                 queried more than once a second and still read every\n"
+    "                 full_every checks (%d..999, default none)\n"
+    "  -b behaviour   behaviour on monitoring failure, once alerted - none,\n"
+    "                 panic (right away, or if the hook doesn't succeed in\n"
+    "                 time) or fence (run the hook)\n"
     "                 (default %s)\n"
+    "  -k hook        fencing hook, started along with monitoring and kept\n"
+    "                 waiting for a line on its standard input (sequence,\n"
+    "                 target, device and failed runs), it must then fence\n"
+    "                 and exit, with 0 on success\n"
+    "  -K hook_tmo    time in milliseconds for the hook to succeed, counted\n"
+    "                 from detection (default %d)\n"
+    "  -l deadline    deadline in milliseconds of every step of a check\n"
+    "                 (open, read, statfs, create, write, fsync, unlink,\n"
+    "                 query), or of a single one as step=deadline, may be\n"
+    "                 given multiple times, a step past its deadline fails the\n"
+    "                 check and a step stuck past it fails one run for each\n"
+    "                 interval it stays stuck (default none)\n"
+    "  -p recorder    flight recorder file, keeping the latest runs for post\n"
+    "                 panic analysis, must not be on the monitored device\n"
+    "  -a alert_file  file alerts are appended to, besides the console and\n"
+    "                 syslog, it shouldn't be on a monitored device\n"
+    "  -A alert_rate  max alert messages per minute to each of the console,\n"
+    "                 syslog and the alert file, those over it are dropped\n"
+    "                 (default %d)\n"
+    "  -C coalesce    time in milliseconds alerts raised together (e.g. by\n"
+    "                 every target on a lost fabric) are gathered for, to\n"
+    "                 be emitted as a single message per kind (default %d)\n"
+    "  -B baseline    baseline file, written by calibrate and loaded by start,\n"
+    "                 which gives each target it has a record of the step\n"
+    "                 deadlines calibrated for it (-l deadlines still come\n"
+    "                 first)\n"
+    "  -x detect      calibrate's detection time goal in seconds, i.e. the\n"
+    "                 longest a lost target may take to reach the failed runs\n"
+    "                 threshold (default %d)\n"
+    "  -F false_alarms calibrate's false alarm goal, i.e. the most threshold\n"
+    "                 alarms a healthy target may raise a year (default %g)\n"
+    "  -H dev@offset  shared device holding a heartbeat region of %d slots of\n"
+    "                 %d bytes at offset (a multiple of the slot size), THE\n"
+    "                 REGION IS OVERWRITTEN, it must be reserved for muttley\n"
+    "  -n node        our node number, i.e. the heartbeat slot we write\n"
+    "                 (0..%d), must be unique among the nodes sharing it\n"
+    "  -e hb_int      interval between heartbeats in milliseconds (default\n"
+    "                 %d)\n"
+    "  -E hb_tmo      time in milliseconds for a peer whose heartbeat doesn't\n"
+    "                 change to be found stalled, which happens within hb_tmo\n"
+    "                 plus hb_int (default %d, at least twice hb_int)\n"
+    "  -g             also monitor every mounted jfs and jfs2 filesystem, i.e.\n"
+    "                 each physical volume they're on once and each logical\n"
+    "                 volume through them (no default device when given)\n"
     "  -f             allow 'device' to be any type of file, if using a file\n"
     "                 it must be at least 512 bytes in size (useful for\n "
     "                 test purposes, i.e. with a file which is removable)\n"
-    "  -v disp_int    statistics display interval in seconds (default %d)\n"
+    "  -v disp_int    statistics display interval in seconds (default %d),\n"
+    "                 rates are computed between consecutive displays\n"
     "  -t times       number of times the statistics will be display \n"
-    "                 (default %d)\n"
+    "                 (default %d), or calibrate's length in seconds (default\n"
+    "                 %d)\n"
+    "  -m refresh     top refresh interval, scale run interval and calibrate\n"
+    "                 probe interval, in milliseconds (default %d)\n"
+    "  -o sort        top sort order - state, latency, failures\n"
+    "                 (default %s)\n"
+    "  -T target      target number (as shown by display) to probe, pause,\n"
+    "                 resume or reset (default all of them)\n"
+    "  -S socket      server's control socket, used by the status, start,\n"
+    "                 display, top, probe, pause, resume, reset, tune and\n"
+    "                 stop actions when a server is there, none to never use\n"
+    "                 it\n"
+    "                 (default %s)\n"
     "arguments:\n"
     "  load           loads the kernel extension\n"
     "  status         query kernel extension status\n"
     "  start          starts monitoring (and executes the defined action on\n"
     "                 threshold)\n"
     "  display        display monitoring statistics\n"
+    "  top            full screen view of every device, refreshed live\n"
+    "                 (until interrupted)\n"
+    "  rollup         display the last minute, hour and day of each device\n"
+    "                 (checks, failure rate and latency percentiles)\n"
+    "  trace          stream every probe event live (until interrupted)\n"
+    "  probe          check now, outside of the runs, and show the results\n"
+    "                 (exits with %d if a check failed)\n"
+    "  pause          stop checking in runs (paused targets never fail runs)\n"
+    "  resume         check in runs again\n"
+    "  reset          zero the counters (and the totals, for all targets)\n"
+    "  tune           change the checks, successes, runs, run interval,\n"
+    "                 full_every and alert rate given of the running\n"
+    "                 monitor, without restarting it, those not given are\n"
+    "                 left as they are\n"
     "  stop           stops monitoring\n"
-    "  unload         unloads the kernel extension\n\n"
+    "  unload         unloads the kernel extension\n"
+    "  postmortem     decode a flight recorder file (e.g. after a panic)\n"
+    "  hbpeer         run the heartbeat alone, in user space, as 'node' (until\n"
+    "                 interrupted), to try it out with several nodes sharing\n"
+    "                 a file on a single machine\n"
+    "  discover       show the mounted jfs and jfs2 filesystems, the logical\n"
+    "                 and physical volumes they're on and the paths to those\n"
+    "                 (i.e. what -g monitors)\n"
+    "  serve          keep the kernel extension's system calls at hand and\n"
+    "                 do them for clients on the control socket (until\n"
+    "                 interrupted)\n"
+    "  bench          time 'times' status round trips with and without the\n"
+    "                 server (default 100)\n"
+    "  scale          check the devices 'times' runs (default 20) in user\n"
+    "                 space with 1, 4 and 16 workers, sharing them out the\n"
+    "                 way the kernel extension does, and show the probes per\n"
+    "                 second and the lateness of the checks at each\n"
+    "  calibrate      probe the devices in user space every 'probe_int' for\n"
+    "                 'period', show each one's latency and failures, and\n"
+    "                 recommend the checks, successes, runs, run interval and\n"
+    "                 step deadline meeting the 'detect' and 'false_alarms'\n"
+    "                 goals, and each read target's query step deadline,\n"
+    "                 writing them to 'baseline' if given (don't\n"
+    "                 calibrate write targets while they're monitored, their\n"
+    "                 scratch blocks would be overwritten under the checks)\n"
+    "  validate       check the devices exist, are of the right type and\n"
+    "                 size and open, as start does, without starting, and\n"
+    "                 show how long loading and validating them took and\n"
+    "                 the memory the configuration and the kernel\n"
+    "                 extension take per target\n\n"
     "Notes:\n"
     "The muttley command line controller must be executed in the same\n"
     "same directory where the 'muttley.kex' kernel extension is located.\n"
@@ -107,13 +284,31 @@ enum exit_codes {
     exit_err_inv = EINVAL,
     exit_err_sys,
     exit_err_int,
-    exit_not_rdy
+    exit_not_rdy,
+    exit_failed
 };
 
 // muttley's possible behaviours in english to parse from the command line
 const char * behaviour_str[ mtl_behaviour_sz ] = {
     "none",
-    "panic"
+    "panic",
+    "fence"
+};
+
+// fencing hook states in english
+const char * fence_state_str[ mtl_fence_sz ] = {
+    "idle",
+    "triggered",
+    "running",
+    "done",
+    "FAILED"
+};
+
+// alert sinks in english
+const char * sink_str[ mtl_sink_sz ] = {
+    "console",
+    "syslog",
+    "file"
 };
 
 // muttley controller's actions enum
@@ -122,8 +317,24 @@ enum actions {
     action_status,
     action_start,
     action_display,
+    action_top,
+    action_rollup,
+    action_trace,
+    action_probe,
+    action_pause,
+    action_resume,
+    action_reset,
+    action_tune,
     action_stop,
     action_unload,
+    action_postmortem,
+    action_hbpeer,
+    action_discover,
+    action_serve,
+    action_bench,
+    action_scale,
+    action_calibrate,
+    action_validate,
     action_sz
 };
 
@@ -133,32 +344,327 @@ const char * actions_str[ action_sz ] = {
     "status",
     "start",
     "display",
+    "top",
+    "rollup",
+    "trace",
+    "probe",
+    "pause",
+    "resume",
+    "reset",
+    "tune",
     "stop",
-    "unload"
+    "unload",
+    "postmortem",
+    "hbpeer",
+    "discover",
+    "serve",
+    "bench",
+    "scale",
+    "calibrate",
+    "validate"
+};
+
+// target kinds in english
+const char * target_type_str[ mtl_target_sz ] = {
+    "read",
+    "canary",
+    "write",
+    "logical"
+};
+
+// top's sort orders
+enum top_sorts {
+    top_sort_state = 0,         // failing targets first
+    top_sort_latency,           // slowest last check first
+    top_sort_failures,          // most failed checks first
+    top_sort_sz
+};
+
+// and in english to simplify parsing from the command line
+const char * top_sort_str[ top_sort_sz ] = {
+    "state",
+    "latency",
+    "failures"
+};
+
+// check steps in english
+const char * step_str[ mtl_step_sz ] = {
+    "open",
+    "read",
+    "statfs",
+    "create",
+    "write",
+    "fsync",
+    "unlink",
+    "query"
+};
+
+// rollup windows in english
+const char * window_str[ mtl_window_sz ] = {
+    "1m",
+    "1h",
+    "24h"
+};
+
+// flight recorder write out reasons in english
+const char * fr_reason_str[ mtl_fr_reason_sz ] = {
+    "never written",
+    "failed runs threshold reached",
+    "monitoring stopped"
+};
+
+// heartbeat peer states in english
+const char * hb_state_str[ hb_state_sz ] = {
+    "unknown",
+    "alive",
+    "STALLED"
 };
 
 // initialize execution options with some sane defaults
 // overridden by the command line options when supplied
 struct {
-    char * device;
+    char * device[ MTL_TARGETS_MAX ];
+    int type[ MTL_TARGETS_MAX ];
+    uint64_t offset[ MTL_TARGETS_MAX ];
+    int devices;
+    int deadline[ mtl_step_sz ];
+    char * recorder;
+    char * alert_file;
+    int alert_rate;
+    int alert_coalesce;
+    char * hb_device;
+    uint64_t hb_offset;
+    int hb_node;
+    int hb_int;
+    int hb_tmo;
     int action;
     int checks;
     int successes;
     int runs;
     int run_int;
+    int workers;
+    int full_every;
+    int query_ms;
     int behaviour;
     int force;
     int disp_int;
     int times;
+    int refresh;
+    int sort;
+    int target;
+    int topology;
+    char * hook;
+    int hook_tmo;
+    char * socket;
+    char * baseline;
+    int detect;
+    double false_alarms;
+    struct muttley_tune tune;
 } muttley_opt = {
-    "/dev/rhd4", 0, 3, 1, 2, 5, mtl_behaviour_none, false, 2, 1
+    { "/dev/rhd4" }, { mtl_target_read }, { 0 }, 0, { 0 }, NULL, NULL, 6, 500,
+    NULL, 0, -1, 200, 1000, 0, 3, 1, 2, 5, 1, 1, 0, mtl_behaviour_none, false,
+    2, 1, 250, top_sort_state, MTL_TARGET_ALL, false, NULL, 10000,
+    MUTTLEY_SOCKET, NULL, 30, 0.01
 };
 
+// max logical volumes muttley_topology() keeps track of
+#define TOPO_LVS_MAX   256
+// max physical volumes a logical volume may be on
+#define TOPO_PVS_MAX   32
+// max length of a volume or adapter name
+#define TOPO_NAME_SZ   32
+
+// what muttley_topology() finds, the mounted jfs and jfs2 filesystems, the
+// logical volumes they're on and the physical volumes those are on, each
+// physical volume listed once however many logical volumes are on it
+struct {
+    int lvs;
+    struct {
+        char fs[ PATH_MAX ];             // mount point
+        char lv[ TOPO_NAME_SZ ];         // logical volume, e.g. hd4
+        int mirrored;                    // has more than one copy
+        int pvs;
+        int pv[ TOPO_PVS_MAX ];          // index into pv[] below
+    } lv[ TOPO_LVS_MAX ];
+    int pvs;
+    char pv[ MTL_TARGETS_MAX ][ TOPO_NAME_SZ ]; // physical volume, e.g. hdisk0
+} topo;
+
 // function pointer to the kernel extension's statistics system call
 // this is initialized in run time if the kernel extension is loaded upon
 // invocation of the command line tool
 muttley_query_syscall_t muttley_query_syscall = NULL;
 
+// function pointer to the kernel extension's trace system call, also
+// initialized in run time
+muttley_trace_syscall_t muttley_trace_syscall = NULL;
+
+// function pointer to the kernel extension's statistics snapshot system call,
+// also initialized in run time
+muttley_snapshot_syscall_t muttley_snapshot_syscall = NULL;
+
+// function pointer to the kernel extension's rollup system call, also
+// initialized in run time
+muttley_rollup_syscall_t muttley_rollup_syscall = NULL;
+
+// function pointer to the kernel extension's command system call, also
+// initialized in run time
+muttley_command_syscall_t muttley_command_syscall = NULL;
+
+// function pointer to the kernel extension's fence system call, also
+// initialized in run time
+muttley_fence_syscall_t muttley_fence_syscall = NULL;
+
+// statistics snapshots, the previous one is kept to compute rates
+struct muttley_stats stats, prev_stats;
+
+// kernel extension configuration, built by muttley_start(), along with its
+// targets' and their paths, which are passed in after it
+struct muttley_conf conf;
+struct muttley_target_conf tconf[ MTL_TARGETS_MAX ];
+char conf_paths[ MTL_PATHS_SZ ];
+
+// largest screen top will draw on, bigger terminals are only partly used
+#define TOP_ROWS_MAX   256
+#define TOP_COLS_MAX   256
+// lines above the targets' list
+#define TOP_HEADER_SZ  3
+
+// number of events fetched from the trace ring per system call
+#define TRACE_BATCH_SZ 256
+// time to sleep between trace ring polls, when it has been drained (us)
+#define TRACE_POLL_US  100000
+
+// set on SIGINT, to get out of the streaming actions
+volatile sig_atomic_t interrupted = false;
+
+// connection to the server, when the system calls go through it
+int ctl_fd = EOF;
+
+// max clients the server handles at once
+#define CTL_CLIENTS_MAX 64
+
+// a command request the server carries out on a thread of its own, which
+// hands the client back to the poll loop through serve_pipe once it's done,
+// writing its descriptor (complemented if the client is gone)
+struct serve_command {
+    int fd;                              // client it's for
+    uint32_t len;                        // num of bytes of commands
+    struct muttley_command * cmd;        // the commands, following it
+};
+int serve_pipe[ 2 ];
+
+// how we were invoked, for bench to run us
+char * muttley_argv0;
+
+// set on SIGCHLD, when the hook daemon's hook exits
+volatile sig_atomic_t hook_exited = false;
+
+// worker counts scale goes through
+const int scale_workers[] = { 1, 4, 16 };
+#define SCALE_STEPS ( sizeof( scale_workers ) / sizeof( scale_workers[ 0 ] ) )
+
+// what scale's workers share, the queues are those the kernel extension's
+// workers use (see shard.h), a run is published by bumping gen and is done
+// once pending drops to 0, both under lock
+struct {
+    struct shard_queue queue[ SHARD_WORKERS_MAX ];
+    int workers;                         // num of workers in this step
+    int gen;                             // num of runs published
+    int stop;                            // set to let the workers go
+    volatile int pending;                // targets of the run not checked
+    uint64_t run_time;                   // start of the current run in ns
+    pthread_mutex_t lock;
+    pthread_cond_t run;                  // signalled when a run is published
+    pthread_cond_t done;                 // signalled when a run is done
+    struct {
+        uint64_t checked;                // num of targets checked
+        uint64_t stolen;                 // num of them from another's queue
+        uint64_t failures;               // num of them which failed
+        uint64_t lateness_max;           // longest lateness
+        struct sketch lateness;          // their lateness
+        int cpu;                         // processor it's bound to (or -1)
+    } worker[ SHARD_WORKERS_MAX ];
+} scale;
+
+// calibrate's length when not given, in seconds
+#define CALIB_PERIOD   60
+// name of the canary file calibrate creates, apart from the kernel
+// extension's own, which may be in use
+#define CALIB_CANARY   ".muttley.calibrate"
+
+// what calibrate measures, each target is only probed by the worker it's
+// sharded to, so there's nothing to lock, read targets are also queried
+// through a descriptor held open throughout, as the query tier does
+struct {
+    int workers;                         // num of workers probing
+    uint64_t end;                        // end of the calibration in ns
+    struct {
+        struct sketch latency;           // latency of the probes
+        uint64_t max;                    // longest probe in ns
+        uint32_t probes;                 // num of probes made
+        uint32_t failures;               // num of them which failed
+        int error;                       // errno of the latest failure
+        int direct;                      // a file, to use direct i/o on
+        int fd;                          // held descriptor (EOF for none)
+        uint32_t queries;                // num of queries made (which
+                                         // didn't fail)
+        uint64_t query_max;              // longest query in ns
+        struct sketch query;             // latency of the queries
+    } target[ MTL_TARGETS_MAX ];
+} calib;
+
+// size of the paths arena's hash table, a power of 2 at least twice
+// MTL_TARGETS_MAX
+#define PATHS_SLOTS    32768
+
+// the targets' paths, interned in the configuration's arena, as they're
+// loaded or when it's built
+struct intern paths;
+int paths_slot[ PATHS_SLOTS ];
+
+// num of threads validating the targets at once
+#define LOADER_THREADS 16
+// num of invalid targets shown, of those found
+#define LOADER_ERRORS_MAX 10
+
+// what validating a target may find wrong, the failed calls for those with
+// an errno
+enum loader_res {
+    loader_ok = 0,
+    loader_stat,
+    loader_dir,
+    loader_small,
+    loader_chr,
+    loader_open,
+    loader_sz
+};
+
+// and in english
+const char * loader_str[ loader_sz ] = {
+    "ok",
+    "stat",
+    "is not a directory",
+    "is too small for a scratch block",
+    "is not a character device",
+    "open"
+};
+
+// the target file loaded and the validation of the targets, the validating
+// threads take the next target to validate until none are left, each one
+// filling in its part of the configuration
+struct {
+    char * file;                         // target file loaded (if any)
+    int loaded;                          // num of targets from it
+    uint64_t load_time;                  // time taken loading it in ns
+    int next;                            // next target to validate
+    int threads;                         // num of validating threads
+    uint64_t validate_time;              // time taken validating in ns
+    int res[ MTL_TARGETS_MAX ];          // what was found (see loader_res)
+    int error[ MTL_TARGETS_MAX ];        // errno of the failed call
+    dev_t dev[ MTL_TARGETS_MAX ];        // underlying device of each target
+} loader;
+
 
 // prototypes
 int muttley( void );
@@ -166,8 +672,40 @@ int muttley_load( mid_t kmid );
 int muttley_status( mid_t kmid );
 int muttley_start( mid_t kmid );
 int muttley_display( mid_t kmid );
+void muttley_overhead( void );
+void muttley_interrupt( int sig );
+int muttley_top( mid_t kmid );
+int muttley_rollups( mid_t kmid );
+int muttley_trace_stream( mid_t kmid );
+int muttley_command_send( mid_t kmid );
 int muttley_stop( mid_t kmid );
 int muttley_unload( mid_t kmid );
+int muttley_postmortem( void );
+int muttley_hbpeer( void );
+int muttley_hb_check( int * direct );
+void muttley_hb_peers( struct hb_peer * peer, int node, uint64_t now );
+int muttley_topology( void );
+int muttley_topo_targets( void );
+int muttley_discover( void );
+int muttley_hookd_spawn( void );
+int muttley_syscalls( void );
+int muttley_ctl_open( void );
+int muttley_ctl_query( enum muttley_query query );
+int muttley_ctl_snapshot( struct muttley_stats * stats, int size );
+int muttley_ctl_command( struct muttley_command * cmds, int count );
+int muttley_ctl_call( int op, void * data, int length );
+void * muttley_serve_command( void * arg );
+int muttley_serve( void );
+int muttley_bench( void );
+int muttley_scale( void );
+int muttley_calibrate( void );
+int muttley_baseline_apply( void );
+int muttley_targets_load( char * file );
+int muttley_conf_targets( void );
+int muttley_validate( void );
+uint64_t muttley_now( void );
+int muttley_parse_deadline( char * arg );
+int muttley_parse_offset( char * arg, int align, uint64_t * offset );
 
 
 // main just parses and validates the command line
@@ -179,6 +717,9 @@ int main( int argc, char ** argv ) {
     extern char * optarg;
     extern int optind, optopt;
 
+    muttley_argv0 = argv[ 0 ];
+    intern_init( &paths, conf_paths, MTL_PATHS_SZ, paths_slot, PATHS_SLOTS );
+
     // check if the user is authorized to run me
     // do you feel the power? :)
     if( getuid() ) {
@@ -187,32 +728,73 @@ int main( int argc, char ** argv ) {
     }
 
     // parse the command line
-    while( ( c = getopt( argc, argv, "hd:c:s:i:b:fv:t:" ) ) != EOF ) {
+    while( ( c = getopt( argc, argv, "hd:D:w:c:s:r:i:W:N:Q:b:k:K:l:p:a:A:C:B:x:F:L:H:n:e:E:gfv:t:m:o:T:S:" ) ) != EOF ) {
 
         switch( c ) {
             case 'h':
                 fprintf( stdout, "\n%s%s", application, author );
-                fprintf( stdout, help_message, muttley_opt.device,
+                fprintf( stdout, help_message, muttley_opt.device[ 0 ],
+                         MTL_SCRATCH_SZ,
                          muttley_opt.checks, muttley_opt.successes,
                          muttley_opt.runs, muttley_opt.run_int,
-                         muttley_opt.behaviour ? "panic" : "none",
-                         muttley_opt.disp_int, muttley_opt.times );
+                         muttley_opt.workers, MTL_WORKERS_MAX,
+                         muttley_opt.full_every, MTL_QUERY_MS_MIN,
+                         behaviour_str[ muttley_opt.behaviour ],
+                         muttley_opt.hook_tmo,
+                         muttley_opt.alert_rate, muttley_opt.alert_coalesce,
+                         muttley_opt.detect, muttley_opt.false_alarms,
+                         HB_SLOTS, HB_SLOT_SZ, HB_SLOTS - 1,
+                         muttley_opt.hb_int, muttley_opt.hb_tmo,
+                         muttley_opt.disp_int, muttley_opt.times,
+                         CALIB_PERIOD, muttley_opt.refresh,
+                         top_sort_str[ muttley_opt.sort ], MUTTLEY_SOCKET,
+                         exit_failed );
                 exit( exit_ok );
                 break;
             case 'd':             // device to monitor
-                muttley_opt.device = optarg;
+            case 'D':             // filesystem to monitor with a canary
+            case 'w':             // device to monitor by writing to it
+                if( muttley_opt.devices == MTL_TARGETS_MAX ) {
+                    fprintf( stderr, "device: too many devices (maximum is "
+                             "%d)\n", MTL_TARGETS_MAX );
+                    exit( exit_err_inv );
+                }
+                muttley_opt.type[ muttley_opt.devices ] = ( c == 'D' ) ?
+                    mtl_target_canary : ( c == 'w' ) ? mtl_target_write :
+                    mtl_target_read;
+                if( ( c == 'w' ) && muttley_parse_offset( optarg,
+                        MTL_SCRATCH_SZ,
+                        &muttley_opt.offset[ muttley_opt.devices ] ) ) {
+                    fprintf( stderr, "device: invalid write target specified "
+                             "(must be device@offset, with offset a multiple "
+                             "of %d)\n", MTL_SCRATCH_SZ );
+                    exit( exit_err_inv );
+                }
+                muttley_opt.device[ muttley_opt.devices++ ] = optarg;
                 break;
             case 'c':             // number of checks per run
-                muttley_opt.checks = atoi( optarg );
+                muttley_opt.tune.checks = muttley_opt.checks = atoi( optarg );
                 break;
             case 's':             // successes per run to consider a run successful
-                muttley_opt.successes = atoi( optarg );
+                muttley_opt.tune.successes = muttley_opt.successes =
+                    atoi( optarg );
                 break;
             case 'r':             // number of runs that must fail to execute behaviour
-                muttley_opt.runs = atoi( optarg );
+                muttley_opt.tune.runs = muttley_opt.runs = atoi( optarg );
                 break;
             case 'i':             // interval between runs
-                muttley_opt.run_int = atoi( optarg );
+                muttley_opt.tune.interval = muttley_opt.run_int =
+                    atoi( optarg );
+                break;
+            case 'W':             // worker kernel procs
+                muttley_opt.workers = atoi( optarg );
+                break;
+            case 'N':             // checks of read targets per full one
+                muttley_opt.tune.full_every = muttley_opt.full_every =
+                    atoi( optarg );
+                break;
+            case 'Q':             // interval between runs in ms, when tiered
+                muttley_opt.query_ms = atoi( optarg );
                 break;
             case 'b':             // behaviour, i.e. do nothing or panic on failure
                 muttley_opt.behaviour = -1;
@@ -221,6 +803,67 @@ int main( int argc, char ** argv ) {
                         muttley_opt.behaviour = i;
                 }
                 break;
+            case 'k':             // fencing hook
+                muttley_opt.hook = optarg;
+                break;
+            case 'K':             // fencing hook deadline
+                muttley_opt.hook_tmo = atoi( optarg );
+                break;
+            case 'l':             // step deadlines
+                if( muttley_parse_deadline( optarg ) ) {
+                    fprintf( stderr, "deadline: invalid value specified (valid"
+                             " values are ms or step=ms, with ms 0..600000)\n" );
+                    exit( exit_err_inv );
+                }
+                break;
+            case 'p':             // flight recorder file
+                muttley_opt.recorder = optarg;
+                break;
+            case 'a':             // alert file
+                muttley_opt.alert_file = optarg;
+                break;
+            case 'A':             // alert messages per minute, per sink
+                muttley_opt.tune.alert_rate = muttley_opt.alert_rate =
+                    atoi( optarg );
+                break;
+            case 'C':             // alert coalescing time
+                muttley_opt.alert_coalesce = atoi( optarg );
+                break;
+            case 'L':             // target file
+                if( ( i = muttley_targets_load( optarg ) ) )
+                    exit( i );
+                break;
+            case 'B':             // baseline file
+                muttley_opt.baseline = optarg;
+                break;
+            case 'x':             // calibrate's detection time goal
+                muttley_opt.detect = atoi( optarg );
+                break;
+            case 'F':             // calibrate's false alarms goal
+                muttley_opt.false_alarms = atof( optarg );
+                break;
+            case 'H':             // heartbeat device
+                if( muttley_parse_offset( optarg, HB_SLOT_SZ,
+                                          &muttley_opt.hb_offset ) ) {
+                    fprintf( stderr, "heartbeat: invalid device specified "
+                             "(must be device@offset, with offset a multiple "
+                             "of %d)\n", HB_SLOT_SZ );
+                    exit( exit_err_inv );
+                }
+                muttley_opt.hb_device = optarg;
+                break;
+            case 'n':             // heartbeat node number
+                muttley_opt.hb_node = atoi( optarg );
+                break;
+            case 'e':             // heartbeat interval
+                muttley_opt.hb_int = atoi( optarg );
+                break;
+            case 'E':             // heartbeat stall timeout
+                muttley_opt.hb_tmo = atoi( optarg );
+                break;
+            case 'g':             // monitor the mounted filesystems' volumes
+                muttley_opt.topology = true;
+                break;
             case 'f':             // allow monitoring on non-character devices
                 muttley_opt.force = true;
                 break;
@@ -230,6 +873,22 @@ int main( int argc, char ** argv ) {
             case 't':             // display times
                 muttley_opt.times = atoi( optarg );
                 break;
+            case 'm':             // top refresh interval
+                muttley_opt.refresh = atoi( optarg );
+                break;
+            case 'o':             // top sort order
+                muttley_opt.sort = -1;
+                for( i = 0; i < top_sort_sz; i++ ) {
+                    if( strcmp( top_sort_str[ i ], optarg ) == 0 )
+                        muttley_opt.sort = i;
+                }
+                break;
+            case 'T':             // command target
+                muttley_opt.target = atoi( optarg );
+                break;
+            case 'S':             // server's control socket
+                muttley_opt.socket = optarg;
+                break;
             case '?':
                 exit( exit_err_inv );
                 break;
@@ -238,10 +897,30 @@ int main( int argc, char ** argv ) {
 
     // perform sanity checks on the command line options and arguments
 
+    // monitor the default device when none was specified, unless the devices
+    // will be found when starting
+    if( !muttley_opt.devices && !muttley_opt.topology )
+        muttley_opt.devices = 1;
+
     // check that behaviour is valid
     if( muttley_opt.behaviour == -1 ) {
         fprintf( stderr, "behaviour: invalid value specified (valid values"
-                 " are 'none' or 'panic')\n" );
+                 " are 'none', 'panic' or 'fence')\n" );
+        exit( exit_err_inv );
+    }
+
+    // the hook is run by the panic and fence behaviours, fence needs one
+    if( muttley_opt.hook && ( muttley_opt.behaviour == mtl_behaviour_none ) ) {
+        fprintf( stderr, "hook: needs the panic or fence behaviour\n" );
+        exit( exit_err_inv );
+    }
+    if( !muttley_opt.hook && ( muttley_opt.behaviour == mtl_behaviour_fence ) ) {
+        fprintf( stderr, "behaviour: fence needs a hook\n" );
+        exit( exit_err_inv );
+    }
+    if( muttley_opt.hook_tmo < 1 ) {
+        fprintf( stderr, "hook: invalid timeout specified (must be at least 1"
+                 " ms)\n" );
         exit( exit_err_inv );
     }
 
@@ -262,23 +941,92 @@ int main( int argc, char ** argv ) {
     }
 
     // check that the number of checks is valid
-    if( ( muttley_opt.checks < 1 ) || ( muttley_opt.checks > 10 ) ) {
-        fprintf( stderr, "checks: failed sanity (valid range is 1..10)\n" );
+    if( ( muttley_opt.checks < 1 ) ||
+        ( muttley_opt.checks > MTL_CHECKS_MAX ) ) {
+        fprintf( stderr, "checks: failed sanity (valid range is 1..%d)\n",
+                 MTL_CHECKS_MAX );
         exit( exit_err_inv );
     }
 
-    // check that the number of successes is valid
+    // check that the number of successes is valid (when tuning without
+    // checks, the kernel extension checks it against those it runs with)
     if( ( muttley_opt.successes < 1 ) ||
-        ( muttley_opt.successes > muttley_opt.checks ) ) {
+        ( ( muttley_opt.successes > muttley_opt.checks ) &&
+          ( ( muttley_opt.action != action_tune ) ||
+            muttley_opt.tune.checks ) ) ) {
         fprintf( stderr, "successes: failed sanity check (valid range is "
                  "1..checks(%d))\n", muttley_opt.checks );
         exit( exit_err_inv );
     }
 
+    // check that the number of failed runs to execute behaviour is valid
+    if( ( muttley_opt.runs < 1 ) || ( muttley_opt.runs > MTL_RUNS_MAX ) ) {
+        fprintf( stderr, "runs: failed sanity check (valid range is "
+                 "1..%d)\n", MTL_RUNS_MAX );
+        exit( exit_err_inv );
+    }
+
     // check that the run interval is valid
-    if( ( muttley_opt.run_int < 1 ) || ( muttley_opt.run_int > 60 ) ) {
+    if( ( muttley_opt.run_int < 1 ) ||
+        ( muttley_opt.run_int > MTL_INTERVAL_MAX ) ) {
         fprintf( stderr, "run_int: failed sanity check (valid range is "
-                 "1..60)\n" );
+                 "1..%d)\n", MTL_INTERVAL_MAX );
+        exit( exit_err_inv );
+    }
+
+    // check that the number of workers is valid
+    if( ( muttley_opt.workers < 1 ) ||
+        ( muttley_opt.workers > MTL_WORKERS_MAX ) ) {
+        fprintf( stderr, "workers: failed sanity check (valid range is "
+                 "1..%d)\n", MTL_WORKERS_MAX );
+        exit( exit_err_inv );
+    }
+
+    // check that the num of checks per full one is valid
+    if( ( muttley_opt.full_every < 1 ) ||
+        ( muttley_opt.full_every > MTL_FULL_EVERY_MAX ) ) {
+        fprintf( stderr, "full_every: failed sanity check (valid range is "
+                 "1..%d)\n", MTL_FULL_EVERY_MAX );
+        exit( exit_err_inv );
+    }
+
+    // check that the query interval is valid, runs only come that often
+    // when most of their checks are queries
+    if( muttley_opt.query_ms &&
+        ( ( muttley_opt.query_ms < MTL_QUERY_MS_MIN ) ||
+          ( muttley_opt.query_ms > 999 ) ) ) {
+        fprintf( stderr, "query_ms: failed sanity check (valid range is "
+                 "%d..999)\n", MTL_QUERY_MS_MIN );
+        exit( exit_err_inv );
+    }
+    if( muttley_opt.query_ms && ( muttley_opt.full_every < 2 ) ) {
+        fprintf( stderr, "query_ms: needs tiered checks (-N full_every of 2 "
+                 "or more)\n" );
+        exit( exit_err_inv );
+    }
+
+    // check that the alert rate and coalescing time are valid
+    if( ( muttley_opt.alert_rate < 1 ) ||
+        ( muttley_opt.alert_rate > MTL_ALERT_RATE_MAX ) ) {
+        fprintf( stderr, "alert_rate: failed sanity check (valid range is "
+                 "1..%d)\n", MTL_ALERT_RATE_MAX );
+        exit( exit_err_inv );
+    }
+    if( ( muttley_opt.alert_coalesce < 0 ) ||
+        ( muttley_opt.alert_coalesce > 10000 ) ) {
+        fprintf( stderr, "coalesce: failed sanity check (valid range is "
+                 "0..10000)\n" );
+        exit( exit_err_inv );
+    }
+
+    // check that calibrate's goals are valid
+    if( ( muttley_opt.detect < 1 ) || ( muttley_opt.detect > 3600 ) ) {
+        fprintf( stderr, "detect: failed sanity check (valid range is "
+                 "1..3600)\n" );
+        exit( exit_err_inv );
+    }
+    if( muttley_opt.false_alarms <= 0.0 ) {
+        fprintf( stderr, "false_alarms: failed sanity check (must be > 0)\n" );
         exit( exit_err_inv );
     }
 
@@ -295,6 +1043,49 @@ int main( int argc, char ** argv ) {
         exit( exit_err_inv );
     }
 
+    // check that the heartbeat node is valid, there's no default, two nodes
+    // sharing a slot would hide each other's loss
+    if( muttley_opt.hb_device &&
+        ( ( muttley_opt.hb_node < 0 ) || ( muttley_opt.hb_node >= HB_SLOTS ) ) ) {
+        fprintf( stderr, "node: failed sanity check (must be given with -H, "
+                 "valid range is 0..%d)\n", HB_SLOTS - 1 );
+        exit( exit_err_inv );
+    }
+
+    // check that the heartbeat interval and timeout are valid
+    if( ( muttley_opt.hb_int < 10 ) || ( muttley_opt.hb_int > 10000 ) ) {
+        fprintf( stderr, "hb_int: failed sanity check (valid range is "
+                 "10..10000)\n" );
+        exit( exit_err_inv );
+    }
+    if( ( muttley_opt.hb_tmo < 2 * muttley_opt.hb_int ) ||
+        ( muttley_opt.hb_tmo > 60000 ) ) {
+        fprintf( stderr, "hb_tmo: failed sanity check (valid range is "
+                 "2*hb_int(%d)..60000)\n", 2 * muttley_opt.hb_int );
+        exit( exit_err_inv );
+    }
+
+    // check that the top refresh interval is valid
+    if( ( muttley_opt.refresh < 50 ) || ( muttley_opt.refresh > 10000 ) ) {
+        fprintf( stderr, "refresh: failed sanity check (valid range is "
+                 "50..10000)\n" );
+        exit( exit_err_inv );
+    }
+
+    // check that the command target is valid (it's checked against the
+    // number of targets when the command is sent)
+    if( muttley_opt.target < MTL_TARGET_ALL ) {
+        fprintf( stderr, "target: failed sanity check (must be >= 0)\n" );
+        exit( exit_err_inv );
+    }
+
+    // check that the top sort order is valid
+    if( muttley_opt.sort == -1 ) {
+        fprintf( stderr, "sort: invalid value specified (valid values"
+                 " are 'state', 'latency' or 'failures')\n" );
+        exit( exit_err_inv );
+    }
+
     // ok, everything looks good - though there may be some unnecessary
     // options in the command line, 'cause we are not validating that
     // ready to execute whatever was requested
@@ -307,30 +1098,18 @@ int main( int argc, char ** argv ) {
 int muttley( void ) {
 
     int r;
-    void * kern_handle;
     mid_t kmid;
 
     // for simplicity, and because we need it in multiple places just check
-    // if the kernel extension is loaded and setup the hook to the
-    // muttley_query system call
+    // if the kernel extension is loaded and setup the hooks to its system
+    // calls
 
-    if( ( kmid = kex_status( (char *)muttley_kex ) ) > 0 ) {     // is muttley_kex loaded?
-
-        // open the kernel :)
-        // woa, writing this comment made me feel knowledgeable
-        if( !( kern_handle = dlopen( "/unix", RTLD_NOW | RTLD_GLOBAL ) ) ) {
-            fprintf( stderr, "dlopen(/unix): %s\n", strerror( errno ) );
-            return( exit_err_sys );
-        }
-        muttley_query_syscall = (muttley_query_syscall_t)
-            dlsym( kern_handle, "muttley_query" );
-        dlclose( kern_handle );
-        if( ( !muttley_query_syscall ) && ( r = errno ) ) {
-            // this really should never happen, extension is loaded, but can't
-            // find the muttley_query system call - someone made a typo
-            fprintf( stderr, "dlsym(muttley_query): %s\n", strerror( r ) );
-            return( exit_err_int );
-        }
+    // the server, if there's one, did all of that already and does the
+    // system calls of the actions it knows of
+    if( ( ( kmid = muttley_ctl_open() ) < 0 ) &&
+        ( ( kmid = kex_status( (char *)muttley_kex ) ) > 0 ) ) {     // is muttley_kex loaded?
+        if( ( r = muttley_syscalls() ) )
+            return( r );
     } else if( kmid == -1 ) {
         fprintf( stderr, "failed getting muttley status\n" );
         return( exit_err_int );
@@ -350,12 +1129,52 @@ int muttley( void ) {
         case action_display:         // display current statistics
             r = muttley_display( kmid );
             break;
+        case action_top:         // full screen live view
+            r = muttley_top( kmid );
+            break;
+        case action_rollup:         // display rolling windows
+            r = muttley_rollups( kmid );
+            break;
+        case action_trace:         // stream the probe trace ring
+            r = muttley_trace_stream( kmid );
+            break;
+        case action_probe:         // send a command to the kernel proc
+        case action_pause:
+        case action_resume:
+        case action_reset:
+        case action_tune:
+            r = muttley_command_send( kmid );
+            break;
         case action_stop:         // stop the muttley kernel proc
             r = muttley_stop( kmid );
             break;
         case action_unload:         // unload the kernel extension
             r = muttley_unload( kmid );
             break;
+        case action_postmortem:         // decode a flight recorder file
+            r = muttley_postmortem();
+            break;
+        case action_hbpeer:         // run the heartbeat in user space
+            r = muttley_hbpeer();
+            break;
+        case action_discover:         // show the filesystems' volumes
+            r = muttley_discover();
+            break;
+        case action_serve:         // serve the control socket
+            r = muttley_serve();
+            break;
+        case action_bench:         // time the round trips
+            r = muttley_bench();
+            break;
+        case action_scale:         // time the workers' scaling
+            r = muttley_scale();
+            break;
+        case action_calibrate:         // measure the targets' baselines
+            r = muttley_calibrate();
+            break;
+        case action_validate:         // time loading and validating
+            r = muttley_validate();
+            break;
         default:         // this really shouldn't happen, ever...
             r = exit_err_int;
             break;
@@ -365,6 +1184,110 @@ int muttley( void ) {
 }
 
 
+// resolve the kernel extension's system calls, opening the kernel, returns 0
+// on success
+int muttley_syscalls( void ) {
+
+    int r;
+    void * kern_handle;
+
+    // open the kernel :)
+    // woa, writing this comment made me feel knowledgeable
+    if( !( kern_handle = dlopen( "/unix", RTLD_NOW | RTLD_GLOBAL ) ) ) {
+        fprintf( stderr, "dlopen(/unix): %s\n", strerror( errno ) );
+        return( exit_err_sys );
+    }
+    muttley_query_syscall = (muttley_query_syscall_t)
+        dlsym( kern_handle, "muttley_query" );
+    muttley_trace_syscall = (muttley_trace_syscall_t)
+        dlsym( kern_handle, "muttley_trace" );
+    muttley_snapshot_syscall = (muttley_snapshot_syscall_t)
+        dlsym( kern_handle, "muttley_snapshot" );
+    muttley_rollup_syscall = (muttley_rollup_syscall_t)
+        dlsym( kern_handle, "muttley_rollup" );
+    muttley_command_syscall = (muttley_command_syscall_t)
+        dlsym( kern_handle, "muttley_command" );
+    muttley_fence_syscall = (muttley_fence_syscall_t)
+        dlsym( kern_handle, "muttley_fence" );
+    dlclose( kern_handle );
+    if( ( !muttley_query_syscall ) && ( r = errno ) ) {
+        // this really should never happen, extension is loaded, but can't
+        // find the muttley_query system call - someone made a typo
+        fprintf( stderr, "dlsym(muttley_query): %s\n", strerror( r ) );
+        return( exit_err_int );
+    }
+    if( !muttley_trace_syscall ) {
+        fprintf( stderr, "dlsym(muttley_trace): %s\n", strerror( errno ) );
+        return( exit_err_int );
+    }
+    if( !muttley_snapshot_syscall ) {
+        fprintf( stderr, "dlsym(muttley_snapshot): %s\n",
+                 strerror( errno ) );
+        return( exit_err_int );
+    }
+    if( !muttley_rollup_syscall ) {
+        fprintf( stderr, "dlsym(muttley_rollup): %s\n", strerror( errno ) );
+        return( exit_err_int );
+    }
+    if( !muttley_command_syscall ) {
+        fprintf( stderr, "dlsym(muttley_command): %s\n",
+                 strerror( errno ) );
+        return( exit_err_int );
+    }
+    if( !muttley_fence_syscall ) {
+        fprintf( stderr, "dlsym(muttley_fence): %s\n", strerror( errno ) );
+        return( exit_err_int );
+    }
+
+    return( exit_ok );
+}
+
+
+// parse a deadline option, either 'ms' for every step or 'step=ms' for a
+// single one, returns 0 on success
+int muttley_parse_deadline( char * arg ) {
+
+    int i, ms;
+    char * eq, * end;
+
+    if( ( eq = strchr( arg, '=' ) ) )
+        ms = strtol( eq + 1, &end, 10 );
+    else
+        ms = strtol( arg, &end, 10 );
+    if( *end || ( end == ( eq ? eq + 1 : arg ) ) || ( ms < 0 ) ||
+        ( ms > 600000 ) )
+        return( 1 );
+
+    for( i = 0; i < mtl_step_sz; i++ ) {
+        if( !eq )
+            muttley_opt.deadline[ i ] = ms;
+        else if( ( strlen( step_str[ i ] ) == eq - arg ) &&
+                 !strncmp( step_str[ i ], arg, eq - arg ) ) {
+            muttley_opt.deadline[ i ] = ms;
+            return( 0 );
+        }
+    }
+    return( eq ? 1 : 0 );
+}
+
+
+// parse a 'device@offset' option, with offset a multiple of align, the
+// device is left in arg (the '@' is replaced by a '\0') and the offset in
+// *offset, returns 0 on success
+int muttley_parse_offset( char * arg, int align, uint64_t * offset ) {
+
+    char * at, * end;
+
+    if( !( at = strrchr( arg, '@' ) ) || ( at == arg ) || !at[ 1 ] )
+        return( 1 );
+    *offset = strtoull( at + 1, &end, 0 );
+    if( *end || ( *offset % align ) )
+        return( 1 );
+    *at = '\0';
+    return( 0 );
+}
+
+
 // load the kernel extension
 int muttley_load( mid_t kmid ) {
 
@@ -396,147 +1319,1224 @@ int muttley_status( mid_t kmid ) {
 }
 
 
-// start the muttley monitoring kernel proc, done in the extension's
-// entry function, called trough sysconfig
-int muttley_start( mid_t kmid ) {
+// create (or reuse) and preallocate the flight recorder file, which must not
+// live on any of the monitored devices (given in device_dev), returns 0 on
+// success
+int muttley_fr_create( dev_t * device_dev ) {
 
-    struct muttley_conf conf;
-    struct stat device_stat;
+    int fd, t;
+    struct stat fr_stat;
+    struct muttley_fr fr;
 
-    // if muttley is not loaded
-    if( !kmid ) {
-        fprintf( stderr, "muttley is not loaded, load it first\n" );
-        return( exit_not_rdy );
+    if( ( fd = open( muttley_opt.recorder, O_WRONLY | O_CREAT, S_IRUSR |
+                     S_IWUSR ) ) == EOF ) {
+        fprintf( stderr, "open(%s): %s\n", muttley_opt.recorder,
+                 strerror( errno ) );
+        return( 1 );
     }
 
-    // start muttley if it is not already running
-    if( !muttley_query_syscall( mtl_query_running ) ) {
-
-        // check if the file or device really exists
-        if( stat( muttley_opt.device, &device_stat ) == EOF ) {
-            fprintf( stderr, "stat(%s): %s\n", muttley_opt.device,
-                     strerror( errno ) );
-            return( exit_not_rdy );
+    // the recorder is written when a monitored device is lost, refuse
+    // to place it on any of those devices
+    if( fstat( fd, &fr_stat ) == EOF || !S_ISREG( fr_stat.st_mode ) ) {
+        fprintf( stderr, "%s: must be a regular file\n", muttley_opt.recorder );
+        close( fd );
+        return( 1 );
+    }
+    for( t = 0; t < muttley_opt.devices; t++ ) {
+        if( fr_stat.st_dev == device_dev[ t ] ) {
+            fprintf( stderr, "%s: must be on a device other than '%s'\n",
+                     muttley_opt.recorder, muttley_opt.device[ t ] );
+            close( fd );
+            return( 1 );
         }
+    }
 
-        // check if it is a character device, unless 'force' was specified
-        if( ( !muttley_opt.force ) &&
-            ( ( device_stat.st_mode & S_IFCHR ) == 0 ) ) {
-            fprintf( stderr, "%s: is not a character device\n",
-                     muttley_opt.device );
-            return( exit_not_rdy );
-        }
+    // write all of it now, so the kernel extension never needs to allocate
+    // blocks while writing it out
+    memset( &fr, 0, sizeof( fr ) );
+    fr.magic = MTL_FR_MAGIC;
+    fr.version = MTL_FR_VERSION;
+    if( write( fd, &fr, sizeof( fr ) ) != sizeof( fr ) || fsync( fd ) ) {
+        fprintf( stderr, "write(%s): %s\n", muttley_opt.recorder,
+                 strerror( errno ) );
+        close( fd );
+        return( 1 );
+    }
 
-        // fill in muttley's kex configuration data
-        strncpy( (char *)&conf.device, muttley_opt.device, PATH_MAX - 1 );
-        conf.behaviour = muttley_opt.behaviour;
-        conf.runs = muttley_opt.runs;
-        conf.checks = muttley_opt.checks;
-        conf.successes = muttley_opt.successes;
-        conf.interval = muttley_opt.run_int;
+    close( fd );
+    return( 0 );
+}
 
-        // and finally start the kernel proc
-        if( !kex_init( kmid, (void *)&conf, sizeof( conf ) ) ) {
-            fprintf( stderr, "muttley failed to start on '%s'\n",
-                     muttley_opt.device );
-            return( exit_err_sys );
+
+// load the targets listed in a target file, one per line as 'kind path'
+// (kind being read, canary or write, whose path is device@offset), '#'
+// starting a comment, the file is read at once and its paths interned as
+// they're parsed, returns 0 on success
+int muttley_targets_load( char * file ) {
+
+    int fd, t, o, line = 0;
+    ssize_t n;
+    uint64_t start = muttley_now(), offset = 0;
+    char * buf, * p, * eol, * c, * kind, * path;
+    struct stat st;
+
+    if( ( ( fd = open( file, O_RDONLY ) ) == EOF ) ||
+        ( fstat( fd, &st ) == EOF ) ) {
+        fprintf( stderr, "%s: %s\n", file, strerror( errno ) );
+        if( fd != EOF )
+            close( fd );
+        return( exit_err_inv );
+    }
+    if( !( buf = malloc( st.st_size + 1 ) ) ) {
+        fprintf( stderr, "malloc: %s\n", strerror( errno ) );
+        close( fd );
+        return( exit_err_sys );
+    }
+    n = read( fd, buf, st.st_size );
+    close( fd );
+    if( n != st.st_size ) {
+        fprintf( stderr, "%s: %s\n", file, ( n < 0 ) ? strerror( errno ) :
+                 "short read" );
+        free( buf );
+        return( exit_err_inv );
+    }
+    buf[ n ] = '\0';
+
+    for( p = buf; *p; p = eol ) {
+
+        line++;
+        if( ( eol = strchr( p, '\n' ) ) )
+            *eol++ = '\0';
+        else
+            eol = p + strlen( p );
+        if( ( c = strchr( p, '#' ) ) )
+            *c = '\0';
+        if( !( kind = strtok( p, " \t\r" ) ) )
+            continue;
+        path = strtok( NULL, " \t\r" );
+
+        for( t = 0; ( t < mtl_target_logical ) &&
+                    strcmp( target_type_str[ t ], kind ); t++ );
+        if( !path || ( t == mtl_target_logical ) || strtok( NULL, " \t\r" ) ||
+            ( ( t == mtl_target_write ) &&
+              muttley_parse_offset( path, MTL_SCRATCH_SZ, &offset ) ) ) {
+            fprintf( stderr, "%s:%d: invalid target (must be 'read device', "
+                     "'canary directory' or 'write device@offset', with "
+                     "offset a multiple of %d)\n", file, line,
+                     MTL_SCRATCH_SZ );
+            free( buf );
+            return( exit_err_inv );
         }
-        fprintf( stdout, "muttley started on '%s'\n", muttley_opt.device );
 
-    } else {
-        fprintf( stdout, "muttley is already running\n" );
+        if( muttley_opt.devices == MTL_TARGETS_MAX ) {
+            fprintf( stderr, "%s:%d: too many devices (maximum is %d)\n",
+                     file, line, MTL_TARGETS_MAX );
+            free( buf );
+            return( exit_err_inv );
+        }
+        if( ( o = intern_add( &paths, path ) ) == EOF ) {
+            fprintf( stderr, "%s:%d: too many paths (maximum is %d bytes)\n",
+                     file, line, MTL_PATHS_SZ );
+            free( buf );
+            return( exit_err_inv );
+        }
+        muttley_opt.device[ muttley_opt.devices ] = conf_paths + o;
+        muttley_opt.type[ muttley_opt.devices ] = t;
+        muttley_opt.offset[ muttley_opt.devices++ ] =
+            ( t == mtl_target_write ) ? offset : 0;
+        loader.loaded++;
     }
 
+    free( buf );
+    loader.file = file;
+    loader.load_time += muttley_now() - start;
     return( exit_ok );
 }
 
 
-// display statistics, mostly useful for debugging
-int muttley_display( mid_t kmid ) {
-
-    int c, running;
+// check a target exists, is of the right type and size and opens the way
+// the kernel extension opens it, filling in its part of the configuration,
+// returns what was found (see loader_res)
+int muttley_validate_target( int t ) {
 
-    running = muttley_query_syscall( mtl_query_running );
+    int fd;
+    struct stat st;
+    char * path = MTL_PATH( conf_paths, tconf, t );
 
+    tconf[ t ].type = muttley_opt.type[ t ];
+    tconf[ t ].offset = muttley_opt.offset[ t ];
 
-    if( muttley_opt.times == 1 ) {     // display one time statistics
-        fprintf( stdout, "\nmuttley %s running\n\n", running ?
-                 "is" : "is not" );
-        if( running ) {
-            fprintf( stdout, "lastest run\n" );
-            fprintf( stdout, "  time:        %12d (s)\n",
-                     muttley_query_syscall( mtl_query_last_time ) );
-            fprintf( stdout, "  result:      %12s\n",
-                     muttley_query_syscall( mtl_query_last_result ) ?
-                     "passed" : "failed" );
-            fprintf( stdout, "  successes:   %12d\n",
-                     muttley_query_syscall( mtl_query_last_successes ) );
-            fprintf( stdout, "  failures:    %12d\n\n",
-                     muttley_query_syscall( mtl_query_last_failures ) );
-            fprintf( stdout, "consecutive\n  failed runs: %12d\n\n",
-                     muttley_query_syscall( mtl_query_failed_runs ) );
-            fprintf( stdout, "total\n" );
-            fprintf( stdout, "  successes:   %12d\n",
-                     muttley_query_syscall( mtl_query_total_successes ) );
-            fprintf( stdout, "  failures:    %12d\n",
-                     muttley_query_syscall( mtl_query_total_failures ) );
-            fprintf( stdout, "\n" );
-        }
+    // check if the file or device really exists
+    if( stat( path, &st ) == EOF ) {
+        loader.error[ t ] = errno;
+        return( loader_stat );
+    }
 
-    } else {     // display running statistics
+    // canary targets must be directories
+    if( ( tconf[ t ].type == mtl_target_canary ) && !S_ISDIR( st.st_mode ) )
+        return( loader_dir );
 
-        for( c = 0; c < muttley_opt.times; c++ ) {
+    // a scratch block in a file must be within the file
+    if( ( tconf[ t ].type == mtl_target_write ) && S_ISREG( st.st_mode ) &&
+        ( st.st_size < tconf[ t ].offset + MTL_SCRATCH_SZ ) )
+        return( loader_small );
 
-            if( c % 10 == 0 )
-                fprintf( stdout, "count :      ltime :  lres : lsucc : "
-                         "lfail : cfail : tsucc : tfail\n" );
+    // check if it is a character device, unless 'force' was specified
+    if( ( tconf[ t ].type != mtl_target_canary ) && ( !muttley_opt.force ) &&
+        ( ( st.st_mode & S_IFCHR ) == 0 ) )
+        return( loader_chr );
 
-            fprintf( stdout, "%05d : ", c );
-            if( muttley_query_syscall( mtl_query_running ) ) {
-                fprintf( stdout, "%10d : ",
-                         muttley_query_syscall( mtl_query_last_time ) );
-                fprintf( stdout, "%5s : ",
-                         muttley_query_syscall( mtl_query_last_result ) ?
-                         "pass" : "fail" );
-                fprintf( stdout, "%5d : ",
-                         muttley_query_syscall( mtl_query_last_successes ) );
-                fprintf( stdout, "%5d : ",
-                         muttley_query_syscall( mtl_query_last_failures ) );
-                fprintf( stdout, "%5d : ",
-                         muttley_query_syscall( mtl_query_failed_runs ) );
-                fprintf( stdout, "%5d : ",
-                         muttley_query_syscall( mtl_query_total_successes ) );
-                fprintf( stdout, "%5d\n",
-                         muttley_query_syscall( mtl_query_total_failures ) );
-            } else
-                fprintf( stdout, "---------------------- not running"
-                         " -----------------------\n", c );
+    // keep the underlying device, for the flight recorder check
+    loader.dev[ t ] = S_ISCHR( st.st_mode ) ? st.st_rdev : st.st_dev;
+    // raw devices already bypass the cache, files need direct i/o
+    tconf[ t ].direct = S_ISREG( st.st_mode );
 
-            sleep( muttley_opt.disp_int );
+    // and it must open as the checks open it (logical targets aren't)
+    if( tconf[ t ].type != mtl_target_logical ) {
+        if( ( fd = open( path, ( tconf[ t ].type == mtl_target_write ) ?
+                         O_RDWR : O_RDONLY ) ) == EOF ) {
+            loader.error[ t ] = errno;
+            return( loader_open );
         }
+        close( fd );
     }
 
+    return( loader_ok );
 }
 
 
-// stop the kernel proc, through sysconfig
-int muttley_stop( mid_t kmid ) {
+// one of the validating threads, takes the next target until none are left
+void * muttley_validate_worker( void * arg ) {
 
-    if( !kmid ) {
-        fprintf( stderr, "nonsense, muttley is not even loaded\n" );
-        return( exit_not_rdy );
-    }
+    int t;
 
-    if( !muttley_query_syscall( mtl_query_running ) ) {
-        fprintf( stderr, "nonsense, muttley is not running\n" );
-        return( exit_not_rdy );
-    }
+    while( ( t = fetch_and_add( (atomic_p)&loader.next, 1 ) ) < conf.targets )
+        loader.res[ t ] = muttley_validate_target( t );
 
-    fprintf( stdout, "stopping muttley... " );
-    fflush( stdout );
-    if( kex_term( kmid, NULL, 0 ) )
-        fprintf( stdout, "success\n" );
-    else {
+    return( NULL );
+}
+
+
+// build the targets' part of the configuration in one pass, interning their
+// paths (those of a target file already are) and validating them across
+// LOADER_THREADS threads, since each check may wait on a slow device,
+// returns 0 on success
+int muttley_conf_targets( void ) {
+
+    int t, r, n = 0;
+    uint64_t start;
+    pthread_t thread[ LOADER_THREADS ];
+
+    conf.deps = 0;
+    if( muttley_opt.topology && ( r = muttley_topo_targets() ) )
+        return( r );
+
+    for( t = 0; t < muttley_opt.devices; t++ ) {
+        if( ( tconf[ t ].path =
+              intern_add( &paths, muttley_opt.device[ t ] ) ) == EOF ) {
+            fprintf( stderr, "device: too many paths (maximum is %d bytes)\n",
+                     MTL_PATHS_SZ );
+            return( exit_err_inv );
+        }
+    }
+    conf.paths_sz = paths.used;
+    conf.targets = muttley_opt.devices;
+    memcpy( conf.deadline, muttley_opt.deadline, sizeof( conf.deadline ) );
+    for( t = 0; t < conf.targets; t++ )
+        tconf[ t ].limit = tconf[ t ].query_limit = 0;
+
+    start = muttley_now();
+    loader.next = 0;
+    for( loader.threads = 0; ( loader.threads < LOADER_THREADS ) &&
+                             ( loader.threads < conf.targets );
+         loader.threads++ ) {
+        if( ( r = pthread_create( &thread[ loader.threads ], NULL,
+                                  muttley_validate_worker, NULL ) ) ) {
+            // those already there get through the targets just the same
+            if( loader.threads )
+                break;
+            fprintf( stderr, "pthread_create: %s\n", strerror( r ) );
+            return( exit_err_sys );
+        }
+    }
+    for( t = 0; t < loader.threads; t++ )
+        pthread_join( thread[ t ], NULL );
+    loader.validate_time = muttley_now() - start;
+
+    for( t = 0; t < conf.targets; t++ ) {
+        if( loader.res[ t ] == loader_ok )
+            continue;
+        if( n++ >= LOADER_ERRORS_MAX )
+            continue;
+        if( ( loader.res[ t ] == loader_stat ) ||
+            ( loader.res[ t ] == loader_open ) )
+            fprintf( stderr, "%s(%s): %s\n", loader_str[ loader.res[ t ] ],
+                     MTL_PATH( conf_paths, tconf, t ),
+                     strerror( loader.error[ t ] ) );
+        else
+            fprintf( stderr, "%s: %s\n", MTL_PATH( conf_paths, tconf, t ),
+                     loader_str[ loader.res[ t ] ] );
+    }
+    if( n > LOADER_ERRORS_MAX )
+        fprintf( stderr, "and %d more invalid target(s)\n",
+                 n - LOADER_ERRORS_MAX );
+
+    return( n ? exit_not_rdy : exit_ok );
+}
+
+
+// start the muttley monitoring kernel proc, done in the extension's
+// entry function, called trough sysconfig
+int muttley_start( mid_t kmid ) {
+
+    int t, r;
+    char * buf;
+
+    // if muttley is not loaded
+    if( !kmid ) {
+        fprintf( stderr, "muttley is not loaded, load it first\n" );
+        return( exit_not_rdy );
+    }
+
+    // start muttley if it is not already running
+    if( !muttley_query_syscall( mtl_query_running ) ) {
+
+        if( ( t = muttley_conf_targets() ) )
+            return( t );
+        if( muttley_opt.baseline && ( t = muttley_baseline_apply() ) )
+            return( t );
+        conf.recorder[ 0 ] = '\0';
+        if( muttley_opt.recorder ) {
+            if( muttley_fr_create( loader.dev ) )
+                return( exit_not_rdy );
+            strncpy( (char *)&conf.recorder, muttley_opt.recorder,
+                     PATH_MAX - 1 );
+        }
+        conf.alert_file[ 0 ] = '\0';
+        if( muttley_opt.alert_file )
+            strncpy( conf.alert_file, muttley_opt.alert_file, PATH_MAX - 1 );
+        conf.alert_rate = muttley_opt.alert_rate;
+        conf.alert_coalesce = muttley_opt.alert_coalesce;
+        conf.hb_device[ 0 ] = '\0';
+        if( muttley_opt.hb_device ) {
+            if( ( t = muttley_hb_check( &conf.hb_direct ) ) )
+                return( t );
+            strncpy( conf.hb_device, muttley_opt.hb_device, PATH_MAX - 1 );
+            conf.hb_offset = muttley_opt.hb_offset;
+            conf.hb_node = muttley_opt.hb_node;
+            conf.hb_interval = muttley_opt.hb_int;
+            conf.hb_timeout = muttley_opt.hb_tmo;
+        }
+        conf.behaviour = muttley_opt.behaviour;
+        conf.hook_timeout = 0;
+        if( muttley_opt.hook ) {
+            if( access( muttley_opt.hook, X_OK ) == EOF ) {
+                fprintf( stderr, "access(%s): %s\n", muttley_opt.hook,
+                         strerror( errno ) );
+                return( exit_not_rdy );
+            }
+            conf.hook_timeout = muttley_opt.hook_tmo;
+        }
+        conf.runs = muttley_opt.runs;
+        conf.checks = muttley_opt.checks;
+        conf.successes = muttley_opt.successes;
+        conf.interval = muttley_opt.run_int;
+        conf.workers = muttley_opt.workers;
+        conf.full_every = muttley_opt.full_every;
+        conf.query_ms = muttley_opt.query_ms;
+
+        // and finally start the kernel proc, passing the configuration in
+        // followed by only as many targets, and paths, as there are
+        if( !( buf = malloc( MTL_CONF_LEN( &conf ) ) ) ) {
+            fprintf( stderr, "malloc: %s\n", strerror( errno ) );
+            return( exit_err_sys );
+        }
+        memcpy( buf, &conf, sizeof( conf ) );
+        memcpy( buf + sizeof( conf ), tconf,
+                conf.targets * sizeof( tconf[ 0 ] ) );
+        memcpy( buf + sizeof( conf ) + conf.targets * sizeof( tconf[ 0 ] ),
+                conf_paths, conf.paths_sz );
+        r = ( ctl_fd != EOF ) ?
+            muttley_ctl_call( ctl_op_start, buf, MTL_CONF_LEN( &conf ) ) :
+            kex_init( kmid, buf, MTL_CONF_LEN( &conf ) );
+        free( buf );
+        if( !r ) {
+            fprintf( stderr, "muttley failed to start on '%s'%s\n",
+                     muttley_opt.device[ 0 ],
+                     muttley_opt.devices > 1 ? " (and others)" : "" );
+            return( exit_err_sys );
+        }
+        fprintf( stdout, "muttley started on '%s'", muttley_opt.device[ 0 ] );
+        if( muttley_opt.devices > 1 )
+            fprintf( stdout, " and %d other device(s)", muttley_opt.devices - 1 );
+        fprintf( stdout, "\n" );
+
+        // the hook daemon, and the hook, are started now, while the disks
+        // are still there
+        if( muttley_opt.hook && muttley_hookd_spawn() )
+            return( exit_err_sys );
+
+    } else {
+        fprintf( stdout, "muttley is already running\n" );
+    }
+
+    return( exit_ok );
+}
+
+
+// give each target the step deadline calibrated for it in the baseline file,
+// matched by path and kind, the records are sorted by id to look each
+// target up with a binary search, returns 0 on success
+int muttley_baseline_apply( void ) {
+
+    int n, t, matched = 0;
+    struct bsl_header bh;
+    struct bsl_target key, * found;
+    static struct bsl_target bt[ MTL_TARGETS_MAX ];
+
+    if( ( n = bsl_read( muttley_opt.baseline, &bh, bt, MTL_TARGETS_MAX ) ) ==
+        EOF ) {
+        fprintf( stderr, "baseline(%s): %s\n", muttley_opt.baseline,
+                 strerror( errno ) );
+        return( exit_not_rdy );
+    }
+
+    qsort( bt, n, sizeof( bt[ 0 ] ), bsl_cmp );
+    for( t = 0; t < conf.targets; t++ ) {
+        key.id = bsl_id( MTL_PATH( conf_paths, tconf, t ), tconf[ t ].type );
+        if( ( found = (struct bsl_target *)bsearch( &key, bt, n,
+                                                    sizeof( bt[ 0 ] ),
+                                                    bsl_cmp ) ) ) {
+            tconf[ t ].limit = found->deadline;
+            tconf[ t ].query_limit = found->query;
+            matched++;
+        }
+    }
+
+    fprintf( stdout, "baseline '%s' (calibrated for %u s): %d of %d targets "
+             "matched\n", muttley_opt.baseline, bh.period, matched,
+             conf.targets );
+    return( exit_ok );
+}
+
+
+// take a statistics snapshot into 'stats', keeping the previous one in
+// 'prev_stats', returns 0 on success
+int muttley_snapshot_take( void ) {
+
+    prev_stats = stats;
+    if( muttley_snapshot_syscall( &stats, sizeof( stats ) ) < 0 ) {
+        fprintf( stderr, "muttley_snapshot: %s\n", strerror( errno ) );
+        return( 1 );
+    }
+    if( stats.version != MTL_STATS_VERSION ) {
+        fprintf( stderr, "muttley_snapshot: unsupported statistics version "
+                 "%u\n", stats.version );
+        return( 1 );
+    }
+    return( 0 );
+}
+
+
+// per second rate of a counter between the previous and the latest snapshot
+double muttley_rate( uint64_t curr, uint64_t prev ) {
+
+    if( ( stats.time <= prev_stats.time ) || ( curr < prev ) )
+        return( 0.0 );
+    return( (double)( curr - prev ) * 1e9 / ( stats.time - prev_stats.time ) );
+}
+
+
+// display statistics, mostly useful for debugging
+int muttley_display( mid_t kmid ) {
+
+    int c, t, w;
+    struct sketch late;
+    struct muttley_target_stats * ts;
+    struct muttley_worker_stats * ws;
+    struct muttley_sink_stats * sk;
+
+    if( !kmid ) {
+        fprintf( stderr, "muttley is not loaded, load it first\n" );
+        return( exit_not_rdy );
+    }
+
+    if( muttley_snapshot_take() )
+        return( exit_err_sys );
+
+    if( muttley_opt.times == 1 ) {     // display one time statistics
+        fprintf( stdout, "\nmuttley %s running\n\n", stats.running ?
+                 "is" : "is not" );
+        if( stats.running ) {
+            fprintf( stdout, "lastest run\n" );
+            fprintf( stdout, "  time:        %12lu (s)\n",
+                     (unsigned long)( stats.last_time / 1000000000 ) );
+            fprintf( stdout, "  result:      %12s\n",
+                     stats.last_result ? "passed" : "failed" );
+            fprintf( stdout, "  successes:   %12d\n", stats.last_successes );
+            fprintf( stdout, "  failures:    %12d\n\n", stats.last_failures );
+            fprintf( stdout, "consecutive\n  failed runs: %12d\n\n",
+                     stats.failed_runs );
+            fprintf( stdout, "total\n" );
+            fprintf( stdout, "  runs:        %12lu\n",
+                     (unsigned long)stats.runs );
+            fprintf( stdout, "  failed runs: %12lu\n",
+                     (unsigned long)stats.failed_runs_total );
+            fprintf( stdout, "  successes:   %12lu\n",
+                     (unsigned long)stats.total_successes );
+            fprintf( stdout, "  failures:    %12lu\n",
+                     (unsigned long)stats.total_failures );
+            fprintf( stdout, "  commands:    %12lu\n",
+                     (unsigned long)stats.commands );
+            fprintf( stdout, "  skipped:     %12lu\n",
+                     (unsigned long)stats.skipped );
+            fprintf( stdout, "\n" );
+            // lateness is from the start of a run to the start of a check
+            sketch_clear( &late );
+            for( w = 0; w < stats.workers; w++ )
+                sketch_merge( &late, &stats.worker[ w ].late );
+            fprintf( stdout, "workers (check lateness p50 %lu us, p99 %lu "
+                     "us)\n", (unsigned long)( sketch_quantile(
+                         &late, 500 ) / 1000 ),
+                     (unsigned long)( sketch_quantile( &late,
+                                                       990 ) / 1000 ) );
+            fprintf( stdout, "worker :  cpu :    checked :     stolen :   "
+                     "busy (ms) : avg late (us) : max late (us)\n" );
+            for( w = 0; w < stats.workers; w++ ) {
+                ws = &stats.worker[ w ];
+                fprintf( stdout, "%6d : %4d : %10lu : %10lu : %11lu : "
+                         "%13lu : %13lu%s\n", w, ws->cpu,
+                         (unsigned long)ws->checked,
+                         (unsigned long)ws->stolen,
+                         (unsigned long)( ws->busy / 1000000 ),
+                         (unsigned long)( ws->checked ?
+                                          ws->lateness / ws->checked / 1000 :
+                                          0 ),
+                         (unsigned long)( ws->lateness_max / 1000 ),
+                         ws->running ? "" : " (not running)" );
+            }
+            fprintf( stdout, "\n" );
+            // targets are numbered in the order they were given to start
+            fprintf( stdout, "target :    kind :  lres : cfail :     probes :   "
+                     "failures : avg lat (us) : max lat (us)\n" );
+            for( t = 0; t < stats.targets; t++ ) {
+                ts = &stats.target[ t ];
+                fprintf( stdout, "%6d : %7s : %5s : %5d : %10lu : %10lu : "
+                         "%12lu : %12lu\n", t,
+                         ( ts->type >= 0 && ts->type < mtl_target_sz ) ?
+                         target_type_str[ ts->type ] : "-",
+                         ts->paused ? "pause" : ( ts->last_result ? "pass" :
+                                                  "fail" ), ts->failed_runs,
+                         (unsigned long)ts->probes,
+                         (unsigned long)ts->failures,
+                         (unsigned long)( ts->probes ?
+                                          ts->latency / ts->probes / 1000 : 0 ),
+                         (unsigned long)( ts->latency_max / 1000 ) );
+            }
+            fprintf( stdout, "\n" );
+            fprintf( stdout, "target : timeouts :   stalls : stalled : last "
+                     "duration of each step (us)\n" );
+            for( t = 0; t < stats.targets; t++ ) {
+                ts = &stats.target[ t ];
+                fprintf( stdout, "%6d : %8lu : %8lu : %7s :", t,
+                         (unsigned long)ts->timeouts,
+                         (unsigned long)ts->stalls,
+                         ( ts->stalled_step >= 0 &&
+                           ts->stalled_step < mtl_step_sz ) ?
+                         step_str[ ts->stalled_step ] : "-" );
+                for( c = 0; c < mtl_step_sz; c++ )
+                    if( ts->step_max[ c ] )
+                        fprintf( stdout, " %s %lu", step_str[ c ],
+                                 (unsigned long)( ts->step_latency[ c ] /
+                                                  1000 ) );
+                fprintf( stdout, "\n" );
+            }
+            fprintf( stdout, "\n" );
+            fprintf( stdout, "target :  queries : avg (us) : max (us) :    "
+                     "fulls : avg (us) : max (us) : escalated\n" );
+            for( t = 0; t < stats.targets; t++ ) {
+                ts = &stats.target[ t ];
+                fprintf( stdout, "%6d :", t );
+                for( c = 0; c < mtl_tier_sz; c++ )
+                    fprintf( stdout, " %8lu : %8lu : %8lu :",
+                             (unsigned long)ts->tier_probes[ c ],
+                             (unsigned long)( ts->tier_probes[ c ] ?
+                                              ts->tier_latency[ c ] /
+                                              ts->tier_probes[ c ] / 1000 : 0 ),
+                             (unsigned long)( ts->tier_max[ c ] / 1000 ) );
+                fprintf( stdout, " %9lu\n", (unsigned long)ts->escalations );
+            }
+            fprintf( stdout, "\n" );
+            if( stats.hb.node >= 0 ) {
+                fprintf( stdout, "heartbeat of node %d (every %d ms, peers "
+                         "stall after %d ms)\n", stats.hb.node,
+                         stats.hb.interval, stats.hb.timeout );
+                fprintf( stdout, "  running:     %12s\n",
+                         stats.hb.running ? "yes" : "no" );
+                fprintf( stdout, "  writes:      %12lu (%lu failed)\n",
+                         (unsigned long)stats.hb.writes,
+                         (unsigned long)stats.hb.write_errors );
+                fprintf( stdout, "  reads:       %12lu (%lu failed)\n",
+                         (unsigned long)stats.hb.reads,
+                         (unsigned long)stats.hb.read_errors );
+                fprintf( stdout, "  max latency: %12lu (us)\n",
+                         (unsigned long)( stats.hb.latency_max / 1000 ) );
+                fprintf( stdout, "  peers:       %12d alive, %d stalled\n\n",
+                         stats.hb.alive, stats.hb.stalled );
+                muttley_hb_peers( stats.hb.peer, stats.hb.node, stats.time );
+                fprintf( stdout, "\n" );
+            }
+            if( stats.fence.timeout ) {
+                fprintf( stdout, "fencing hook (must succeed within %d ms of "
+                         "detection)\n", stats.fence.timeout );
+                fprintf( stdout, "  daemons:     %12d waiting\n",
+                         stats.fence.daemons );
+                fprintf( stdout, "  state:       %12s\n",
+                         ( stats.fence.state >= 0 &&
+                           stats.fence.state < mtl_fence_sz ) ?
+                         fence_state_str[ stats.fence.state ] : "?" );
+                fprintf( stdout, "  escalations: %12lu (%lu failed)\n",
+                         (unsigned long)stats.fence.seq,
+                         (unsigned long)stats.fence.failures );
+                if( stats.fence.seq ) {
+                    fprintf( stdout, "  latest:      target %d, at %lu (s)\n",
+                             stats.fence.target, (unsigned long)(
+                                 stats.fence.detected / 1000000000 ) );
+                    if( stats.fence.woken )
+                        fprintf( stdout, "    woken up:  %12lu (us after "
+                                 "detection)\n", (unsigned long)(
+                                     ( stats.fence.woken -
+                                       stats.fence.detected ) / 1000 ) );
+                    if( stats.fence.started )
+                        fprintf( stdout, "    started:   %12lu (us after "
+                                 "detection)\n", (unsigned long)(
+                                     ( stats.fence.started -
+                                       stats.fence.detected ) / 1000 ) );
+                    if( stats.fence.finished )
+                        fprintf( stdout, "    finished:  %12lu (ms after "
+                                 "detection, exit %d)\n", (unsigned long)(
+                                     ( stats.fence.finished -
+                                       stats.fence.detected ) / 1000000 ),
+                                 stats.fence.status );
+                    fprintf( stdout, "  max woken:   %12lu (us)\n",
+                             (unsigned long)( stats.fence.wakeup_max / 1000 ) );
+                    fprintf( stdout, "  max started: %12lu (us)\n",
+                             (unsigned long)( stats.fence.start_max / 1000 ) );
+                }
+                fprintf( stdout, "\n" );
+            }
+            fprintf( stdout, "alerts (at most %d messages a minute per sink, "
+                     "gathered for %d ms)\n", stats.alert.rate,
+                     stats.alert.coalesce );
+            fprintf( stdout, "  running:     %12s\n",
+                     stats.alert.running ? "yes" : "no" );
+            fprintf( stdout, "  raised:      %12lu (%lu dropped, %d queued)\n",
+                     (unsigned long)stats.alert.raised,
+                     (unsigned long)stats.alert.dropped, stats.alert.queued );
+            fprintf( stdout, "  batches:     %12lu\n",
+                     (unsigned long)stats.alert.batches );
+            fprintf( stdout, "  max latency: %12lu (us, detection to "
+                     "emission)\n",
+                     (unsigned long)( stats.alert.latency_max / 1000 ) );
+            fprintf( stdout, "sink    :   messages :     alerts :    limited :"
+                     "   errors : avg lat (us) : max lat (us)\n" );
+            for( c = 0; c < mtl_sink_sz; c++ ) {
+                sk = &stats.alert.sink[ c ];
+                fprintf( stdout, "%-7s : %10lu : %10lu : %10lu : %8lu : "
+                         "%12lu : %12lu\n", sink_str[ c ],
+                         (unsigned long)sk->messages,
+                         (unsigned long)sk->alerts,
+                         (unsigned long)sk->limited,
+                         (unsigned long)sk->errors,
+                         (unsigned long)( sk->messages ?
+                                          sk->latency / sk->messages / 1000 :
+                                          0 ),
+                         (unsigned long)( sk->latency_max / 1000 ) );
+            }
+            fprintf( stdout, "\n" );
+            muttley_overhead();
+        }
+
+    } else {     // display running statistics
+
+        for( c = 0; c < muttley_opt.times; c++ ) {
+
+            if( c % 10 == 0 )
+                fprintf( stdout, "count :      ltime :  lres : cfail : "
+                         "probes/s : fails/s :      tsucc :      tfail\n" );
+
+            fprintf( stdout, "%05d : ", c );
+            if( stats.running ) {
+                fprintf( stdout, "%10lu : ",
+                         (unsigned long)( stats.last_time / 1000000000 ) );
+                fprintf( stdout, "%5s : ", stats.last_result ? "pass" : "fail" );
+                fprintf( stdout, "%5d : ", stats.failed_runs );
+                fprintf( stdout, "%8.2f : ",
+                         c ? muttley_rate( stats.total_successes +
+                                           stats.total_failures,
+                                           prev_stats.total_successes +
+                                           prev_stats.total_failures ) : 0.0 );
+                fprintf( stdout, "%7.2f : ",
+                         c ? muttley_rate( stats.total_failures,
+                                           prev_stats.total_failures ) : 0.0 );
+                fprintf( stdout, "%10lu : ",
+                         (unsigned long)stats.total_successes );
+                fprintf( stdout, "%10lu\n",
+                         (unsigned long)stats.total_failures );
+            } else
+                fprintf( stdout, "--------------------------- not running"
+                         " ---------------------------\n" );
+
+            fflush( stdout );
+            if( c + 1 < muttley_opt.times ) {
+                sleep( muttley_opt.disp_int );
+                if( muttley_snapshot_take() )
+                    return( exit_err_sys );
+            }
+        }
+    }
+
+    return( exit_ok );
+}
+
+
+// cpu time (in ns) and voluntary and involuntary context switches of a
+// kernel proc, as accounted for it by the kernel, returns 0 on success
+int muttley_proc_usage( int pid, uint64_t * usage ) {
+
+    pid_t index = pid;
+    struct procentry64 pe;
+
+    if( ( pid <= 0 ) ||
+        ( getprocs64( &pe, sizeof( pe ), NULL, 0, &index, 1 ) != 1 ) ||
+        ( pe.pi_pid != pid ) )
+        return( 1 );
+
+    // procentry64's tv_usec actually holds nanoseconds
+    usage[ 0 ] = (uint64_t)( pe.pi_ru.ru_utime.tv_sec +
+                             pe.pi_ru.ru_stime.tv_sec ) * 1000000000 +
+        pe.pi_ru.ru_utime.tv_usec + pe.pi_ru.ru_stime.tv_usec;
+    usage[ 1 ] = pe.pi_ru.ru_nvcsw;
+    usage[ 2 ] = pe.pi_ru.ru_nivcsw;
+    return( 0 );
+}
+
+
+// display a kernel proc's overhead, adding it to the total
+void muttley_overhead_proc( char * name, int pid, uint64_t wakeups,
+                            uint64_t * total ) {
+
+    uint64_t usage[ 3 ];
+
+    if( muttley_proc_usage( pid, usage ) ) {
+        fprintf( stdout, "%-12s : %8d : %10s : %10s : %10s : %10lu\n", name,
+                 pid, "-", "-", "-", (unsigned long)wakeups );
+        total[ 3 ] += wakeups;
+        return;
+    }
+    fprintf( stdout, "%-12s : %8d : %10lu : %10lu : %10lu : %10lu\n", name, pid,
+             (unsigned long)( usage[ 0 ] / 1000000 ), (unsigned long)usage[ 1 ],
+             (unsigned long)usage[ 2 ], (unsigned long)wakeups );
+    total[ 0 ] += usage[ 0 ];
+    total[ 1 ] += usage[ 1 ];
+    total[ 2 ] += usage[ 2 ];
+    total[ 3 ] += wakeups;
+}
+
+
+// display what monitoring cost since it started, overall and per target,
+// the kernel procs' cpu time and context switches are the kernel's own
+// accounting, the rest is counted by the kernel extension itself, the
+// kernel doesn't account anything per target, so the workers' cpu time,
+// context switches and wakeups are shared out across the targets in
+// proportion to their checks
+void muttley_overhead( void ) {
+
+    int t, w;
+    char name[ 16 ];
+    uint64_t total[ 4 ] = { 0, 0, 0, 0 }, probes = 0, calls = 0, bytes = 0;
+    uint64_t workers[ 4 ] = { 0, 0, 0, 0 };
+    double share;
+    uint64_t elapsed = ( stats.time > stats.start ) ? stats.time - stats.start :
+        0;
+    struct muttley_target_stats * ts;
+
+    fprintf( stdout, "overhead (over %lu s)\n",
+             (unsigned long)( elapsed / 1000000000 ) );
+    fprintf( stdout, "  syscalls:    %12lu\n",
+             (unsigned long)stats.overhead.syscalls );
+    fprintf( stdout, "kernel proc  :      pid :   cpu (ms) :   vol csw : "
+             " invol csw :    wakeups\n" );
+    muttley_overhead_proc( "muttley", stats.overhead.kproc_pid,
+                           stats.overhead.kproc_wakeups, total );
+    if( stats.overhead.hb_pid )
+        muttley_overhead_proc( "heartbeat", stats.overhead.hb_pid,
+                               stats.overhead.hb_wakeups, total );
+    muttley_overhead_proc( "alert", stats.overhead.alert_pid,
+                           stats.overhead.alert_wakeups, total );
+    muttley_overhead_proc( "command", stats.overhead.command_pid,
+                           stats.overhead.command_wakeups, total );
+    for( w = 0; w < stats.workers; w++ ) {
+        sprintf( name, "worker %d", w );
+        muttley_overhead_proc( name, stats.worker[ w ].pid,
+                               stats.worker[ w ].wakeups, workers );
+    }
+    for( w = 0; w < 4; w++ )
+        total[ w ] += workers[ w ];
+    fprintf( stdout, "%-12s : %8s : %10lu : %10lu : %10lu : %10lu\n", "total",
+             "", (unsigned long)( total[ 0 ] / 1000000 ),
+             (unsigned long)total[ 1 ], (unsigned long)total[ 2 ],
+             (unsigned long)total[ 3 ] );
+
+    for( t = 0; t < stats.targets; t++ ) {
+        probes += stats.target[ t ].probes;
+        calls += stats.target[ t ].io_calls;
+        bytes += stats.target[ t ].io_bytes;
+    }
+    fprintf( stdout, "  processor:   %12.4f (%% of one)\n", elapsed ?
+             (double)total[ 0 ] * 100 / elapsed : 0.0 );
+    fprintf( stdout, "  per check:   %12lu (us of cpu)\n",
+             (unsigned long)( probes ? total[ 0 ] / probes / 1000 : 0 ) );
+    if( stats.overhead.hb_pid )
+        fprintf( stdout, "  heartbeat:   %12lu i/o calls, %lu bytes\n",
+                 (unsigned long)stats.overhead.hb_io_calls,
+                 (unsigned long)stats.overhead.hb_io_bytes );
+    fprintf( stdout, "  checks:      %12lu i/o calls, %lu bytes\n\n",
+             (unsigned long)calls, (unsigned long)bytes );
+
+    // busy is the wall clock time spent checking a target, not its cpu
+    // time, which like its context switches and wakeups is the workers'
+    // shared out by checks (an estimate, checks of some targets cost more)
+    fprintf( stdout, "busy is wall clock time, cpu, csw and wakeups are the "
+             "workers' shared out by probes\n" );
+    fprintf( stdout, "target :     probes :   i/o calls :    i/o bytes :   "
+             "busy (ms) :   cpu (us) :        csw :    wakeups\n" );
+    for( t = 0; t < stats.targets; t++ ) {
+        ts = &stats.target[ t ];
+        share = probes ? (double)ts->probes / probes : 0.0;
+        fprintf( stdout, "%6d : %10lu : %11lu : %12lu : %11lu : %10lu : "
+                 "%10lu : %10lu\n", t,
+                 (unsigned long)ts->probes, (unsigned long)ts->io_calls,
+                 (unsigned long)ts->io_bytes,
+                 (unsigned long)( ts->latency / 1000000 ),
+                 (unsigned long)( workers[ 0 ] * share / 1000 ),
+                 (unsigned long)( ( workers[ 1 ] + workers[ 2 ] ) * share ),
+                 (unsigned long)( workers[ 3 ] * share ) );
+    }
+    fprintf( stdout, "\n" );
+}
+
+
+// compare two targets (by index into 'stats') in the top sort order, for
+// qsort, ties are broken by target index to keep the order stable
+int muttley_top_cmp( const void * a, const void * b ) {
+
+    struct muttley_target_stats * ta = &stats.target[ *(const int *)a ];
+    struct muttley_target_stats * tb = &stats.target[ *(const int *)b ];
+
+    switch( muttley_opt.sort ) {
+        case top_sort_state:
+            if( ta->failed_runs != tb->failed_runs )
+                return( ta->failed_runs > tb->failed_runs ? -1 : 1 );
+            if( ta->last_result != tb->last_result )
+                return( ta->last_result < tb->last_result ? -1 : 1 );
+            break;
+        case top_sort_latency:
+            if( ta->last_latency != tb->last_latency )
+                return( ta->last_latency > tb->last_latency ? -1 : 1 );
+            break;
+        case top_sort_failures:
+            if( ta->failures != tb->failures )
+                return( ta->failures > tb->failures ? -1 : 1 );
+            break;
+    }
+    return( *(const int *)a - *(const int *)b );
+}
+
+
+// full screen view of every target, sorted and refreshed every 'refresh'
+// ms, each frame is rendered from a single snapshot into a screen buffer
+// and only the cells which changed since the previous frame are redrawn
+int muttley_top( mid_t kmid ) {
+
+    int r, t, c, first, last, rows, cols, frame = 0;
+    int order[ MTL_TARGETS_MAX ];
+    uint64_t prev_probes[ MTL_TARGETS_MAX ], prev_failures[ MTL_TARGETS_MAX ];
+    char line[ TOP_COLS_MAX + 64 ], clock[ 16 ];
+    static char screen[ TOP_ROWS_MAX ][ TOP_COLS_MAX + 1 ];
+    static char shown[ TOP_ROWS_MAX ][ TOP_COLS_MAX + 1 ];
+    struct muttley_target_stats * ts;
+    struct winsize ws;
+    struct timeval start, end;
+    time_t now;
+    long elapsed;
+    double secs;
+
+    if( !kmid ) {
+        fprintf( stderr, "muttley is not loaded, load it first\n" );
+        return( exit_not_rdy );
+    }
+
+    signal( SIGINT, muttley_interrupt );
+    memset( prev_probes, 0, sizeof( prev_probes ) );
+    memset( prev_failures, 0, sizeof( prev_failures ) );
+
+    // hide the cursor, everything is drawn with absolute positioning
+    fprintf( stdout, "\033[?25l" );
+
+    while( !interrupted ) {
+
+        gettimeofday( &start, NULL );
+
+        // on start and whenever the terminal is resized, redraw everything
+        rows = 24;
+        cols = 80;
+        if( !ioctl( fileno( stdout ), TIOCGWINSZ, &ws ) && ws.ws_row &&
+            ws.ws_col ) {
+            rows = ws.ws_row;
+            cols = ws.ws_col;
+        }
+        rows = rows > TOP_ROWS_MAX ? TOP_ROWS_MAX : rows;
+        cols = cols > TOP_COLS_MAX ? TOP_COLS_MAX : cols;
+        if( !frame || ( shown[ 0 ][ cols ] != '\0' ) ||
+            ( shown[ rows - 1 ][ 0 ] == '\0' ) ) {
+            fprintf( stdout, "\033[H\033[2J" );
+            memset( shown, ' ', sizeof( shown ) );
+            for( r = 0; r < TOP_ROWS_MAX; r++ )
+                shown[ r ][ r < rows ? cols : 0 ] = '\0';
+        }
+
+        if( muttley_snapshot_take() ) {
+            fprintf( stdout, "\033[?25h" );
+            return( exit_err_sys );
+        }
+        secs = frame ? ( stats.time - prev_stats.time ) / 1e9 : 0.0;
+
+        // render the frame
+        now = stats.time / 1000000000;
+        strftime( clock, sizeof( clock ), "%H:%M:%S", localtime( &now ) );
+        snprintf( line, sizeof( line ), "muttley top - %s, %d targets, "
+                  "%lu runs, %lu failed, worst cfail %d, sorted by %s, %s",
+                  stats.running ? "running" : "NOT RUNNING", stats.targets,
+                  (unsigned long)stats.runs,
+                  (unsigned long)stats.failed_runs_total, stats.failed_runs,
+                  top_sort_str[ muttley_opt.sort ], clock );
+        snprintf( screen[ 0 ], cols + 1, "%-*s", cols, line );
+        line[ 0 ] = '\0';
+        if( stats.hb.node >= 0 )
+            snprintf( line, sizeof( line ), "heartbeat of node %d - %s, %d "
+                      "peers alive, %d STALLED, last beat %lu ms ago",
+                      stats.hb.node, stats.hb.running ? "running" :
+                      "NOT RUNNING", stats.hb.alive, stats.hb.stalled,
+                      (unsigned long)( stats.time > stats.hb.last_time ?
+                                       ( stats.time - stats.hb.last_time ) /
+                                       1000000 : 0 ) );
+        snprintf( screen[ 1 ], cols + 1, "%-*s", cols, line );
+        snprintf( screen[ 2 ], cols + 1, "%-*s", cols, " target : state "
+                  ": cfail :  probes/s : fails/s :  last (us) :   avg (us) "
+                  ":   max (us) :   failures" );
+
+        for( t = 0; t < stats.targets; t++ )
+            order[ t ] = t;
+        qsort( order, stats.targets, sizeof( int ), muttley_top_cmp );
+
+        for( r = TOP_HEADER_SZ; r < rows; r++ ) {
+            if( r - TOP_HEADER_SZ >= stats.targets ) {
+                snprintf( screen[ r ], cols + 1, "%-*s", cols, "" );
+                continue;
+            }
+            t = order[ r - TOP_HEADER_SZ ];
+            ts = &stats.target[ t ];
+            snprintf( line, sizeof( line ), " %6d : %5s : %5d : %9.1f : "
+                      "%7.1f : %10lu : %10lu : %10lu : %10lu", t,
+                      ts->paused ? "pause" : ts->failed_runs ? "FAIL" :
+                      ( ts->last_result ? "ok" : "warn" ),
+                      ts->failed_runs,
+                      secs > 0 ? ( ts->probes - prev_probes[ t ] ) / secs : 0.0,
+                      secs > 0 ? ( ts->failures - prev_failures[ t ] ) / secs :
+                      0.0,
+                      (unsigned long)( ts->last_latency / 1000 ),
+                      (unsigned long)( ts->probes ?
+                                       ts->latency / ts->probes / 1000 : 0 ),
+                      (unsigned long)( ts->latency_max / 1000 ),
+                      (unsigned long)ts->failures );
+            snprintf( screen[ r ], cols + 1, "%-*s", cols, line );
+        }
+
+        for( t = 0; t < stats.targets; t++ ) {
+            prev_probes[ t ] = stats.target[ t ].probes;
+            prev_failures[ t ] = stats.target[ t ].failures;
+        }
+
+        // and draw only what changed, i.e. from the first to the last
+        // changed cell of each line
+        for( r = 0; r < rows; r++ ) {
+            for( first = 0; ( first < cols ) &&
+                 ( screen[ r ][ first ] == shown[ r ][ first ] ); first++ )
+                ;
+            if( first == cols )
+                continue;
+            for( last = cols - 1; screen[ r ][ last ] == shown[ r ][ last ];
+                 last-- )
+                ;
+            fprintf( stdout, "\033[%d;%dH", r + 1, first + 1 );
+            for( c = first; c <= last; c++ )
+                putc( screen[ r ][ c ], stdout );
+            memcpy( shown[ r ], screen[ r ], cols + 1 );
+        }
+        fflush( stdout );
+        frame++;
+
+        // sleep for what's left of the refresh interval
+        gettimeofday( &end, NULL );
+        elapsed = ( end.tv_sec - start.tv_sec ) * 1000000 +
+            ( end.tv_usec - start.tv_usec );
+        if( elapsed < muttley_opt.refresh * 1000 )
+            usleep( muttley_opt.refresh * 1000 - elapsed );
+    }
+
+    // leave the cursor below the view
+    fprintf( stdout, "\033[%d;1H\033[?25h\n", rows );
+    return( exit_ok );
+}
+
+
+// display each target's rolling windows, i.e. the checks, failure rate and
+// latency percentiles of the last minute, hour and day
+int muttley_rollups( mid_t kmid ) {
+
+    int t, w;
+    struct muttley_rollup r;
+
+    if( !kmid ) {
+        fprintf( stderr, "muttley is not loaded, load it first\n" );
+        return( exit_not_rdy );
+    }
+
+    if( muttley_snapshot_take() )
+        return( exit_err_sys );
+    if( !stats.running ) {
+        fprintf( stdout, "\nmuttley is not running\n\n" );
+        return( exit_ok );
+    }
+
+    fprintf( stdout, "target : window :     checks :  fail %% :   p50 (us) :"
+             "   p90 (us) :   p99 (us) :   max (us)\n" );
+    for( t = 0; t < stats.targets; t++ ) {
+        for( w = 0; w < mtl_window_sz; w++ ) {
+            if( muttley_rollup_syscall( t, w, &r ) ) {
+                fprintf( stderr, "muttley_rollup: %s\n", strerror( errno ) );
+                return( exit_err_sys );
+            }
+            fprintf( stdout, "%6d : %6s : %10u : %7.3f : %10lu : %10lu : "
+                     "%10lu : %10lu\n", t, window_str[ w ], r.probes,
+                     r.probes ? 100.0 * r.failures / r.probes : 0.0,
+                     (unsigned long)( sketch_quantile( &r.latency, 500 ) / 1000 ),
+                     (unsigned long)( sketch_quantile( &r.latency, 900 ) / 1000 ),
+                     (unsigned long)( sketch_quantile( &r.latency, 990 ) / 1000 ),
+                     (unsigned long)( r.latency_max / 1000 ) );
+        }
+    }
+
+    return( exit_ok );
+}
+
+
+// SIGINT handler, streaming actions check the flag and return cleanly
+void muttley_interrupt( int sig ) {
+
+    interrupted = true;
+}
+
+
+// stream probe events from the kernel extension's trace ring, until
+// interrupted or until the kernel proc stops and the ring is drained
+int muttley_trace_stream( mid_t kmid ) {
+
+    int c, n, lines = 0;
+    uint64_t overruns = 0;
+    struct muttley_trace_pos pos;
+    struct muttley_event events[ TRACE_BATCH_SZ ];
+
+    if( !kmid ) {
+        fprintf( stderr, "muttley is not loaded, load it first\n" );
+        return( exit_not_rdy );
+    }
+
+    signal( SIGINT, muttley_interrupt );
+    memset( &pos, 0, sizeof( pos ) );
+
+    while( !interrupted ) {
+
+        if( ( n = muttley_trace_syscall( &pos, events, TRACE_BATCH_SZ ) ) < 0 ) {
+            fprintf( stderr, "muttley_trace: %s\n", strerror( errno ) );
+            return( exit_err_sys );
+        }
+
+        // the writer never waits for us, report what we've missed
+        if( pos.overruns != overruns ) {
+            fprintf( stdout, "----- %lu events lost (%lu in total) -----\n",
+                     (unsigned long)( pos.overruns - overruns ),
+                     (unsigned long)pos.overruns );
+            overruns = pos.overruns;
+        }
+
+        for( c = 0; c < n; c++, lines++ ) {
+            if( lines % 20 == 0 )
+                fprintf( stdout, "         seq :             start (s) : "
+                         "target :  res :  latency (us) : errno\n" );
+            fprintf( stdout, "%12lu : %10lu.%09lu : %6d : %4s : %13lu : %5d\n",
+                     (unsigned long)events[ c ].seq,
+                     (unsigned long)( events[ c ].start / 1000000000 ),
+                     (unsigned long)( events[ c ].start % 1000000000 ),
+                     events[ c ].target,
+                     events[ c ].result ? "pass" : "fail",
+                     (unsigned long)( events[ c ].latency / 1000 ),
+                     events[ c ].error );
+        }
+
+        if( n < TRACE_BATCH_SZ ) {
+            fflush( stdout );
+            if( !n && !muttley_query_syscall( mtl_query_running ) )
+                break;
+            usleep( TRACE_POLL_US );
+        }
+    }
+
+    fprintf( stdout, "%lu events lost while tracing\n",
+             (unsigned long)pos.overruns );
+    return( exit_ok );
+}
+
+
+// send a command (probe, pause, resume, reset or tune, by action) to the
+// kernel proc, for 'target' or for every target (tune is always for every
+// target), a probe of every target is sent as one command per target (in
+// batches) so each one's result is shown
+int muttley_command_send( mid_t kmid ) {
+
+    int c, n, t, first, last, failed = 0;
+    long elapsed;
+    struct muttley_command cmd[ MTL_COMMAND_BATCH ];
+    struct timeval start, end;
+
+    if( !kmid ) {
+        fprintf( stderr, "muttley is not loaded, load it first\n" );
+        return( exit_not_rdy );
+    }
+
+    if( muttley_snapshot_take() )
+        return( exit_err_sys );
+    if( !stats.running ) {
+        fprintf( stderr, "nonsense, muttley is not running\n" );
+        return( exit_not_rdy );
+    }
+    if( muttley_opt.target >= stats.targets ) {
+        fprintf( stderr, "target: there's no target %d (valid range is "
+                 "0..%d)\n", muttley_opt.target, stats.targets - 1 );
+        return( exit_err_inv );
+    }
+
+    if( muttley_opt.action == action_tune ) {
+        memset( cmd, 0, sizeof( cmd[ 0 ] ) );
+        cmd[ 0 ].type = mtl_command_tune;
+        cmd[ 0 ].target = MTL_TARGET_ALL;
+        cmd[ 0 ].tune = muttley_opt.tune;
+        if( !( muttley_opt.tune.interval || muttley_opt.tune.runs ||
+               muttley_opt.tune.checks || muttley_opt.tune.successes ||
+               muttley_opt.tune.full_every || muttley_opt.tune.alert_rate ) ) {
+            fprintf( stderr, "tune: nothing to change (give any of -c, -s, "
+                     "-r, -i, -N or -A)\n" );
+            return( exit_err_inv );
+        }
+        if( muttley_command_syscall( cmd, 1 ) < 0 ) {
+            fprintf( stderr, "muttley_command: %s\n", strerror( errno ) );
+            return( exit_err_sys );
+        }
+        if( !cmd[ 0 ].result ) {
+            fprintf( stderr, "tune: %s (successes can't be more than "
+                     "checks)\n", strerror( cmd[ 0 ].error ) );
+            return( exit_err_inv );
+        }
+        fprintf( stdout, "tune done\n" );
+        return( exit_ok );
+    }
+
+    if( muttley_opt.action != action_probe ) {
+        memset( cmd, 0, sizeof( cmd[ 0 ] ) );
+        cmd[ 0 ].type = ( muttley_opt.action == action_pause ) ?
+            mtl_command_pause : ( muttley_opt.action == action_resume ) ?
+            mtl_command_resume : mtl_command_reset;
+        cmd[ 0 ].target = muttley_opt.target;
+        if( muttley_command_syscall( cmd, 1 ) < 0 ) {
+            fprintf( stderr, "muttley_command: %s\n", strerror( errno ) );
+            return( exit_err_sys );
+        }
+        if( muttley_opt.target == MTL_TARGET_ALL )
+            fprintf( stdout, "%s done on all targets\n",
+                     actions_str[ muttley_opt.action ] );
+        else
+            fprintf( stdout, "%s done on target %d\n",
+                     actions_str[ muttley_opt.action ], muttley_opt.target );
+        return( exit_ok );
+    }
+
+    first = ( muttley_opt.target == MTL_TARGET_ALL ) ? 0 : muttley_opt.target;
+    last = ( muttley_opt.target == MTL_TARGET_ALL ) ? stats.targets :
+        muttley_opt.target + 1;
+
+    fprintf( stdout, "target :  res : errno :  latency (us) : round trip (us)\n" );
+    for( t = first; t < last; t += n ) {
+
+        n = ( last - t > MTL_COMMAND_BATCH ) ? MTL_COMMAND_BATCH : last - t;
+        memset( cmd, 0, n * sizeof( cmd[ 0 ] ) );
+        for( c = 0; c < n; c++ ) {
+            cmd[ c ].type = mtl_command_probe;
+            cmd[ c ].target = t + c;
+        }
+
+        gettimeofday( &start, NULL );
+        if( muttley_command_syscall( cmd, n ) < 0 ) {
+            fprintf( stderr, "muttley_command: %s\n", strerror( errno ) );
+            return( exit_err_sys );
+        }
+        gettimeofday( &end, NULL );
+        elapsed = ( end.tv_sec - start.tv_sec ) * 1000000 +
+            ( end.tv_usec - start.tv_usec );
+
+        // the round trip is the whole batch's
+        for( c = 0; c < n; c++ ) {
+            fprintf( stdout, "%6d : %4s : %5d : %13lu : %15ld\n",
+                     cmd[ c ].target, cmd[ c ].result ? "pass" : "fail",
+                     cmd[ c ].error,
+                     (unsigned long)( cmd[ c ].latency / 1000 ), elapsed );
+            failed += !cmd[ c ].result;
+        }
+    }
+
+    return( failed ? exit_failed : exit_ok );
+}
+
+
+// stop the kernel proc, through sysconfig
+int muttley_stop( mid_t kmid ) {
+
+    if( !kmid ) {
+        fprintf( stderr, "nonsense, muttley is not even loaded\n" );
+        return( exit_not_rdy );
+    }
+
+    if( !muttley_query_syscall( mtl_query_running ) ) {
+        fprintf( stderr, "nonsense, muttley is not running\n" );
+        return( exit_not_rdy );
+    }
+
+    fprintf( stdout, "stopping muttley... " );
+    fflush( stdout );
+    if( ( ctl_fd != EOF ) ? muttley_ctl_call( ctl_op_stop, NULL, 0 ) :
+        kex_term( kmid, NULL, 0 ) )
+        fprintf( stdout, "success\n" );
+    else {
         fprintf( stderr, "failed\n" );
         return( exit_err_int );
     }
@@ -545,28 +2545,1664 @@ int muttley_stop( mid_t kmid ) {
 }
 
 
-// unload the kernel extension, note that it stays resident
-// to remove it from memory, execute 'slibclean' on the shell
-int muttley_unload( mid_t kmid ) {
+// unload the kernel extension, note that it stays resident
+// to remove it from memory, execute 'slibclean' on the shell
+int muttley_unload( mid_t kmid ) {
+
+    if( kmid ) {
+
+        // if muttley is running, don't unload
+        if( muttley_query_syscall &&
+            muttley_query_syscall( mtl_query_running ) ) {
+            fprintf( stderr, "muttley is running, stop it prior to trying "
+                     "unload or bad things will happen\n" );
+            return( exit_not_rdy );
+        }
+
+        if( !kex_unload( kmid ) ) {
+            fprintf( stderr, "muttley unload failed\n" );
+            return( exit_err_sys );
+        } else
+            fprintf( stdout, "muttley was successfully unloaded\n" );
+
+    } else
+        fprintf( stdout, "muttley is not loaded, skipping unload\n" );
+
+    return( exit_ok );
+}
+
+
+// decode a flight recorder file, showing the latest runs from the oldest
+// to the most recent, doesn't need the kernel extension
+int muttley_postmortem( void ) {
+
+    int fd, c;
+    uint64_t i, first;
+    struct muttley_fr fr;
+    struct muttley_fr_run * run;
+    struct muttley_fr_check * check;
+
+    if( !muttley_opt.recorder ) {
+        fprintf( stderr, "recorder: a flight recorder file must be specified\n" );
+        return( exit_err_inv );
+    }
+
+    if( ( fd = open( muttley_opt.recorder, O_RDONLY ) ) == EOF ) {
+        fprintf( stderr, "open(%s): %s\n", muttley_opt.recorder,
+                 strerror( errno ) );
+        return( exit_err_sys );
+    }
+    c = read( fd, &fr, sizeof( fr ) );
+    close( fd );
+
+    if( ( c != sizeof( fr ) ) || ( fr.magic != MTL_FR_MAGIC ) ) {
+        fprintf( stderr, "%s: not a muttley flight recorder\n",
+                 muttley_opt.recorder );
+        return( exit_err_inv );
+    }
+    if( fr.version != MTL_FR_VERSION ) {
+        fprintf( stderr, "%s: unsupported flight recorder version %u\n",
+                 muttley_opt.recorder, fr.version );
+        return( exit_err_inv );
+    }
+    if( ( fr.reason <= mtl_fr_reason_none ) || ( fr.reason >= mtl_fr_reason_sz ) ) {
+        fprintf( stdout, "\nflight recorder was never written out\n\n" );
+        return( exit_ok );
+    }
+
+    fprintf( stdout, "\nflight recorder\n" );
+    fprintf( stdout, "  started:     %12lu (s)\n",
+             (unsigned long)( fr.start / 1000000000 ) );
+    fprintf( stdout, "  written:     %12lu (s)\n",
+             (unsigned long)( fr.written / 1000000000 ) );
+    fprintf( stdout, "  reason:      %s\n", fr_reason_str[ fr.reason ] );
+    fprintf( stdout, "  behaviour:   %12s\n",
+             ( fr.behaviour >= 0 && fr.behaviour < mtl_behaviour_sz ) ?
+             behaviour_str[ fr.behaviour ] : "?" );
+    fprintf( stdout, "  checks:      %12d\n", fr.checks );
+    fprintf( stdout, "  successes:   %12d\n", fr.successes );
+    fprintf( stdout, "  interval:    %12d (s)\n", fr.interval );
+    if( fr.query_ms )
+        fprintf( stdout, "  query_ms:    %12d (ms, instead)\n", fr.query_ms );
+    fprintf( stdout, "  runs:        %12lu\n\n", (unsigned long)fr.runs );
+
+    first = fr.runs > MTL_FR_RUNS ? fr.runs - MTL_FR_RUNS : 0;
+    fprintf( stdout, "    run :       time (s) :  res : succ : fail : "
+             "cfail/runs : checks (target:latency us:errno)\n" );
+    for( i = first; i < fr.runs; i++ ) {
+        run = &fr.run[ i % MTL_FR_RUNS ];
+        fprintf( stdout, "%7lu : %10lu.%03lu : %4s : %4d : %4d : %5d/%-4d :",
+                 (unsigned long)i,
+                 (unsigned long)( run->time / 1000000000 ),
+                 (unsigned long)( run->time % 1000000000 / 1000000 ),
+                 run->result ? "pass" : "fail", run->successes,
+                 run->failures, run->failed_runs, run->runs );
+        for( c = 0; ( c < run->checks ) && ( c < MTL_FR_CHECKS ); c++ ) {
+            check = &run->check[ c ];
+            fprintf( stdout, " %d:%u:%d", check->target, check->latency,
+                     check->error );
+        }
+        if( run->checks > MTL_FR_CHECKS )
+            fprintf( stdout, " (+%d)", run->checks - MTL_FR_CHECKS );
+        fprintf( stdout, "\n" );
+    }
+    fprintf( stdout, "\n" );
+
+    return( exit_ok );
+}
+
+
+// check the heartbeat device, it must be a character device (unless 'force'
+// was specified) and a file must hold the whole region, *direct is set when
+// direct i/o is needed (i.e. for a file), returns 0 on success
+int muttley_hb_check( int * direct ) {
+
+    struct stat hb_stat;
+
+    if( stat( muttley_opt.hb_device, &hb_stat ) == EOF ) {
+        fprintf( stderr, "stat(%s): %s\n", muttley_opt.hb_device,
+                 strerror( errno ) );
+        return( exit_not_rdy );
+    }
+    if( !muttley_opt.force && !S_ISCHR( hb_stat.st_mode ) ) {
+        fprintf( stderr, "%s: is not a character device\n",
+                 muttley_opt.hb_device );
+        return( exit_not_rdy );
+    }
+    if( S_ISREG( hb_stat.st_mode ) &&
+        ( hb_stat.st_size < muttley_opt.hb_offset + HB_REGION_SZ ) ) {
+        fprintf( stderr, "%s: is too small for a heartbeat region at %lu "
+                 "(%d bytes)\n", muttley_opt.hb_device,
+                 (unsigned long)muttley_opt.hb_offset, HB_REGION_SZ );
+        return( exit_not_rdy );
+    }
+
+    // raw devices already bypass the cache, files need direct i/o
+    *direct = S_ISREG( hb_stat.st_mode );
+    return( 0 );
+}
+
+
+// display the heartbeat peers which were ever seen, as of 'now'
+void muttley_hb_peers( struct hb_peer * peer, int node, uint64_t now ) {
+
+    int n;
+
+    fprintf( stdout, "  peer :   state :      beats :  stalls : last change "
+             "(ms ago) : max gap (ms) : int (ms)\n" );
+    for( n = 0; n < HB_SLOTS; n++ ) {
+        if( ( n == node ) || !peer[ n ].seen )
+            continue;
+        fprintf( stdout, "  %4d : %7s : %10lu : %7lu : %22lu : %12lu : %8d\n",
+                 n, ( peer[ n ].state >= 0 && peer[ n ].state < hb_state_sz ) ?
+                 hb_state_str[ peer[ n ].state ] : "?",
+                 (unsigned long)peer[ n ].beats,
+                 (unsigned long)peer[ n ].stalls,
+                 (unsigned long)( now > peer[ n ].seen ?
+                                  ( now - peer[ n ].seen ) / 1000000 : 0 ),
+                 (unsigned long)( peer[ n ].gap_max / 1000000 ),
+                 peer[ n ].interval );
+    }
+}
+
+
+// run the heartbeat alone in user space as node 'hb_node', writing our slot
+// and following the peers exactly as the kernel extension does, until
+// interrupted, so that several nodes can share a single file on a single
+// machine (the kernel extension can only be started once), peers' state
+// changes are shown as they happen, doesn't need the kernel extension
+int muttley_hbpeer( void ) {
+
+    int fd, n, r, w, direct, failing = false;
+    uint64_t seq, start, now, interval, timeout;
+    void * buf;
+    struct hb_slot * own, * region;
+    struct hb_peer peer[ HB_SLOTS ];
+    struct timeval tv;
+
+    if( !muttley_opt.hb_device ) {
+        fprintf( stderr, "heartbeat: a heartbeat device must be specified\n" );
+        return( exit_err_inv );
+    }
+    if( ( r = muttley_hb_check( &direct ) ) )
+        return( r );
+
+    // not every filesystem does direct i/o, O_DSYNC alone will do for a try
+    if( ( ( fd = open( muttley_opt.hb_device, O_RDWR | O_DSYNC |
+                       ( direct ? O_DIRECT : 0 ) ) ) == EOF ) &&
+        ( !direct || ( errno != EINVAL ) ||
+          ( fd = open( muttley_opt.hb_device, O_RDWR | O_DSYNC ) ) == EOF ) ) {
+        fprintf( stderr, "open(%s): %s\n", muttley_opt.hb_device,
+                 strerror( errno ) );
+        return( exit_err_sys );
+    }
+
+    // the region followed by our own slot, page aligned for direct i/o
+    if( posix_memalign( &buf, 4096, HB_REGION_SZ + HB_SLOT_SZ ) ) {
+        fprintf( stderr, "posix_memalign: %s\n", strerror( errno ) );
+        close( fd );
+        return( exit_err_sys );
+    }
+    region = (struct hb_slot *)buf;
+    own = (struct hb_slot *)( (char *)buf + HB_REGION_SZ );
+    interval = (uint64_t)muttley_opt.hb_int * 1000000;
+    timeout = (uint64_t)muttley_opt.hb_tmo * 1000000;
+
+    signal( SIGINT, muttley_interrupt );
+    memset( peer, 0, sizeof( peer ) );
+    gettimeofday( &tv, NULL );
+    seq = (uint64_t)tv.tv_sec * 1000000000 + tv.tv_usec * 1000;
+
+    fprintf( stdout, "node %d beating every %d ms on '%s', peers stall after "
+             "%d ms\n", muttley_opt.hb_node, muttley_opt.hb_int,
+             muttley_opt.hb_device, muttley_opt.hb_tmo );
+    fflush( stdout );
+
+    while( !interrupted ) {
+
+        gettimeofday( &tv, NULL );
+        start = (uint64_t)tv.tv_sec * 1000000000 + tv.tv_usec * 1000;
+
+        hb_slot_fill( own, muttley_opt.hb_node, ++seq, start,
+                      muttley_opt.hb_int );
+        w = pwrite( fd, own, HB_SLOT_SZ, muttley_opt.hb_offset +
+                    muttley_opt.hb_node * HB_SLOT_SZ ) != HB_SLOT_SZ;
+        r = pread( fd, region, HB_REGION_SZ,
+                   muttley_opt.hb_offset ) != HB_REGION_SZ;
+
+        gettimeofday( &tv, NULL );
+        now = (uint64_t)tv.tv_sec * 1000000000 + tv.tv_usec * 1000;
+
+        // report i/o failures once, until the i/o works again
+        if( ( w || r ) != failing ) {
+            failing = w || r;
+            fprintf( stdout, "%10lu.%03lu : heartbeat %s\n",
+                     (unsigned long)( now / 1000000000 ),
+                     (unsigned long)( now % 1000000000 / 1000000 ),
+                     failing ? ( w ? "write failed" : "read failed" ) :
+                     "i/o recovered" );
+        }
+
+        for( n = 0; !r && ( n < HB_SLOTS ); n++ ) {
+            if( ( n == muttley_opt.hb_node ) ||
+                !hb_peer_update( &peer[ n ], &region[ n ], n, now, timeout ) )
+                continue;
+            fprintf( stdout, "%10lu.%03lu : peer %d %s", (unsigned long)( now /
+                     1000000000 ), (unsigned long)( now % 1000000000 / 1000000 ),
+                     n, hb_state_str[ peer[ n ].state ] );
+            if( peer[ n ].state == hb_state_stalled )
+                fprintf( stdout, ", no change for %lu ms",
+                         (unsigned long)( ( now - peer[ n ].seen ) / 1000000 ) );
+            fprintf( stdout, "\n" );
+        }
+        fflush( stdout );
+
+        // sleep until the next heartbeat is due, right away if we're late
+        gettimeofday( &tv, NULL );
+        now = (uint64_t)tv.tv_sec * 1000000000 + tv.tv_usec * 1000;
+        if( start + interval > now )
+            usleep( ( start + interval - now ) / 1000 );
+    }
+
+    fprintf( stdout, "\n" );
+    muttley_hb_peers( peer, muttley_opt.hb_node, now );
+    fprintf( stdout, "\n" );
+
+    free( buf );
+    close( fd );
+    return( exit_ok );
+}
+
+
+// check that a name found by muttley_topology() is fit to be given to the
+// lvm commands (and is just a name), returns 0 if it is
+int muttley_topo_name( char * name ) {
+
+    if( !*name || ( strlen( name ) >= TOPO_NAME_SZ ) ||
+        ( strspn( name, "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ"
+                  "0123456789_.-" ) != strlen( name ) ) )
+        return( 1 );
+
+    return( 0 );
+}
+
+
+// find the mounted jfs and jfs2 filesystems (mntctl), and for each of them
+// the physical volumes its logical volume is on (lslv), into 'topo', returns
+// 0 on success
+int muttley_topology( void ) {
+
+    int i, j, n, l, p, copies[ 3 ], size = sizeof( int );
+    char * buf, * tmp, * object, cmd[ 128 ], line[ 256 ];
+    char pv[ TOPO_NAME_SZ ];
+    struct vmount * vm;
+    FILE * lslv;
+
+    // mntctl tells how much room it needs when it's given too little
+    if( !( buf = malloc( size ) ) ) {
+        fprintf( stderr, "malloc: %s\n", strerror( errno ) );
+        return( exit_err_sys );
+    }
+    while( ( n = mntctl( MCTL_QUERY, size, buf ) ) == 0 ) {
+        size = *(int *)buf;
+        if( !( tmp = realloc( buf, size ) ) ) {
+            fprintf( stderr, "realloc: %s\n", strerror( errno ) );
+            free( buf );
+            return( exit_err_sys );
+        }
+        buf = tmp;
+    }
+    if( n < 0 ) {
+        fprintf( stderr, "mntctl: %s\n", strerror( errno ) );
+        free( buf );
+        return( exit_err_sys );
+    }
+
+    topo.lvs = topo.pvs = 0;
+    for( i = 0, vm = (struct vmount *)buf; i < n;
+         i++, vm = (struct vmount *)( (char *)vm + vm->vmt_length ) ) {
+
+        // only local filesystems on logical volumes
+        object = vmt2dataptr( vm, VMT_OBJECT );
+        if( ( ( vm->vmt_gfstype != MNT_J2 ) && ( vm->vmt_gfstype != MNT_JFS ) )
+            || strncmp( object, "/dev/", 5 ) || muttley_topo_name( object + 5 ) )
+            continue;
+        if( topo.lvs == TOPO_LVS_MAX ) {
+            fprintf( stderr, "discover: too many filesystems (maximum is "
+                     "%d)\n", TOPO_LVS_MAX );
+            free( buf );
+            return( exit_err_inv );
+        }
+        l = topo.lvs++;
+        strncpy( topo.lv[ l ].fs, vmt2dataptr( vm, VMT_STUB ), PATH_MAX - 1 );
+        strcpy( topo.lv[ l ].lv, object + 5 );
+        topo.lv[ l ].mirrored = false;
+        topo.lv[ l ].pvs = 0;
+
+        // after two header lines, lslv lists a 'pv copies' line per physical
+        // volume, copies being how many of the first, second and third copy
+        // of the logical partitions are on it
+        snprintf( cmd, sizeof( cmd ), "/usr/sbin/lslv -l %s 2>/dev/null",
+                  topo.lv[ l ].lv );
+        if( !( lslv = popen( cmd, "r" ) ) ) {
+            fprintf( stderr, "popen(%s): %s\n", cmd, strerror( errno ) );
+            free( buf );
+            return( exit_err_sys );
+        }
+        for( p = 0; fgets( line, sizeof( line ), lslv ); p++ ) {
+            if( ( p < 2 ) || ( sscanf( line, "%31s %d:%d:%d", pv, &copies[ 0 ],
+                                       &copies[ 1 ], &copies[ 2 ] ) != 4 ) ||
+                muttley_topo_name( pv ) )
+                continue;
+            if( copies[ 1 ] || copies[ 2 ] )
+                topo.lv[ l ].mirrored = true;
+            if( topo.lv[ l ].pvs == TOPO_PVS_MAX )
+                continue;
+            // each physical volume is kept once, however many are on it
+            for( j = 0; ( j < topo.pvs ) && strcmp( topo.pv[ j ], pv ); j++ );
+            if( j == topo.pvs ) {
+                if( topo.pvs == MTL_TARGETS_MAX )
+                    continue;
+                strcpy( topo.pv[ topo.pvs++ ], pv );
+            }
+            topo.lv[ l ].pv[ topo.lv[ l ].pvs++ ] = j;
+        }
+        pclose( lslv );
+
+        // a filesystem on nothing found (e.g. lslv failed) isn't kept
+        if( !topo.lv[ l ].pvs ) {
+            fprintf( stderr, "discover: no physical volumes found for '%s' "
+                     "(%s), skipped\n", topo.lv[ l ].fs, topo.lv[ l ].lv );
+            topo.lvs--;
+        }
+    }
+
+    free( buf );
+    if( !topo.lvs ) {
+        fprintf( stderr, "discover: no mounted jfs or jfs2 filesystems "
+                 "found\n" );
+        return( exit_not_rdy );
+    }
+
+    return( exit_ok );
+}
+
+
+// add what muttley_topology() finds to the targets, each physical volume
+// as a read target (unless already given) and each logical volume as a
+// logical target on them, returns 0 on success
+int muttley_topo_targets( void ) {
+
+    int l, p, t, r, target[ MTL_TARGETS_MAX ];
+    char path[ PATH_MAX ];
+
+    if( ( r = muttley_topology() ) )
+        return( r );
+
+    for( p = 0; p < topo.pvs + topo.lvs; p++ ) {
+
+        if( p < topo.pvs )
+            snprintf( path, sizeof( path ), "/dev/r%s", topo.pv[ p ] );
+        else
+            snprintf( path, sizeof( path ), "/dev/r%s",
+                      topo.lv[ p - topo.pvs ].lv );
+
+        // a physical volume given on the command line is checked just once
+        for( t = 0; ( p < topo.pvs ) && ( t < muttley_opt.devices ); t++ )
+            if( ( muttley_opt.type[ t ] == mtl_target_read ) &&
+                !strcmp( muttley_opt.device[ t ], path ) )
+                break;
+        if( ( p < topo.pvs ) && ( t < muttley_opt.devices ) ) {
+            target[ p ] = t;
+            continue;
+        }
+
+        if( muttley_opt.devices == MTL_TARGETS_MAX ) {
+            fprintf( stderr, "device: too many devices (maximum is %d)\n",
+                     MTL_TARGETS_MAX );
+            return( exit_err_inv );
+        }
+        t = muttley_opt.devices++;
+        if( ( r = intern_add( &paths, path ) ) == EOF ) {
+            fprintf( stderr, "device: too many paths (maximum is %d bytes)\n",
+                     MTL_PATHS_SZ );
+            return( exit_err_inv );
+        }
+        muttley_opt.device[ t ] = conf_paths + r;
+        muttley_opt.offset[ t ] = 0;
+        if( p < topo.pvs ) {
+            muttley_opt.type[ t ] = mtl_target_read;
+            target[ p ] = t;
+            continue;
+        }
+
+        // a logical volume is on all of its physical volumes
+        l = p - topo.pvs;
+        muttley_opt.type[ t ] = mtl_target_logical;
+        tconf[ t ].mirrored = topo.lv[ l ].mirrored;
+        for( r = 0; r < topo.lv[ l ].pvs; r++ ) {
+            if( conf.deps == MTL_DEPS_MAX ) {
+                fprintf( stderr, "device: too many dependencies (maximum is "
+                         "%d)\n", MTL_DEPS_MAX );
+                return( exit_err_inv );
+            }
+            conf.dep[ conf.deps ].target = t;
+            conf.dep[ conf.deps++ ].source = target[ topo.lv[ l ].pv[ r ] ];
+        }
+    }
+
+    return( exit_ok );
+}
+
+
+// show the mounted filesystems, the logical and physical volumes they're on
+// and the paths to those (lspath), i.e. what -g monitors
+int muttley_discover( void ) {
+
+    int l, p, r, reads = 0;
+    char cmd[ 128 ], line[ 128 ], status[ 32 ], parent[ 32 ];
+    FILE * lspath;
+
+    if( ( r = muttley_topology() ) )
+        return( r );
+
+    fprintf( stdout, "filesystem                     : logical volume   : "
+             "mirrored : physical volumes\n" );
+    for( l = 0; l < topo.lvs; l++ ) {
+        fprintf( stdout, "%-30s : %-16s : %8s :", topo.lv[ l ].fs,
+                 topo.lv[ l ].lv, topo.lv[ l ].mirrored ? "yes" : "no" );
+        for( p = 0; p < topo.lv[ l ].pvs; p++ )
+            fprintf( stdout, " %s", topo.pv[ topo.lv[ l ].pv[ p ] ] );
+        fprintf( stdout, "\n" );
+        reads += topo.lv[ l ].pvs;
+    }
+
+    // the paths are below the physical volumes, a read of one takes any
+    // of them, so they're just shown
+    fprintf( stdout, "\nphysical volume  : paths (parent status)\n" );
+    for( p = 0; p < topo.pvs; p++ ) {
+        fprintf( stdout, "%-16s :", topo.pv[ p ] );
+        snprintf( cmd, sizeof( cmd ), "/usr/sbin/lspath -l %s -F 'parent "
+                  "status' 2>/dev/null", topo.pv[ p ] );
+        if( ( lspath = popen( cmd, "r" ) ) ) {
+            while( fgets( line, sizeof( line ), lspath ) )
+                if( sscanf( line, "%31s %31s", parent, status ) == 2 )
+                    fprintf( stdout, " %s %s", parent, status );
+            pclose( lspath );
+        }
+        fprintf( stdout, "\n" );
+    }
+
+    fprintf( stdout, "\n%d filesystem(s) on %d physical volume(s), a check "
+             "reads %d device(s) instead of %d\n", topo.lvs, topo.pvs,
+             topo.pvs, reads );
+
+    return( exit_ok );
+}
+
+
+// SIGCHLD handler, for the hook daemon to notice its hook exited
+void muttley_hook_exited( int sig ) {
+
+    hook_exited = true;
+}
+
+
+// start the fencing hook with a pipe on its standard input, so it's ready
+// before it's needed, returns its pid (or -1) and the pipe in *fd
+pid_t muttley_hook_spawn( int * fd ) {
+
+    int p[ 2 ];
+    pid_t pid;
+
+    if( pipe( p ) == EOF ) {
+        fprintf( stderr, "muttley: pipe: %s\n", strerror( errno ) );
+        return( EOF );
+    }
+    if( !( pid = fork() ) ) {
+        dup2( p[ 0 ], 0 );
+        close( p[ 0 ] );
+        close( p[ 1 ] );
+        execl( muttley_opt.hook, muttley_opt.hook, (char *)NULL );
+        _exit( 127 );
+    }
+    close( p[ 0 ] );
+    if( pid == EOF ) {
+        fprintf( stderr, "muttley: fork: %s\n", strerror( errno ) );
+        close( p[ 1 ] );
+        return( EOF );
+    }
+
+    *fd = p[ 1 ];
+    return( pid );
+}
+
+
+// the hook daemon, locked in memory, waits in muttley_fence for the hook to
+// be needed, hands the escalation to the hook already running, and tells
+// muttley when it started and how it finished, until monitoring stops
+int muttley_hookd( void ) {
+
+    int fd = EOF, status, n;
+    pid_t pid = EOF;
+    char line[ PATH_MAX + 128 ];
+    struct muttley_fence f;
+    struct sigaction sa;
+    struct timeval tv;
+    uint64_t now;
+
+    // the disks may be gone when we're needed, so nothing of ours may have
+    // to be paged in then
+    if( mlockall( MCL_CURRENT | MCL_FUTURE ) == EOF )
+        fprintf( stderr, "muttley: mlockall: %s\n", strerror( errno ) );
+
+    // a hook exiting early interrupts the wait (no SA_RESTART), and one
+    // exiting without reading its line mustn't kill us
+    memset( &sa, 0, sizeof( sa ) );
+    sa.sa_handler = muttley_hook_exited;
+    sigemptyset( &sa.sa_mask );
+    sigaction( SIGCHLD, &sa, NULL );
+    signal( SIGPIPE, SIG_IGN );
+
+    memset( &f, 0, sizeof( f ) );
+    for( ;; ) {
+
+        if( pid == EOF )
+            pid = muttley_hook_spawn( &fd );
+
+        if( muttley_fence_syscall( mtl_fence_wait, &f ) == EOF ) {
+            if( errno != EINTR )
+                break;
+            // the hook exited before being needed, start it again (but
+            // not in a tight loop)
+            if( hook_exited ) {
+                hook_exited = false;
+                if( ( pid != EOF ) && ( waitpid( pid, &status, WNOHANG ) ==
+                                        pid ) ) {
+                    fprintf( stderr, "muttley: hook '%s' exited before being "
+                             "needed\n", muttley_opt.hook );
+                    close( fd );
+                    pid = EOF;
+                    sleep( 1 );
+                }
+            }
+            continue;
+        }
+
+        // the hook starts fencing as soon as it reads its line
+        n = snprintf( line, sizeof( line ), "%lu %d %s %d\n",
+                      (unsigned long)f.seq, f.target, ( f.target >= 0 &&
+                      f.target < muttley_opt.devices ) ?
+                      muttley_opt.device[ f.target ] : "-", f.failed_runs );
+        status = ( ( pid == EOF ) || ( write( fd, line, n ) != n ) ) ? 127 : 0;
+        muttley_fence_syscall( mtl_fence_started, &f );
+        gettimeofday( &tv, NULL );
+        now = (uint64_t)tv.tv_sec * 1000000000 + tv.tv_usec * 1000;
+        if( pid != EOF ) {
+            close( fd );
+            while( ( waitpid( pid, &n, 0 ) == EOF ) && ( errno == EINTR ) )
+                ;
+            if( !status )
+                status = WIFEXITED( n ) ? WEXITSTATUS( n ) :
+                    128 + WTERMSIG( n );
+        }
+        pid = EOF;
+        hook_exited = false;
+        f.status = status;
+        muttley_fence_syscall( mtl_fence_finished, &f );
+        fprintf( stderr, "muttley: hook '%s' started %lu us after detection, "
+                 "exited with %d\n", muttley_opt.hook,
+                 (unsigned long)( now > f.detected ?
+                                  ( now - f.detected ) / 1000 : 0 ), status );
+    }
+
+    if( pid != EOF ) {
+        close( fd );
+        kill( pid, SIGTERM );
+        waitpid( pid, &status, 0 );
+    }
+    return( exit_ok );
+}
+
+
+// start the hook daemon, detached from us and logging to the console,
+// returns 0 on success
+int muttley_hookd_spawn( void ) {
+
+    int fd;
+    pid_t pid;
+
+    fflush( stdout );
+    fflush( stderr );
+    if( ( pid = fork() ) == EOF ) {
+        fprintf( stderr, "fork: %s\n", strerror( errno ) );
+        return( 1 );
+    }
+    if( pid )
+        return( 0 );
+
+    // the hook daemon makes its own system calls, not the server's
+    if( ctl_fd != EOF ) {
+        close( ctl_fd );
+        ctl_fd = EOF;
+        if( ( kex_status( (char *)muttley_kex ) <= 0 ) || muttley_syscalls() )
+            exit( exit_err_int );
+    }
+
+    setsid();
+    chdir( "/" );
+    if( ( fd = open( "/dev/null", O_RDONLY ) ) != EOF ) {
+        dup2( fd, 0 );
+        close( fd );
+    }
+    if( ( ( fd = open( "/dev/console", O_WRONLY | O_NOCTTY ) ) != EOF ) ||
+        ( ( fd = open( "/dev/null", O_WRONLY ) ) != EOF ) ) {
+        dup2( fd, 1 );
+        dup2( fd, 2 );
+        close( fd );
+    }
+    exit( muttley_hookd() );
+}
+
+
+// connect to the server for the actions it knows of, returns the kmid it
+// has (0 if not loaded), or -1 when there's no server to use
+int muttley_ctl_open( void ) {
+
+    int r, e;
+
+    switch( muttley_opt.action ) {
+        case action_status:
+        case action_start:
+        case action_display:
+        case action_top:
+        case action_probe:
+        case action_pause:
+        case action_resume:
+        case action_reset:
+        case action_tune:
+        case action_stop:
+            break;
+        default:
+            return( -1 );
+    }
+    if( !strcmp( muttley_opt.socket, "none" ) ||
+        ( ( ctl_fd = ctl_connect( muttley_opt.socket ) ) == EOF ) )
+        return( -1 );
+
+    if( ctl_call( ctl_fd, ctl_op_status, NULL, 0, NULL, 0, &r, &e ) ||
+        ( r < 0 ) ) {
+        close( ctl_fd );
+        ctl_fd = EOF;
+        return( -1 );
+    }
+
+    muttley_query_syscall = muttley_ctl_query;
+    muttley_snapshot_syscall = muttley_ctl_snapshot;
+    muttley_command_syscall = muttley_ctl_command;
+    return( r );
+}
+
+
+// the system calls, made by the server, they fail with the server's errno
+int muttley_ctl_query( enum muttley_query query ) {
+
+    int q = query, r, e;
+
+    if( ctl_call( ctl_fd, ctl_op_query, &q, sizeof( q ), NULL, 0, &r, &e ) )
+        return( -1 );
+    errno = e;
+    return( r );
+}
+
+int muttley_ctl_snapshot( struct muttley_stats * stats, int size ) {
+
+    int r, e;
+
+    if( ctl_call( ctl_fd, ctl_op_snapshot, &size, sizeof( size ), stats,
+                  size, &r, &e ) )
+        return( -1 );
+    errno = e;
+    return( r );
+}
+
+int muttley_ctl_command( struct muttley_command * cmds, int count ) {
+
+    int r, e;
+    uint32_t len = count * sizeof( cmds[ 0 ] );
+
+    if( ctl_call( ctl_fd, ctl_op_command, cmds, len, cmds, len, &r, &e ) )
+        return( -1 );
+    errno = e;
+    return( r );
+}
+
+
+// start or stop through the server, as kex_init and kex_term do, returns 1
+// on success
+int muttley_ctl_call( int op, void * data, int length ) {
+
+    int r, e;
+
+    if( ctl_call( ctl_fd, op, data, length, NULL, 0, &r, &e ) ) {
+        fprintf( stderr, "%s: %s\n", muttley_opt.socket, strerror( errno ) );
+        return( 0 );
+    }
+    if( r != 1 )
+        fprintf( stderr, "muttley server: %s\n", strerror( e ) );
+    return( r == 1 );
+}
+
+
+// the server's kmid, checked again at most every second (or when 'now' is
+// set) to notice the kernel extension being loaded or unloaded, and with its
+// system calls resolved whenever it changes
+mid_t muttley_serve_kmid( int now ) {
+
+    static mid_t kmid = 0;
+    static time_t last = 0;
+    mid_t k;
+
+    if( !now && ( time( NULL ) == last ) )
+        return( kmid );
+    last = time( NULL );
+
+    if( ( k = kex_status( (char *)muttley_kex ) ) < 0 )
+        k = 0;
+    if( ( k != kmid ) && k && muttley_syscalls() )
+        k = 0;
+    kmid = k;
+
+    return( kmid );
+}
+
+
+// carry out a command request on a thread of its own, as a probe may take
+// as long as the kernel proc's checks of a stuck target, and hand its client
+// back to the poll loop once the reply is sent
+void * muttley_serve_command( void * arg ) {
+
+    int r, e = 0, fd;
+    struct serve_command * sc = (struct serve_command *)arg;
+
+    if( ( r = muttley_command_syscall( sc->cmd, sc->len /
+                                       sizeof( sc->cmd[ 0 ] ) ) ) < 0 )
+        e = errno;
+    fd = ctl_send( sc->fd, ctl_op_command, r, e, ( r < 0 ) ? NULL : sc->cmd,
+                   ( r < 0 ) ? 0 : sc->len ) ? ~sc->fd : sc->fd;
+    write( serve_pipe[ 1 ], &fd, sizeof( fd ) );
+    free( sc );
+    return( NULL );
+}
+
+
+// handle a client's request, payloads are received into buf (which fits the
+// largest one, i.e. a muttley_conf with every target, MTL_CONF_MAX), returns
+// 0 unless the client is gone, or 1 if it was handed to a command thread,
+// which then replies
+int muttley_serve_one( int fd, char * buf ) {
+
+    int r = -1, e = 0, size;
+    uint32_t len = 0;
+    void * rsp = NULL;
+    mid_t kmid;
+    struct ctl_hdr hdr;
+    struct muttley_conf * c;
+    struct serve_command * sc;
+    pthread_t thread;
+    pthread_attr_t attr;
+
+    if( ctl_recv( fd, &hdr, buf, MTL_CONF_MAX ) )
+        return( -1 );
+
+    kmid = muttley_serve_kmid( ( hdr.op == ctl_op_start ) ||
+                               ( hdr.op == ctl_op_stop ) );
+
+    if( ( hdr.op != ctl_op_status ) && !kmid )
+        e = ENXIO;
+    else switch( hdr.op ) {
+        case ctl_op_status:
+            r = kmid;
+            break;
+        case ctl_op_query:
+            if( hdr.len != sizeof( int ) )
+                e = EINVAL;
+            else if( ( r = muttley_query_syscall( *(int *)buf ) ) < 0 )
+                e = errno;
+            break;
+        case ctl_op_snapshot:
+            if( hdr.len != sizeof( int ) )
+                e = EINVAL;
+            else if( ( r = muttley_snapshot_syscall( &stats,
+                                                     sizeof( stats ) ) ) < 0 )
+                e = errno;
+            else {
+                // only what the client can take, up to the last target
+                size = *(int *)buf;
+                len = (char *)&stats.target[ stats.targets ] - (char *)&stats;
+                if( ( size >= 0 ) && ( len > (uint32_t)size ) )
+                    len = size;
+                rsp = &stats;
+            }
+            break;
+        case ctl_op_command:
+            if( !hdr.len || ( hdr.len % sizeof( struct muttley_command ) ) )
+                e = EINVAL;
+            else if( !( sc = malloc( sizeof( *sc ) + hdr.len ) ) )
+                e = errno;
+            else {
+                sc->fd = fd;
+                sc->len = hdr.len;
+                sc->cmd = (struct muttley_command *)( sc + 1 );
+                memcpy( sc->cmd, buf, hdr.len );
+                pthread_attr_init( &attr );
+                pthread_attr_setdetachstate( &attr, PTHREAD_CREATE_DETACHED );
+                e = pthread_create( &thread, &attr, muttley_serve_command, sc );
+                pthread_attr_destroy( &attr );
+                if( !e )
+                    return( 1 );
+                free( sc );
+            }
+            break;
+        case ctl_op_start:
+            // a configuration is followed by as many targets, and paths, as
+            // it says it has
+            c = (struct muttley_conf *)buf;
+            if( ( hdr.len < sizeof( *c ) ) || ( c->targets < 1 ) ||
+                ( c->targets > MTL_TARGETS_MAX ) || ( c->paths_sz < 1 ) ||
+                ( c->paths_sz > MTL_PATHS_SZ ) ||
+                ( hdr.len != MTL_CONF_LEN( c ) ) )
+                e = EINVAL;
+            else if( !( r = kex_init( kmid, buf, hdr.len ) ) )
+                e = errno;
+            break;
+        case ctl_op_stop:
+            if( !( r = kex_term( kmid, NULL, 0 ) ) )
+                e = errno;
+            break;
+        default:
+            e = EINVAL;
+            break;
+    }
+
+    return( ctl_send( fd, hdr.op, r, e, rsp, len ) );
+}
+
+
+// serve the control socket, keeping the kernel extension's system calls at
+// hand so clients skip looking it up, until interrupted, commands are
+// carried out on threads of their own, their clients aren't polled until
+// they're done, so that no other client waits for them
+int muttley_serve( void ) {
+
+    int fd, c, n = 2;
+    uint64_t requests = 0;
+    char * buf;
+    struct pollfd pfd[ CTL_CLIENTS_MAX + 2 ];
+
+    // there may be only one server
+    if( ( fd = ctl_connect( muttley_opt.socket ) ) != EOF ) {
+        close( fd );
+        fprintf( stderr, "%s: a server is already there\n",
+                 muttley_opt.socket );
+        return( exit_not_rdy );
+    }
+    if( !( buf = malloc( MTL_CONF_MAX ) ) ) {
+        fprintf( stderr, "malloc: %s\n", strerror( errno ) );
+        return( exit_err_sys );
+    }
+    if( pipe( serve_pipe ) ) {
+        fprintf( stderr, "pipe: %s\n", strerror( errno ) );
+        free( buf );
+        return( exit_err_sys );
+    }
+    if( ( pfd[ 0 ].fd = ctl_listen( muttley_opt.socket ) ) == EOF ) {
+        fprintf( stderr, "%s: %s\n", muttley_opt.socket, strerror( errno ) );
+        close( serve_pipe[ 0 ] );
+        close( serve_pipe[ 1 ] );
+        free( buf );
+        return( exit_err_sys );
+    }
+    pfd[ 0 ].events = POLLIN;
+    pfd[ 1 ].fd = serve_pipe[ 0 ];
+    pfd[ 1 ].events = POLLIN;
+
+    signal( SIGINT, muttley_interrupt );
+    signal( SIGTERM, muttley_interrupt );
+    signal( SIGPIPE, SIG_IGN );
+    muttley_serve_kmid( true );
+    fprintf( stdout, "muttley serving on '%s'\n", muttley_opt.socket );
+    fflush( stdout );
+
+    while( !interrupted ) {
+
+        if( poll( pfd, n, 1000 ) < 0 ) {
+            if( errno == EINTR )
+                continue;
+            fprintf( stderr, "poll: %s\n", strerror( errno ) );
+            break;
+        }
+
+        // requests of connected clients first, a client handed to a command
+        // thread is left out of the poll (a negative descriptor) until it's
+        // done with it
+        for( c = 2; c < n; c++ ) {
+            if( !pfd[ c ].revents )
+                continue;
+            if( ( pfd[ c ].revents & ( POLLERR | POLLHUP | POLLNVAL ) ) &&
+                !( pfd[ c ].revents & POLLIN ) )
+                fd = -1;
+            else
+                fd = muttley_serve_one( pfd[ c ].fd, buf );
+            if( fd > 0 ) {
+                pfd[ c ].fd = ~pfd[ c ].fd;
+                requests++;
+            } else if( fd ) {
+                close( pfd[ c ].fd );
+                pfd[ c-- ] = pfd[ --n ];
+            } else
+                requests++;
+        }
+        // then clients the command threads are done with, polled again (or
+        // closed, if they're gone)
+        if( ( pfd[ 1 ].revents & POLLIN ) &&
+            ( read( pfd[ 1 ].fd, &fd, sizeof( fd ) ) == sizeof( fd ) ) ) {
+            for( c = 2; c < n; c++ ) {
+                if( pfd[ c ].fd != ( ( fd < 0 ) ? fd : ~fd ) )
+                    continue;
+                if( fd < 0 ) {
+                    close( ~fd );
+                    pfd[ c ] = pfd[ --n ];
+                } else {
+                    pfd[ c ].fd = fd;
+                    pfd[ c ].revents = 0;
+                }
+                break;
+            }
+        }
+        // and new clients
+        if( pfd[ 0 ].revents & POLLIN ) {
+            if( ( fd = accept( pfd[ 0 ].fd, NULL, NULL ) ) == EOF )
+                continue;
+            if( n > CTL_CLIENTS_MAX + 1 ) {
+                close( fd );
+                continue;
+            }
+            pfd[ n ].fd = fd;
+            pfd[ n ].events = POLLIN;
+            pfd[ n++ ].revents = 0;
+        }
+    }
+
+    // clients still with a command thread are left to it, and so is the
+    // pipe's write end, which it writes to once it's done (with the read end
+    // closed, and SIGPIPE ignored, that write just fails) until we exit, as
+    // waiting for it would wait on a probe of a stuck target
+    for( c = 0; c < n; c++ )
+        if( pfd[ c ].fd >= 0 )
+            close( pfd[ c ].fd );
+    unlink( muttley_opt.socket );
+    free( buf );
+    fprintf( stdout, "\n%lu requests served\n", (unsigned long)requests );
+    return( exit_ok );
+}
+
+
+// bench paths
+enum bench_paths {
+    bench_direct = 0,           // what every invocation does without a server
+    bench_connect,              // what it does with one
+    bench_round_trip,           // a request on an open connection
+    bench_cli_direct,           // a whole 'muttley status', without a server
+    bench_cli_server,           // and with one
+    bench_sz
+};
 
-    if( kmid ) {
+// and in english
+const char * bench_str[ bench_sz ] = {
+    "kex_status, dlopen and query",
+    "connect, status and query",
+    "round trip (query)",
+    "'muttley status', direct",
+    "'muttley status', server"
+};
 
-        // if muttley is running, don't unload
-        if( muttley_query_syscall &&
-            muttley_query_syscall( mtl_query_running ) ) {
-            fprintf( stderr, "muttley is running, stop it prior to trying "
-                     "unload or bad things will happen\n" );
+
+// a whole 'muttley status', through 'socket', returns 0 on success
+int muttley_bench_cli( char * socket ) {
+
+    int fd, status;
+    pid_t pid;
+
+    if( !( pid = fork() ) ) {
+        if( ( fd = open( "/dev/null", O_WRONLY ) ) != EOF ) {
+            dup2( fd, 1 );
+            dup2( fd, 2 );
+        }
+        execl( muttley_argv0, muttley_argv0, "-S", socket, "status",
+               (char *)NULL );
+        _exit( 127 );
+    }
+    if( ( pid == EOF ) || ( waitpid( pid, &status, 0 ) == EOF ) )
+        return( 1 );
+
+    return( !WIFEXITED( status ) || WEXITSTATUS( status ) );
+}
+
+
+// time status round trips with and without the server, i.e. what scripts
+// calling us over and over pay each time
+int muttley_bench( void ) {
+
+    int b, i, r, e, fd, rounds, q = mtl_query_running;
+    mid_t kmid;
+    uint64_t start, ns, sum[ bench_sz ], max[ bench_sz ];
+    struct sketch lat[ bench_sz ];
+    struct timeval tv;
+
+    rounds = ( muttley_opt.times > 1 ) ? muttley_opt.times : 100;
+
+    // one connection is kept open for the round trips
+    if( !strcmp( muttley_opt.socket, "none" ) ||
+        ( ( ctl_fd = ctl_connect( muttley_opt.socket ) ) == EOF ) )
+        fprintf( stdout, "no server on '%s', only timing the direct paths\n\n",
+                 muttley_opt.socket );
+
+    for( b = 0; b < bench_sz; b++ ) {
+
+        sketch_clear( &lat[ b ] );
+        sum[ b ] = 0;
+        max[ b ] = 0;
+        if( ( ctl_fd == EOF ) && ( b != bench_direct ) &&
+            ( b != bench_cli_direct ) )
+            continue;
+
+        for( i = 0; i < rounds; i++ ) {
+
+            gettimeofday( &tv, NULL );
+            start = (uint64_t)tv.tv_sec * 1000000000 + tv.tv_usec * 1000;
+
+            switch( b ) {
+                case bench_direct:
+                    if( ( ( kmid = kex_status( (char *)muttley_kex ) ) > 0 ) &&
+                        !muttley_syscalls() )
+                        muttley_query_syscall( mtl_query_running );
+                    break;
+                case bench_connect:
+                    if( ( fd = ctl_connect( muttley_opt.socket ) ) != EOF ) {
+                        if( !ctl_call( fd, ctl_op_status, NULL, 0, NULL, 0, &r,
+                                       &e ) && ( r > 0 ) )
+                            ctl_call( fd, ctl_op_query, &q, sizeof( q ), NULL,
+                                      0, &r, &e );
+                        close( fd );
+                    }
+                    break;
+                case bench_round_trip:
+                    ctl_call( ctl_fd, ctl_op_query, &q, sizeof( q ), NULL, 0,
+                              &r, &e );
+                    break;
+                case bench_cli_direct:
+                    muttley_bench_cli( "none" );
+                    break;
+                case bench_cli_server:
+                    muttley_bench_cli( muttley_opt.socket );
+                    break;
+            }
+
+            gettimeofday( &tv, NULL );
+            ns = (uint64_t)tv.tv_sec * 1000000000 + tv.tv_usec * 1000 - start;
+            sketch_add( &lat[ b ], ns );
+            sum[ b ] += ns;
+            if( ns > max[ b ] )
+                max[ b ] = ns;
+        }
+    }
+
+    fprintf( stdout, "path                         :  rounds :   avg (us) :   "
+             "p50 (us) :   p99 (us) :   max (us)\n" );
+    for( b = 0; b < bench_sz; b++ ) {
+        if( !lat[ b ].count )
+            continue;
+        fprintf( stdout, "%-28s : %7d : %10lu : %10lu : %10lu : %10lu\n",
+                 bench_str[ b ], rounds,
+                 (unsigned long)( sum[ b ] / rounds / 1000 ),
+                 (unsigned long)( sketch_quantile( &lat[ b ], 500 ) / 1000 ),
+                 (unsigned long)( sketch_quantile( &lat[ b ], 990 ) / 1000 ),
+                 (unsigned long)( max[ b ] / 1000 ) );
+    }
+
+    if( ctl_fd != EOF )
+        close( ctl_fd );
+    return( exit_ok );
+}
+
+
+// current time in ns
+uint64_t muttley_now( void ) {
+
+    struct timeval tv;
+
+    gettimeofday( &tv, NULL );
+    return( (uint64_t)tv.tv_sec * 1000000000 + tv.tv_usec * 1000 );
+}
+
+
+// one of scale's workers, bound to a processor like the kernel extension's,
+// checks the targets of its queue and then of the others' as runs are
+// published, with a read, whatever kind of target it is
+void * muttley_scale_worker( void * arg ) {
+
+    int w = (int)(long)arg, t, fd, gen = 0, stolen, ncpus;
+    uint64_t start, late;
+    char buf[ 512 ];
+
+    ncpus = sysconf( _SC_NPROCESSORS_ONLN );
+    scale.worker[ w ].cpu = -1;
+    if( ( ncpus > 0 ) &&
+        !bindprocessor( BINDTHREAD, thread_self(), w % ncpus ) )
+        scale.worker[ w ].cpu = w % ncpus;
+
+    pthread_mutex_lock( &scale.lock );
+    for( ;; ) {
+
+        while( !scale.stop && ( gen == scale.gen ) )
+            pthread_cond_wait( &scale.run, &scale.lock );
+        if( scale.stop )
+            break;
+        gen = scale.gen;
+        pthread_mutex_unlock( &scale.lock );
+
+        while( ( t = shard_next( scale.queue, scale.workers, w,
+                                 &stolen ) ) >= 0 ) {
+
+            start = muttley_now();
+            late = start - scale.run_time;
+            sketch_add( &scale.worker[ w ].lateness, late );
+            if( late > scale.worker[ w ].lateness_max )
+                scale.worker[ w ].lateness_max = late;
+            if( ( ( fd = open( muttley_opt.device[ t ], O_RDONLY ) ) == EOF ) ||
+                ( read( fd, buf, sizeof( buf ) ) != sizeof( buf ) ) )
+                scale.worker[ w ].failures++;
+            if( fd != EOF )
+                close( fd );
+            scale.worker[ w ].checked++;
+            scale.worker[ w ].stolen += stolen;
+
+            // the last one done lets the run go
+            if( fetch_and_add( (atomic_p)&scale.pending, -1 ) == 1 ) {
+                pthread_mutex_lock( &scale.lock );
+                pthread_cond_signal( &scale.done );
+                pthread_mutex_unlock( &scale.lock );
+            }
+        }
+
+        pthread_mutex_lock( &scale.lock );
+    }
+    pthread_mutex_unlock( &scale.lock );
+
+    return( NULL );
+}
+
+
+// check the devices, sharded across 1, 4 and 16 workers in turn, 'times'
+// runs each, every 'refresh' ms, and show how many probes per second they
+// get through (while a run is in progress) and how late the checks start
+int muttley_scale( void ) {
+
+    int i, r, t, w, step, runs, n[ SHARD_WORKERS_MAX ];
+    uint64_t start, busy, checked, stolen, failures, late_max;
+    struct sketch late;
+    pthread_t thread[ SHARD_WORKERS_MAX ];
+
+    runs = ( muttley_opt.times > 1 ) ? muttley_opt.times : 20;
+
+    fprintf( stdout, "%d targets, %d runs every %d ms at each step\n\n",
+             muttley_opt.devices, runs, muttley_opt.refresh );
+    fprintf( stdout, "workers :   probes : failures : probes/s :   stolen : "
+             "p50 late (us) : p99 late (us) : max late (us)\n" );
+
+    for( step = 0; step < SCALE_STEPS; step++ ) {
+
+        bzero( (char *)&scale, sizeof( scale ) );
+        scale.workers = scale_workers[ step ];
+        pthread_mutex_init( &scale.lock, NULL );
+        pthread_cond_init( &scale.run, NULL );
+        pthread_cond_init( &scale.done, NULL );
+
+        for( w = 0; w < scale.workers; w++ ) {
+            if( ( r = pthread_create( &thread[ w ], NULL,
+                                      muttley_scale_worker,
+                                      (void *)(long)w ) ) ) {
+                fprintf( stderr, "pthread_create: %s\n", strerror( r ) );
+                scale.workers = w;
+                break;
+            }
+        }
+
+        busy = 0;
+        for( i = 0; ( i < runs ) && scale.workers; i++ ) {
+
+            start = muttley_now();
+
+            // shard the run's targets, as the kernel proc does
+            for( w = 0; w < scale.workers; w++ ) {
+                shard_withdraw( &scale.queue[ w ] );
+                n[ w ] = 0;
+            }
+            for( t = 0; t < muttley_opt.devices; t++ ) {
+                w = shard_owner( t, scale.workers );
+                scale.queue[ w ].item[ n[ w ]++ ] = t;
+            }
+
+            pthread_mutex_lock( &scale.lock );
+            scale.pending = muttley_opt.devices;
+            scale.run_time = muttley_now();
+            for( w = 0; w < scale.workers; w++ )
+                shard_publish( &scale.queue[ w ], n[ w ] );
+            scale.gen++;
+            pthread_cond_broadcast( &scale.run );
+            while( scale.pending )
+                pthread_cond_wait( &scale.done, &scale.lock );
+            pthread_mutex_unlock( &scale.lock );
+
+            busy += muttley_now() - scale.run_time;
+
+            // and wait for the next one
+            if( start + muttley_opt.refresh * 1000000ULL > muttley_now() )
+                usleep( ( start + muttley_opt.refresh * 1000000ULL -
+                          muttley_now() ) / 1000 );
+        }
+
+        pthread_mutex_lock( &scale.lock );
+        scale.stop = true;
+        pthread_cond_broadcast( &scale.run );
+        pthread_mutex_unlock( &scale.lock );
+        for( w = 0; w < scale.workers; w++ )
+            pthread_join( thread[ w ], NULL );
+
+        checked = 0;
+        stolen = 0;
+        failures = 0;
+        late_max = 0;
+        sketch_clear( &late );
+        for( w = 0; w < scale.workers; w++ ) {
+            checked += scale.worker[ w ].checked;
+            stolen += scale.worker[ w ].stolen;
+            failures += scale.worker[ w ].failures;
+            sketch_merge( &late, &scale.worker[ w ].lateness );
+            if( scale.worker[ w ].lateness_max > late_max )
+                late_max = scale.worker[ w ].lateness_max;
+        }
+
+        fprintf( stdout, "%7d : %8lu : %8lu : %8lu : %8lu : %13lu : %13lu : "
+                 "%13lu\n", scale_workers[ step ], (unsigned long)checked,
+                 (unsigned long)failures,
+                 (unsigned long)( busy ? checked * 1000000000 / busy : 0 ),
+                 (unsigned long)stolen,
+                 (unsigned long)( sketch_quantile( &late, 500 ) / 1000 ),
+                 (unsigned long)( sketch_quantile( &late, 990 ) / 1000 ),
+                 (unsigned long)( late_max / 1000 ) );
+        fflush( stdout );
+
+        pthread_mutex_destroy( &scale.lock );
+        pthread_cond_destroy( &scale.run );
+        pthread_cond_destroy( &scale.done );
+    }
+
+    return( exit_ok );
+}
+
+
+// check a target from user space, the way the kernel extension does, for
+// calibrate, 'buf' is a MTL_SCRATCH_SZ aligned buffer (suits direct i/o),
+// returns the errno of the failed step (or 0)
+int muttley_calibrate_probe( int t, char * buf ) {
+
+    int fd, r = 0;
+    uint64_t seq;
+    char path[ PATH_MAX + sizeof( CALIB_CANARY ) + 1 ];
+    struct statfs sfs;
+    struct muttley_scratch * blk = (struct muttley_scratch *)buf;
+
+    switch( muttley_opt.type[ t ] ) {
+
+        case mtl_target_canary:
+            if( statfs( muttley_opt.device[ t ], &sfs ) == EOF )
+                return( errno );
+            snprintf( path, sizeof( path ), "%s/" CALIB_CANARY,
+                      muttley_opt.device[ t ] );
+            if( ( fd = open( path, O_WRONLY | O_CREAT | O_TRUNC, 0600 ) ) == EOF )
+                return( errno );
+            bzero( buf, 512 );
+            if( write( fd, buf, 512 ) != 512 )
+                r = errno ? errno : EIO;
+            if( !r && ( fsync( fd ) == EOF ) )
+                r = errno;
+            close( fd );
+            if( ( unlink( path ) == EOF ) && !r )
+                r = errno;
+            return( r );
+
+        case mtl_target_write:
+            if( ( fd = open( muttley_opt.device[ t ], O_RDWR | O_DSYNC |
+                             ( calib.target[ t ].direct ? O_DIRECT : 0 ) ) ) ==
+                EOF )
+                return( errno );
+            seq = muttley_now();
+            bzero( buf, MTL_SCRATCH_SZ );
+            blk->magic = MTL_SCRATCH_MAGIC;
+            blk->target = t;
+            blk->seq = seq;
+            blk->time = seq;
+            if( pwrite( fd, buf, MTL_SCRATCH_SZ, muttley_opt.offset[ t ] ) !=
+                MTL_SCRATCH_SZ )
+                r = errno ? errno : EIO;
+            if( !r ) {
+                bzero( buf, MTL_SCRATCH_SZ );
+                if( ( pread( fd, buf, MTL_SCRATCH_SZ, muttley_opt.offset[ t ] ) !=
+                      MTL_SCRATCH_SZ ) || ( blk->magic != MTL_SCRATCH_MAGIC ) ||
+                    ( blk->seq != seq ) )
+                    r = errno ? errno : EIO;
+            }
+            close( fd );
+            return( r );
+
+        default:
+            if( ( fd = open( muttley_opt.device[ t ], O_RDONLY |
+                             ( calib.target[ t ].direct ? O_DIRECT : 0 ) ) ) ==
+                EOF )
+                return( errno );
+            if( read( fd, buf, MTL_READ_SZ ) != MTL_READ_SZ )
+                r = errno ? errno : EIO;
+            close( fd );
+            return( r );
+    }
+}
+
+
+// query a read target's held descriptor, the way the kernel extension's
+// query tier does, i.e. ask the driver for the device's characteristics, or
+// stat a file, returns the errno of the query (or 0)
+int muttley_calibrate_query( int t ) {
+
+    struct devinfo di;
+    struct stat st;
+
+    if( calib.target[ t ].direct )
+        return( ( fstat( calib.target[ t ].fd, &st ) == EOF ) ? errno : 0 );
+    return( ( ioctl( calib.target[ t ].fd, IOCINFO, &di ) == EOF ) ?
+            errno : 0 );
+}
+
+
+// one of calibrate's workers, probes the targets sharded to it every
+// 'refresh' ms until the calibration is over (or it's interrupted)
+void * muttley_calibrate_worker( void * arg ) {
+
+    int w = (int)(long)arg, t, e;
+    uint64_t start, round, ns;
+    void * buf;
+
+    if( posix_memalign( &buf, MTL_SCRATCH_SZ, MTL_SCRATCH_SZ ) )
+        return( NULL );
+
+    while( !interrupted && ( ( round = muttley_now() ) < calib.end ) ) {
+
+        for( t = 0; t < muttley_opt.devices; t++ ) {
+
+            if( ( muttley_opt.type[ t ] == mtl_target_logical ) ||
+                ( shard_owner( t, calib.workers ) != w ) )
+                continue;
+
+            errno = 0;
+            start = muttley_now();
+            e = muttley_calibrate_probe( t, buf );
+            ns = muttley_now() - start;
+
+            sketch_add( &calib.target[ t ].latency, ns );
+            if( ns > calib.target[ t ].max )
+                calib.target[ t ].max = ns;
+            calib.target[ t ].probes++;
+            if( e ) {
+                calib.target[ t ].failures++;
+                calib.target[ t ].error = e;
+            }
+
+            // and query it, a query which fails would be followed by a
+            // full check, which the probes account for already
+            if( calib.target[ t ].fd == EOF )
+                continue;
+            start = muttley_now();
+            e = muttley_calibrate_query( t );
+            ns = muttley_now() - start;
+            if( !e ) {
+                sketch_add( &calib.target[ t ].query, ns );
+                if( ns > calib.target[ t ].query_max )
+                    calib.target[ t ].query_max = ns;
+                calib.target[ t ].queries++;
+            }
+        }
+
+        // and wait for the next round
+        if( round + muttley_opt.refresh * 1000000ULL > muttley_now() )
+            usleep( ( round + muttley_opt.refresh * 1000000ULL -
+                      muttley_now() ) / 1000 );
+    }
+
+    free( buf );
+    return( NULL );
+}
+
+
+// step deadline in ms given the latencies of a calibrated target's probes
+// (or queries) and the longest, well above the slowest seen, since a
+// calibration rarely sees the worst, rounded up to 10 ms
+int muttley_calibrate_deadline( struct sketch * latency, uint64_t max ) {
+
+    uint64_t us;
+
+    us = sketch_quantile( latency, 999 ) / 1000 * 4;
+    if( max / 1000 * 2 > us )
+        us = max / 1000 * 2;
+    us = ( us + 9999 ) / 10000 * 10;
+    return( ( us < BSL_DEADLINE_MIN ) ? BSL_DEADLINE_MIN : (int)us );
+}
+
+
+// probe the devices in user space for a while, sharded across workers the
+// way the kernel extension does, and recommend the configuration which meets
+// the detection time and false alarm goals, given the worst target's chance
+// of failing a check and the longest deadline, writing the baseline out
+int muttley_calibrate( void ) {
+
+    int n = 0, r, t, w, period;
+    double p, p_max = 0.0;
+    struct stat st;
+    struct bsl_config cfg;
+    struct bsl_header bh;
+    static struct bsl_target bt[ MTL_TARGETS_MAX ];
+    pthread_t thread[ MTL_WORKERS_MAX ];
+
+    period = ( muttley_opt.times > 1 ) ? muttley_opt.times : CALIB_PERIOD;
+    if( muttley_opt.topology && ( r = muttley_topo_targets() ) )
+        return( r );
+
+    bzero( (char *)&calib, sizeof( calib ) );
+    for( t = 0; t < muttley_opt.devices; t++ ) {
+        if( stat( muttley_opt.device[ t ], &st ) == EOF ) {
+            fprintf( stderr, "stat(%s): %s\n", muttley_opt.device[ t ],
+                     strerror( errno ) );
             return( exit_not_rdy );
         }
+        calib.target[ t ].direct = S_ISREG( st.st_mode );
+        // read targets are held open to be queried, as they're held by the
+        // kernel extension, those which don't open are only probed
+        calib.target[ t ].fd = ( muttley_opt.type[ t ] == mtl_target_read ) ?
+            open( muttley_opt.device[ t ], O_RDONLY ) : EOF;
+    }
 
-        if( !kex_unload( kmid ) ) {
-            fprintf( stderr, "muttley unload failed\n" );
+    fprintf( stdout, "calibrating %d targets for %d s, probing each every %d "
+             "ms with %d workers\n\n", muttley_opt.devices, period,
+             muttley_opt.refresh, muttley_opt.workers );
+    fflush( stdout );
+
+    signal( SIGINT, muttley_interrupt );
+    bh.time = time( NULL );
+    calib.end = muttley_now() + period * 1000000000ULL;
+    calib.workers = muttley_opt.workers;
+    for( w = 0; w < calib.workers; w++ ) {
+        if( ( r = pthread_create( &thread[ w ], NULL, muttley_calibrate_worker,
+                                  (void *)(long)w ) ) ) {
+            fprintf( stderr, "pthread_create: %s\n", strerror( r ) );
+            calib.end = 0;
+            break;
+        }
+    }
+    while( w-- )
+        pthread_join( thread[ w ], NULL );
+    for( t = 0; t < muttley_opt.devices; t++ )
+        if( calib.target[ t ].fd != EOF )
+            close( calib.target[ t ].fd );
+    if( !calib.end )
+        return( exit_err_sys );
+
+    fprintf( stdout, "  # : kind    :   probes : failures :   p50 (us) :   "
+             "p99 (us) : p99.9 (us) :   max (us) : deadline (ms) : "
+             "query (ms) : device\n" );
+    for( t = 0; t < muttley_opt.devices; t++ ) {
+
+        if( muttley_opt.type[ t ] == mtl_target_logical )
+            continue;
+
+        bzero( (char *)&bt[ n ], sizeof( bt[ n ] ) );
+        bt[ n ].id = bsl_id( muttley_opt.device[ t ], muttley_opt.type[ t ] );
+        bt[ n ].type = muttley_opt.type[ t ];
+        bt[ n ].probes = calib.target[ t ].probes;
+        bt[ n ].failures = calib.target[ t ].failures;
+        bt[ n ].p50 = sketch_quantile( &calib.target[ t ].latency, 500 ) / 1000;
+        bt[ n ].p99 = sketch_quantile( &calib.target[ t ].latency, 990 ) / 1000;
+        bt[ n ].p999 = sketch_quantile( &calib.target[ t ].latency, 999 ) / 1000;
+        bt[ n ].max = calib.target[ t ].max / 1000;
+        bt[ n ].deadline = muttley_calibrate_deadline(
+            &calib.target[ t ].latency, calib.target[ t ].max );
+        // queries only get a deadline of their own if any were made
+        bt[ n ].query = calib.target[ t ].queries ?
+            muttley_calibrate_deadline( &calib.target[ t ].query,
+                                        calib.target[ t ].query_max ) : 0;
+        // the sketch's bins are wider than what's in them
+        bt[ n ].p50 = ( bt[ n ].p50 > bt[ n ].max ) ? bt[ n ].max : bt[ n ].p50;
+        bt[ n ].p99 = ( bt[ n ].p99 > bt[ n ].max ) ? bt[ n ].max : bt[ n ].p99;
+        bt[ n ].p999 = ( bt[ n ].p999 > bt[ n ].max ) ? bt[ n ].max :
+            bt[ n ].p999;
+
+        fprintf( stdout, "%3d : %-7s : %8u : %8u : %10u : %10u : %10u : %10u : "
+                 "%13u : %10u : %s", t, target_type_str[ bt[ n ].type ],
+                 bt[ n ].probes, bt[ n ].failures, bt[ n ].p50, bt[ n ].p99,
+                 bt[ n ].p999, bt[ n ].max, bt[ n ].deadline, bt[ n ].query,
+                 muttley_opt.device[ t ] );
+        if( bt[ n ].failures )
+            fprintf( stdout, " (%s)", strerror( calib.target[ t ].error ) );
+        fprintf( stdout, "\n" );
+
+        // the chance of a check failing, or taking longer than the deadline
+        // (which none did), with a probe's worth of doubt either way, so
+        // that a short calibration isn't taken as proof of perfection
+        p = ( bt[ n ].failures + 1.0 ) / ( bt[ n ].probes + 2.0 );
+        if( p > p_max )
+            p_max = p;
+        if( !n || ( bt[ n ].deadline > (uint32_t)bh.deadline ) )
+            bh.deadline = bt[ n ].deadline;
+        n++;
+    }
+
+    if( !n ) {
+        fprintf( stderr, "calibrate: no targets to probe\n" );
+        return( exit_not_rdy );
+    }
+
+    fprintf( stdout, "\nworst target fails a check with p = %.2e, detection "
+             "goal %d s, false alarm goal %g a target a year\n",
+             p_max, muttley_opt.detect, muttley_opt.false_alarms );
+    r = bsl_recommend( p_max, bh.deadline, muttley_opt.detect * 1000,
+                       muttley_opt.false_alarms, &cfg );
+    if( !cfg.checks )
+        fprintf( stdout, "no configuration detects a lost target within the "
+                 "goal, the deadline alone takes %d ms\n", bh.deadline );
+    else {
+        fprintf( stdout, "%s: -c %d -s %d -r %d -i %d -l %d\n",
+                 r ? "goals can't both be met, closest" : "recommended",
+                 cfg.checks, cfg.successes, cfg.runs, cfg.interval,
+                 cfg.deadline );
+        fprintf( stdout, "  detects a lost target within %d ms, with %.2e false "
+                 "alarms a target a year expected\n", cfg.detection,
+                 cfg.false_alarms );
+    }
+    fprintf( stdout, "current: -c %d -s %d -r %d -i %d would detect within %d "
+             "ms, with %.2e false alarms a target a year expected\n",
+             muttley_opt.checks, muttley_opt.successes, muttley_opt.runs,
+             muttley_opt.run_int, bsl_detection( muttley_opt.runs,
+                 muttley_opt.run_int, bh.deadline ),
+             bsl_false_alarms( p_max, muttley_opt.checks,
+                 muttley_opt.successes, muttley_opt.runs,
+                 muttley_opt.run_int ) );
+
+    if( muttley_opt.baseline ) {
+        bh.period = period;
+        bh.targets = n;
+        bh.checks = cfg.checks;
+        bh.successes = cfg.successes;
+        bh.runs = cfg.runs;
+        bh.interval = cfg.interval;
+        bh.pad = 0;
+        if( bsl_write( muttley_opt.baseline, &bh, bt ) ) {
+            fprintf( stderr, "baseline(%s): %s\n", muttley_opt.baseline,
+                     strerror( errno ) );
             return( exit_err_sys );
-        } else
-            fprintf( stdout, "muttley was successfully unloaded\n" );
+        }
+        fprintf( stdout, "baseline of %d targets written to '%s'\n", n,
+                 muttley_opt.baseline );
+    }
 
-    } else
-        fprintf( stdout, "muttley is not loaded, skipping unload\n" );
+    return( exit_ok );
+}
+
+
+// load and validate the targets the way start does, without starting, and
+// show how long it took, and the memory the configuration and the kernel
+// extension take per target
+int muttley_validate( void ) {
+
+    int r;
+    unsigned long kmem;
+
+    if( ( r = muttley_conf_targets() ) )
+        return( r );
+
+    fprintf( stdout, "%d targets, all valid\n", conf.targets );
+    if( loader.file )
+        fprintf( stdout, "  loading:       %10lu us, %lu ns a target (%d "
+                 "targets from '%s')\n",
+                 (unsigned long)( loader.load_time / 1000 ),
+                 (unsigned long)( loader.loaded ?
+                                  loader.load_time / loader.loaded : 0 ),
+                 loader.loaded, loader.file );
+    fprintf( stdout, "  validating:    %10lu us, %lu ns a target (%d "
+             "threads)\n", (unsigned long)( loader.validate_time / 1000 ),
+             (unsigned long)( loader.validate_time / conf.targets ),
+             loader.threads );
+    fprintf( stdout, "  configuration: %10lu bytes, %lu a target\n",
+             (unsigned long)MTL_CONF_LEN( &conf ),
+             (unsigned long)( MTL_CONF_LEN( &conf ) / conf.targets ) );
+    fprintf( stdout, "  paths:         %10d bytes, %d a target (%d distinct "
+             "paths)\n", conf.paths_sz, conf.paths_sz / conf.targets,
+             paths.strings );
+    // the kernel extension's, allocated when monitoring starts, of which
+    // the statistics and the rollup windows take the most
+    kmem = conf.targets * MTL_TARGET_KMEM + conf.paths_sz;
+    fprintf( stdout, "  kernel memory: %10lu bytes, %lu a target (statistics "
+             "%lu, rollups %lu)\n", kmem, kmem / conf.targets,
+             (unsigned long)sizeof( struct muttley_target_stats ),
+             (unsigned long)sizeof( struct muttley_rollups ) );
 
     return( exit_ok );
 }
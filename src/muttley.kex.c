@@ -33,6 +33,22 @@
 #include <sys/fp_io.h>
 #include <sys/proc.h>
 #include <sys/timer.h>
+#include <sys/malloc.h>
+#include <sys/vfs.h>
+#include <sys/vnode.h>
+#include <sys/file.h>
+#include <sys/statfs.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+#include <sys/devinfo.h>
+#include <sys/cred.h>
+#include <sys/lock_def.h>
+#include <sys/lock_alloc.h>
+#include <sys/sleep.h>
+#include <sys/atomic_op.h>
+#include <sys/processor.h>
+#include <sys/systemcfg.h>
+#include <sys/syslog.h>
 
 #include "muttley.kex.h"
 
@@ -44,9 +60,50 @@
 // maximum size of the kernel proc's name (appears in 'ps aux')
 #define _MTL_KPROC_NAME_SZ 64
 // read buffer size (i.e. number of bytes read when monitoring a device)
-#define _MTL_READ_BUF_SZ   512
+#define _MTL_READ_BUF_SZ   MTL_READ_SZ
+// name of the canary file created in canary targets' directories
+#define _MTL_CANARY_NAME   ".muttley.canary"
 // time to wait for the kernel proc to terminate
 #define _MTL_KPROC_TIMEOUT 20
+// length of each rollup window in seconds
+#define _MTL_WINDOW_MINUTE 60
+#define _MTL_WINDOW_HOUR   3600
+#define _MTL_WINDOW_DAY    86400
+// times muttley_snapshot tries to get a consistent copy of a part of the
+// statistics right away, and then once a tick
+#define _MTL_SNAP_SPINS    16
+#define _MTL_SNAP_RETRIES  100
+// interval between wakeups of the kernel proc in ms, when nothing wakes it
+#define _MTL_TICK_MS       250
+// number of commands which may be queued at once, by all callers
+#define _MTL_CMDQ_SZ       ( 2 * MTL_COMMAND_BATCH )
+// name of the heartbeat kernel proc (appears in 'ps aux')
+#define _MTL_HB_KPROC_NAME "muttley:heartbeat"
+// sequence number of a trace ring slot which is being rewritten
+#define _MTL_TRACE_INVALID ( ~(uint64_t)0 )
+// name of the worker kernel procs (appears in 'ps aux')
+#define _MTL_WORKER_KPROC_NAME "muttley:worker:%d"
+// context the command kernel proc checks targets in, after the workers'
+#define _MTL_COMMAND_CTX   MTL_WORKERS_MAX
+// account a system call made into the kernel extension, atomically as they're
+// made concurrently and outside of the stats updates
+#define _MTL_SYSCALL() \
+    fetch_and_addlp( (atomic_l)&_muttley_stats.overhead.syscalls, 1 )
+// name of the alert kernel proc (appears in 'ps aux')
+#define _MTL_ALERT_KPROC_NAME "muttley:alert"
+// checks and successes of a run packed in _muttley_tally, and unpacked
+#define _MTL_TALLY( checks, successes ) ( ( (checks) << 16 ) | (successes) )
+#define _MTL_TALLY_CHECKS( tally )    ( (tally) >> 16 )
+#define _MTL_TALLY_SUCCESSES( tally ) ( (tally) & 0xffff )
+
+// name of the command kernel proc (appears in 'ps aux')
+#define _MTL_COMMAND_KPROC_NAME "muttley:command"
+// path of target t
+#define _MTL_PATH( t )     MTL_PATH( _muttley_paths, _muttley_tconf, t )
+// maximum size of an alert message
+#define _MTL_ALERT_MSG_SZ  256
+// a minute's worth of alert sink credit, in ns
+#define _MTL_ALERT_CREDIT  ( (uint64_t)60 * 1000000000 )
 
 
 // watch dog results
@@ -55,121 +112,2181 @@ enum muttley_watch_res {
     mtl_watch_res_success = 1
 };
 
-// kernel proc control channel commands
-enum muttley_cmds {
-    mtl_cmd_stop = 0,
-    mtl_cmd_start
-};
-enum muttley_cmds _muttley_cmd = mtl_cmd_stop;
+// kernel proc control channel commands
+enum muttley_cmds {
+    mtl_cmd_stop = 0,
+    mtl_cmd_start
+};
+enum muttley_cmds _muttley_cmd = mtl_cmd_stop;
+
+// states of a target with respect to the workers, a target is only ever
+// checked by whoever moved it to busy, i.e. by a single worker at a time
+// (or by the command kernel proc, for a command)
+enum muttley_sched_state {
+    mtl_sched_idle = 0,         // not due, or done with its run
+    mtl_sched_queued,           // due, in a worker's queue
+    mtl_sched_busy              // being checked
+};
+
+// states of a command queue entry
+enum muttley_cmdq_state {
+    mtl_cmdq_free = 0,          // available
+    mtl_cmdq_queued,            // waiting for the command kernel proc
+    mtl_cmdq_busy,              // being handled by the command kernel proc
+    mtl_cmdq_done,              // handled, waiting for its caller
+    mtl_cmdq_abandoned          // its caller gave up while it was busy
+};
+
+// command queue, filled by muttley_command() callers, which then sleep on
+// _muttley_cmdq_done, and emptied by the command kernel proc, which sleeps
+// on _muttley_cmdq_event while it's empty, so that a probe waiting for a
+// target or stuck in a check never holds up the runs, everything in it is
+// protected by _muttley_cmdq_lock
+struct {
+    int state;                           // enum muttley_cmdq_state
+    struct muttley_command cmd;          // the command, results included
+} _muttley_cmdq[ _MTL_CMDQ_SZ ];
+int _muttley_cmdq_queued;                // num of entries queued
+int _muttley_cmdq_waiters;               // num of callers in the queue
+int _muttley_cmdq_done = EVENT_NULL;
+int _muttley_cmdq_event = EVENT_NULL;
+Simple_lock _muttley_cmdq_lock;
+int _muttley_cmdq_lock_allocated;
+
+// fencing hook escalation, the hook daemon sleeps on _muttley_fence_event
+// in muttley_fence until it's triggered, which may happen at interrupt level
+// (the deadline timer), so _muttley_fence_lock is taken with disable_lock,
+// the hook's deadline is kept by _muttley_fence_trb, and the state itself
+// lives in _muttley_stats.fence
+int _muttley_fence_event = EVENT_NULL;
+int _muttley_fence_waiters;              // num of hook daemons in muttley_fence
+Simple_lock _muttley_fence_lock;
+int _muttley_fence_lock_allocated;
+struct trb * _muttley_fence_trb;
+
+// alert queue, a ring filled by whoever detects something, which may be at
+// interrupt level (the deadline timer), and drained all at once into
+// _muttley_alert_batch by the alert kernel proc, which sleeps on
+// _muttley_alert_event while it's empty, all under _muttley_alert_lock,
+// taken with disable_lock, so raising an alert never waits for its emission
+struct muttley_alert {
+    uint64_t time;                       // detection time in ns
+    int type;                            // enum muttley_alert_type
+    int target;                          // target it's about
+} _muttley_alert_queue[ MTL_ALERT_QUEUE_SZ ];
+int _muttley_alert_head;                 // index of the oldest alert queued
+int _muttley_alert_queued;               // num of alerts queued
+int _muttley_alert_event = EVENT_NULL;
+Simple_lock _muttley_alert_lock;
+int _muttley_alert_lock_allocated;
+struct muttley_alert _muttley_alert_batch[ MTL_ALERT_QUEUE_SZ ];
+
+// the alert file (if any), and each sink's credit in ns, a message emitted
+// takes a minute / alert_rate of it, and it's refilled as time goes by, up
+// to a minute's worth, so a sink emits at most alert_rate messages a minute
+struct file * _muttley_alert_fp;
+uint64_t _muttley_alert_credit[ mtl_sink_sz ];
+uint64_t _muttley_alert_refill;
+
+// the kernel proc sleeps on _muttley_kproc_event between runs, with
+// _muttley_sched_lock, it's woken up by _muttley_tick_trb every
+// _muttley_tick_ms (_MTL_TICK_MS, or half the interval between runs when
+// they're closer than twice that) and whenever a worker ran out of targets
+// to check
+int _muttley_kproc_event = EVENT_NULL;
+struct trb * _muttley_tick_trb;
+int _muttley_tick_ms;
+
+// the kernel proc shards every run's due targets across the workers' queues
+// (see shard.h) and the workers sleep on _muttley_worker_event while there's
+// nothing left to check in any of them, _muttley_sched_gen counts the runs
+// published and, along with the sleeps and wakeups, is protected by
+// _muttley_sched_lock, the queues (one per worker) are allocated from the
+// pinned heap when monitoring starts
+struct shard_queue * _muttley_queue;
+int _muttley_worker_event = EVENT_NULL;
+int _muttley_sched_gen;
+Simple_lock _muttley_sched_lock;
+int _muttley_sched_lock_allocated;
+
+// private data block where the 'run time' parameters are copied to for use by
+// the kernel process, followed by those of each target and their paths,
+// allocated from the pinned heap for the targets given
+struct muttley_conf _muttley_conf;
+struct muttley_target_conf * _muttley_tconf;
+char * _muttley_paths;
+
+// checks and successes of a run packed in a single word (see _MTL_TALLY),
+// which the workers load at once, so that a tune command changing them
+// never lets a run begin with the checks of before and the successes of after
+volatile int _muttley_tally;
+
+// running statistics (see struct muttley_stats in .h file), every update is
+// bracketed by _muttley_stats_begin() and _muttley_stats_end() which make
+// _muttley_stats_gen odd while it's in progress, updates come from the
+// workers, the kernel procs and the deadline timers (at interrupt level) so
+// they're serialized by _muttley_stats_lock, taken with disable_lock, and
+// _muttley_stats_ipri keeps the priority to go back to
+struct muttley_stats _muttley_stats;
+struct muttley_target_stats * _muttley_tstats;
+volatile uint64_t _muttley_stats_gen;
+Simple_lock _muttley_stats_lock;
+int _muttley_stats_lock_allocated;
+int _muttley_stats_ipri;
+
+// the statistics of the targets and of the workers, which every check
+// updates, are under a lock of each shard instead, so that workers never
+// contend for a lock but when stealing: a target's are updated under the
+// lock of the shard it's in, between _muttley_target_begin() and
+// _muttley_target_end(), making its own generation odd, and a worker's
+// under the lock of its own shard, between _muttley_shard_begin() and
+// _muttley_shard_end(), making the shard's odd, muttley_snapshot copies each
+// of them on its own, the targets' (_muttley_tstats) and their generations
+// are allocated from the pinned heap when monitoring starts
+Simple_lock _muttley_shard_lock[ MTL_WORKERS_MAX ];
+int _muttley_shard_locks;                // num of them allocated
+int _muttley_shard_ipri[ MTL_WORKERS_MAX ];
+volatile uint64_t _muttley_shard_gen[ MTL_WORKERS_MAX ];
+volatile uint64_t * _muttley_target_gen;
+
+// num of muttley_snapshot and muttley_rollup callers reading the per-target
+// tables, which are only freed once there's none left
+int _muttley_readers;
+
+// num of muttley_command and muttley_fence callers, counted before they look
+// at whether monitoring runs, the locks (and the timer) they take are only
+// freed once there's none left
+int _muttley_callers;
+
+// used to write to the console when a threshold occurs
+struct file * _console_fp;
+
+// flight recorder of the latest runs, updated with plain stores on every run
+// and only written out to _recorder_fp when the threshold is reached or
+// monitoring stops, so that it can be analysed after a panic
+struct muttley_fr _muttley_fr;
+struct file * _recorder_fp;
+
+// the string we send to errpt and to the console
+const char * _panic_str = _MTL_PANIC_STR;
+
+// rollup windows of every target (see struct muttley_rollups in .h file),
+// allocated from the pinned heap when monitoring starts, like every other
+// per-target table (see MTL_TARGET_KMEM in .h file)
+struct muttley_rollups * _muttley_rollups;
+
+// window lengths in seconds, by enum muttley_window
+const int _muttley_window_len[ mtl_window_sz ] = {
+    _MTL_WINDOW_MINUTE,
+    _MTL_WINDOW_HOUR,
+    _MTL_WINDOW_DAY
+};
+
+// held open directory of each canary target, which its checks go through,
+// so that none of their steps walks the target's path
+struct file ** _muttley_dir_fp;
+
+// held open device of each read target, when checks are tiered (see struct
+// muttley_held in .h file), only the context which claimed a target touches
+// its entry
+struct muttley_held * _muttley_held;
+
+// sequence number of the latest write of a write target, seeded with the
+// start time so that blocks left by previous starts never match
+uint64_t _muttley_write_seq;
+
+// result of each target in the current run (1 passed, 0 failed, -1 not
+// checked), and what the logical targets' results are worked out from (see
+// struct muttley_derived in .h file)
+int * _muttley_run_res;
+struct muttley_derived * _muttley_derived;
+
+// where each target is at with respect to the workers (see struct
+// muttley_sched in .h file), filled in by the worker which checked it
+struct muttley_sched * _muttley_sched;
+
+// flight recorder slot of the current run, where the workers add checks
+struct muttley_fr_run * volatile _muttley_fr_run;
+
+// heartbeat device, held open while monitoring, and the buffer the whole
+// heartbeat region is read into, followed by our own slot, allocated aligned
+// for direct i/o
+struct file * _muttley_hb_fp;
+char * _muttley_hb_buf;
+
+// what a worker (or the command kernel proc, in _MTL_COMMAND_CTX) checks
+// targets with, the step it's executing is watched by its deadline_trb
+// timer, which fires when the step's deadline expires, and scratch is the
+// block buffer of write targets, allocated aligned for direct i/o
+struct muttley_worker {
+    int id;                              // index in _muttley_worker[]
+    volatile int target;                 // target being checked
+    volatile int step;                   // step being executed
+    volatile int expired;                // set when the deadline expired
+    uint64_t io_calls;                   // i/o of the check being made, added
+    uint64_t io_bytes;                   // to its target's stats once done
+    int tier;                            // tier of the check being made
+    int escalated;                       // was it a query gone full
+    struct trb * deadline_trb;
+    char * scratch;
+} _muttley_worker[ MTL_WORKERS_MAX + 1 ];
+
+// probe trace ring, written by the workers and the command kernel proc and
+// read lock free by muttley_trace(), _muttley_trace_head is the sequence
+// number of the next event to be claimed by a writer, the ring slot of an
+// event is its seq modulo the size
+struct muttley_event _muttley_trace_ring[ MTL_TRACE_SZ ];
+volatile uint64_t _muttley_trace_head;
+
+
+// current time in nanoseconds since the epoch
+uint64_t _muttley_now( void ) {
+
+    struct timestruc_t t;
+
+    curtime( &t );
+    return( (uint64_t)t.tv_sec * 1000000000 + t.tv_nsec );
+}
+
+
+// start an update of _muttley_stats
+void _muttley_stats_begin( void ) {
+
+    int ipri;
+
+    ipri = disable_lock( INTMAX, &_muttley_stats_lock );
+    _muttley_stats_ipri = ipri;
+    _muttley_stats_gen++;
+    __lwsync();
+}
+
+
+// complete an update of _muttley_stats
+void _muttley_stats_end( void ) {
+
+    int ipri = _muttley_stats_ipri;
+
+    __lwsync();
+    _muttley_stats_gen++;
+    unlock_enable( ipri, &_muttley_stats_lock );
+}
+
+
+// start an update of the statistics of the workers of a shard
+void _muttley_shard_begin( int shard ) {
+
+    int ipri;
+
+    ipri = disable_lock( INTMAX, &_muttley_shard_lock[ shard ] );
+    _muttley_shard_ipri[ shard ] = ipri;
+    _muttley_shard_gen[ shard ]++;
+    __lwsync();
+}
+
+
+// complete an update of the statistics of the workers of a shard
+void _muttley_shard_end( int shard ) {
+
+    int ipri = _muttley_shard_ipri[ shard ];
+
+    __lwsync();
+    _muttley_shard_gen[ shard ]++;
+    unlock_enable( ipri, &_muttley_shard_lock[ shard ] );
+}
+
+
+// start an update of a target's statistics, under its shard's lock
+void _muttley_target_begin( int target ) {
+
+    int ipri, shard = shard_owner( target, _muttley_conf.workers );
+
+    ipri = disable_lock( INTMAX, &_muttley_shard_lock[ shard ] );
+    _muttley_shard_ipri[ shard ] = ipri;
+    _muttley_target_gen[ target ]++;
+    __lwsync();
+}
+
+
+// complete an update of a target's statistics
+void _muttley_target_end( int target ) {
+
+    int shard = shard_owner( target, _muttley_conf.workers );
+    int ipri = _muttley_shard_ipri[ shard ];
+
+    __lwsync();
+    _muttley_target_gen[ target ]++;
+    unlock_enable( ipri, &_muttley_shard_lock[ shard ] );
+}
+
+
+// account a check in a target's rollup windows, only the context which
+// claimed the target writes them, so no lock is taken (muttley_rollup reads
+// them lock free as well)
+void _muttley_rollup_add( int target, uint64_t start, uint64_t latency,
+                          int res ) {
+
+    int w;
+    uint32_t epoch;
+    struct muttley_slot * slot;
+
+    for( w = 0; w < mtl_window_sz; w++ ) {
+
+        epoch = start / 1000000000 /
+            ( _muttley_window_len[ w ] / MTL_WINDOW_SLOTS );
+        slot = &_muttley_rollups[ target ].slot[ w ][ epoch % MTL_WINDOW_SLOTS ];
+
+        // the slot still holds an older period, start it over
+        if( slot->epoch != epoch ) {
+            slot->probes = 0;
+            slot->failures = 0;
+            slot->latency_max = 0;
+            sketch_clear( &slot->latency );
+            slot->epoch = epoch;
+        }
+
+        slot->probes++;
+        if( res != mtl_watch_res_success )
+            slot->failures++;
+        if( latency / 1000 > slot->latency_max )
+            slot->latency_max = latency / 1000;
+        sketch_add( &slot->latency, latency );
+    }
+}
+
+
+// append a probe event to the trace ring, this never blocks, if a reader
+// is too slow the oldest events are simply overwritten, writers claim their
+// sequence number first, so the head may be ahead of events still being
+// written
+void _muttley_trace_event( int target, uint64_t start, uint64_t latency,
+                           int result, int error ) {
+
+    uint64_t seq = fetch_and_addlp( (atomic_l)&_muttley_trace_head, 1 );
+    struct muttley_event * e = &_muttley_trace_ring[ seq & ( MTL_TRACE_SZ - 1 ) ];
+
+    // invalidate the slot while rewriting it, readers racing with us will
+    // see a sequence mismatch and discard what they've copied
+    e->seq = _MTL_TRACE_INVALID;
+    __lwsync();
+    e->start = start;
+    e->latency = latency;
+    e->target = target;
+    e->result = result;
+    e->error = error;
+    __lwsync();
+    e->seq = seq;
+}
+
+
+// raise an alert, queueing it for the alert kernel proc, may be called at
+// interrupt level, it's dropped if the queue is full
+void _muttley_alert( int type, int target ) {
+
+    int ipri, dropped = 0;
+    struct muttley_alert * a;
+
+    if( !_muttley_alert_lock_allocated )
+        return;
+
+    ipri = disable_lock( INTMAX, &_muttley_alert_lock );
+    if( _muttley_alert_queued < MTL_ALERT_QUEUE_SZ ) {
+        a = &_muttley_alert_queue[ ( _muttley_alert_head +
+                                     _muttley_alert_queued ) %
+                                   MTL_ALERT_QUEUE_SZ ];
+        a->time = _muttley_now();
+        a->type = type;
+        a->target = target;
+        _muttley_alert_queued++;
+        e_wakeup( &_muttley_alert_event );
+    } else
+        dropped = 1;
+    _muttley_stats_begin();
+    _muttley_stats.alert.raised++;
+    _muttley_stats.alert.dropped += dropped;
+    _muttley_stats.alert.queued = _muttley_alert_queued;
+    _muttley_stats_end();
+    unlock_enable( ipri, &_muttley_alert_lock );
+}
+
+
+// alert on a target going from passing runs to failing them, or back, given
+// its consecutive failed runs before and after its latest run
+void _muttley_alert_change( int target, int before, int after ) {
+
+    if( !before && after )
+        _muttley_alert( mtl_alert_failing, target );
+    else if( before && !after )
+        _muttley_alert( mtl_alert_recovered, target );
+}
+
+
+// escalate once 'target' reached the failed runs threshold, may be called at
+// interrupt level (a stuck kernel proc can't), the hook daemon is woken up
+// to start the hook, which is given hook_timeout ms to succeed, without a
+// hook panic right away (for the panic behaviour)
+void _muttley_escalate( int target, int failed_runs ) {
+
+    int ipri;
+    struct muttley_fence_stats * fs = &_muttley_stats.fence;
+
+    if( ( _muttley_conf.behaviour == mtl_behaviour_none ) ||
+        ( failed_runs < _muttley_conf.runs ) )
+        return;
+    if( !_muttley_conf.hook_timeout ) {
+        if( _muttley_conf.behaviour == mtl_behaviour_panic )
+            panic( _panic_str );
+        return;
+    }
+
+    ipri = disable_lock( INTMAX, &_muttley_fence_lock );
+    if( fs->state == mtl_fence_idle ) {
+        _muttley_stats_begin();
+        fs->seq++;
+        fs->detected = _muttley_now();
+        fs->woken = 0;
+        fs->started = 0;
+        fs->finished = 0;
+        fs->target = target;
+        fs->status = 0;
+        fs->state = mtl_fence_triggered;
+        _muttley_stats_end();
+        _muttley_fence_trb->timeout.it_value.tv_sec =
+            _muttley_conf.hook_timeout / 1000;
+        _muttley_fence_trb->timeout.it_value.tv_nsec =
+            ( _muttley_conf.hook_timeout % 1000 ) * 1000000;
+        tstart( _muttley_fence_trb );
+        e_wakeup( &_muttley_fence_event );
+    }
+    unlock_enable( ipri, &_muttley_fence_lock );
+}
+
+
+// fail the hook if it's still pending, called with _muttley_fence_lock
+// held, returns true if it did
+int _muttley_fence_fail( void ) {
+
+    struct muttley_fence_stats * fs = &_muttley_stats.fence;
+
+    if( ( fs->state != mtl_fence_triggered ) &&
+        ( fs->state != mtl_fence_running ) )
+        return( 0 );
+
+    _muttley_stats_begin();
+    fs->state = mtl_fence_failed;
+    fs->failures++;
+    _muttley_stats_end();
+    return( 1 );
+}
+
+
+// fencing hook deadline timer handler, runs at interrupt level when the hook
+// hasn't succeeded in hook_timeout ms
+void _muttley_fence_expired( struct trb * t ) {
+
+    int ipri, failed;
+
+    ipri = disable_lock( INTMAX, &_muttley_fence_lock );
+    failed = _muttley_fence_fail();
+    unlock_enable( ipri, &_muttley_fence_lock );
+
+    if( failed && ( _muttley_conf.behaviour == mtl_behaviour_panic ) )
+        panic( _panic_str );
+}
+
+
+// deadline timer handler, runs at interrupt level when a step is stuck past
+// its deadline, while the worker is blocked in it: every interval the step
+// stays stuck is accounted as a failed run of its target, so that the
+// configured behaviour is executed within a bounded time
+void _muttley_deadline( struct trb * t ) {
+
+    int before, after;
+    struct muttley_worker * wk = &_muttley_worker[ t->func_data ];
+    struct muttley_target_stats * ts = &_muttley_tstats[ wk->target ];
+
+    wk->expired = 1;
+
+    _muttley_target_begin( wk->target );
+    before = ts->failed_runs;
+    ts->stalls++;
+    ts->stalled_step = wk->step;
+    after = ++ts->failed_runs;
+    _muttley_target_end( wk->target );
+
+    _muttley_stats_begin();
+    if( after > _muttley_stats.failed_runs )
+        _muttley_stats.failed_runs = after;
+    _muttley_stats_end();
+
+    _muttley_alert_change( wk->target, before, after );
+
+    _muttley_escalate( wk->target, after );
+
+    // keep watching while the step is stuck
+    t->timeout.it_value.tv_sec = _muttley_conf.interval;
+    t->timeout.it_value.tv_nsec = 0;
+    tstart( t );
+}
+
+
+// deadline in ms of a step of a check on target (0 for none), the step's
+// own, else the one the target's baseline set (for its queries, if it set
+// one apart)
+int _muttley_step_deadline( int target, int step ) {
+
+    if( _muttley_conf.deadline[ step ] )
+        return( _muttley_conf.deadline[ step ] );
+    if( ( step == mtl_step_query ) && _muttley_tconf[ target ].query_limit )
+        return( _muttley_tconf[ target ].query_limit );
+    return( _muttley_tconf[ target ].limit );
+}
+
+
+// start a step of a check on target, arming the worker's deadline timer if
+// the step has a deadline, returns the step's start time
+uint64_t _muttley_step_begin( struct muttley_worker * wk, int target,
+                              int step ) {
+
+    int deadline = _muttley_step_deadline( target, step );
+
+    wk->target = target;
+    wk->step = step;
+    wk->expired = 0;
+
+    if( deadline && wk->deadline_trb ) {
+        wk->deadline_trb->timeout.it_value.tv_sec = deadline / 1000;
+        wk->deadline_trb->timeout.it_value.tv_nsec =
+            ( deadline % 1000 ) * 1000000;
+        tstart( wk->deadline_trb );
+    }
+
+    return( _muttley_now() );
+}
+
+
+// complete a step started at 'start', disarming the deadline timer and
+// accounting the step's duration, a step which finished past its deadline
+// has failed with ETIMEDOUT (unless it failed on its own), returns the
+// step's errno
+int _muttley_step_end( struct muttley_worker * wk, int target, int step,
+                       uint64_t start, int error ) {
+
+    uint64_t latency = _muttley_now() - start;
+    int deadline = _muttley_step_deadline( target, step );
+    struct muttley_target_stats * ts = &_muttley_tstats[ target ];
+
+    // make sure the timer handler isn't running before touching statistics
+    if( deadline && wk->deadline_trb )
+        while( tstop( wk->deadline_trb ) )
+            ;
+
+    _muttley_target_begin( target );
+    ts->step_latency[ step ] = latency;
+    if( latency > ts->step_max[ step ] )
+        ts->step_max[ step ] = latency;
+    if( deadline && ( latency > (uint64_t)deadline * 1000000 ) ) {
+        ts->timeouts++;
+        if( !error )
+            error = ETIMEDOUT;
+    }
+    if( wk->expired )
+        ts->stalled_step = -1;
+    _muttley_target_end( target );
+
+    return( error );
+}
+
+
+// perform one monitoring test on a device, i.e. tries to open, read and close
+// it, usually /dev/rhd4 which contains the / filesystem, returns the errno of
+// the failed step (or 0)
+int _muttley_watch_read( struct muttley_worker * wk, int target ) {
+
+    int r, o;
+    long int b;
+    uint64_t start;
+    struct file * dev_fp;
+
+    // open the device for reading, return on failure (which includes an
+    // open that succeeded too late), files bypass the cache like raw devices
+    start = _muttley_step_begin( wk, target, mtl_step_open );
+    o = fp_open( _MTL_PATH( target ), O_RDONLY |
+                 ( _muttley_tconf[ target ].direct ? O_DIRECT : 0 ), 0, 0,
+                 SYS_ADSPACE, &dev_fp );
+    wk->io_calls += o ? 1 : 2;
+    if( ( r = _muttley_step_end( wk, target, mtl_step_open, start, o ) ) ) {
+        if( !o )
+            fp_close( dev_fp );
+        return( r );
+    }
+
+    // read _MTL_READ_BUF_SZ bytes into the (page aligned) scratch buffer, the
+    // number of bytes requested must match the number of bytes read
+    start = _muttley_step_begin( wk, target, mtl_step_read );
+    r = fp_read( dev_fp, wk->scratch, _MTL_READ_BUF_SZ, 0, SYS_ADSPACE, &b );
+    wk->io_calls++;
+    wk->io_bytes += r ? 0 : b;
+    if( !r && ( b != _MTL_READ_BUF_SZ ) )
+        r = EIO;
+    r = _muttley_step_end( wk, target, mtl_step_read, start, r );
+
+    fp_close( dev_fp );
+
+    return( r );
+}
+
+
+// query a read target's held device, i.e. ask its driver for the device's
+// characteristics (IOCINFO), or stat it for a file, without transferring
+// any data, and fingerprint what it returned, returns the errno of the query,
+// neither IOCINFO nor fstat does any i/o to the device (the driver answers
+// from what it keeps of it, fstat from the inode), so a query can't tell a
+// lost path or LUN, only full checks can, which is why the device is only
+// held, and queried, while its full checks pass
+int _muttley_query( struct file * fp, int target, uint64_t * print ) {
+
+    int r, i;
+    unsigned char * p;
+    struct devinfo di;
+    struct stat st;
+
+    *print = 0xcbf29ce484222325UL;
+    if( _muttley_tconf[ target ].direct ) {
+        if( ( r = fp_fstat( fp, &st, sizeof( st ), SYS_ADSPACE ) ) )
+            return( r );
+        *print ^= (uint64_t)st.st_size ^ ( (uint64_t)st.st_ino << 32 );
+        return( 0 );
+    }
+
+    bzero( (char *)&di, sizeof( di ) );
+    if( ( r = fp_ioctl( fp, IOCINFO, (caddr_t)&di, 0 ) ) )
+        return( r );
+    for( i = 0, p = (unsigned char *)&di; i < sizeof( di ); i++ ) {
+        *print ^= p[ i ];
+        *print *= 0x100000001b3UL;
+    }
+    return( 0 );
+}
+
+
+// hold a read target's device open, for the query tier, replacing the one
+// held before (if any), the device is left unheld if it doesn't open or
+// can't be queried, so that its checks are full until it does
+void _muttley_hold( int target ) {
+
+    struct muttley_held * h = &_muttley_held[ target ];
+
+    if( h->fp ) {
+        fp_close( h->fp );
+        h->fp = NULL;
+    }
+    if( fp_open( _MTL_PATH( target ), O_RDONLY, 0, 0,
+                 SYS_ADSPACE, &h->fp ) ) {
+        h->fp = NULL;
+        return;
+    }
+    if( _muttley_query( h->fp, target, &h->print ) ) {
+        fp_close( h->fp );
+        h->fp = NULL;
+    }
+}
+
+
+// perform a query check on a read target, i.e. query its held device, as a
+// step of its own, returns the errno of the query, or EIO when it returned
+// something else than when the device was opened (or the device isn't held)
+int _muttley_watch_query( struct muttley_worker * wk, int target ) {
+
+    int r;
+    uint64_t start, print;
+    struct muttley_held * h = &_muttley_held[ target ];
+
+    if( !h->fp )
+        return( EIO );
+
+    start = _muttley_step_begin( wk, target, mtl_step_query );
+    r = _muttley_query( h->fp, target, &print );
+    wk->io_calls++;
+    if( !r && ( print != h->print ) )
+        r = EIO;
+    return( _muttley_step_end( wk, target, mtl_step_query, start, r ) );
+}
+
+
+// perform one monitoring test on a read target, according to its tier, i.e.
+// query its held device unless it's due a full check (or it's for a
+// command), and read it right away if the query looks wrong, a device which
+// fails a full check is let go of, so that every check of it is full until
+// one passes, and only then is it held anew (as is one which reads fine
+// after a query looked wrong, e.g. it was reconfigured), returns the errno
+// of the failed step (or 0)
+int _muttley_watch_tiered( struct muttley_worker * wk, int target ) {
+
+    int r;
+    struct muttley_held * h = &_muttley_held[ target ];
+
+    if( h->fp && ( wk->id != _MTL_COMMAND_CTX ) &&
+        ( ++h->queries < _muttley_conf.full_every ) ) {
+        wk->tier = mtl_tier_query;
+        if( !_muttley_watch_query( wk, target ) )
+            return( 0 );
+        wk->tier = mtl_tier_full;
+        wk->escalated = 1;
+    }
+
+    h->queries = 0;
+    r = _muttley_watch_read( wk, target );
+    if( r && h->fp ) {
+        fp_close( h->fp );
+        h->fp = NULL;
+    } else if( !r && ( _muttley_conf.full_every > 1 ) &&
+               ( !h->fp || wk->escalated ) )
+        _muttley_hold( target );
+
+    return( r );
+}
+
+
+// perform one monitoring test on a filesystem, i.e. statfs it and create,
+// write, fsync and remove a canary file in the target's directory, so that
+// hung journals or mounts, and filesystems which stopped taking writes, are
+// caught, every step goes through the held directory's vnode (the canary is
+// created in it and removed from it by name), so no step walks the target's
+// path, returns the errno of the failed step (or 0)
+int _muttley_watch_canary( struct muttley_worker * wk, int target ) {
+
+    int r, e, o;
+    uint64_t start;
+    struct vnode * dvp, * vp;
+    struct ucred * crp;
+    struct statfs sfs;
+    struct iovec iov;
+    struct uio uio;
+    char buf[ _MTL_READ_BUF_SZ ];
+
+    dvp = _muttley_dir_fp[ target ]->f_vnode;
+    crp = crref();
+
+    // statfs through the held directory, no lookups involved
+    start = _muttley_step_begin( wk, target, mtl_step_statfs );
+    r = VFS_STATFS( dvp->v_vfsp, &sfs, crp );
+    wk->io_calls++;
+    if( ( r = _muttley_step_end( wk, target, mtl_step_statfs, start, r ) ) ) {
+        crfree( crp );
+        return( r );
+    }
+
+    // create (and open) the canary in the held directory, which only looks
+    // its name up in there
+    start = _muttley_step_begin( wk, target, mtl_step_create );
+    o = VNOP_CREATE( dvp, &vp, FWRITE | FTRUNC, _MTL_CANARY_NAME, 0600, NULL,
+                     crp );
+    wk->io_calls += o ? 1 : 2;
+    if( ( r = _muttley_step_end( wk, target, mtl_step_create, start, o ) ) ) {
+        if( !o ) {
+            VNOP_CLOSE( vp, FWRITE, NULL, crp );
+            VNOP_RELE( vp );
+        }
+        crfree( crp );
+        return( r );
+    }
+
+    bzero( buf, sizeof( buf ) );
+    iov.iov_base = buf;
+    iov.iov_len = _MTL_READ_BUF_SZ;
+    bzero( (char *)&uio, sizeof( uio ) );
+    uio.uio_iov = &iov;
+    uio.uio_iovcnt = 1;
+    uio.uio_offset = 0;
+    uio.uio_segflg = UIO_SYSSPACE;
+    uio.uio_fmode = FWRITE;
+    uio.uio_resid = _MTL_READ_BUF_SZ;
+    start = _muttley_step_begin( wk, target, mtl_step_write );
+    r = VNOP_RDWR( vp, UIO_WRITE, FWRITE, &uio, 0, NULL, NULL, crp );
+    wk->io_calls++;
+    wk->io_bytes += r ? 0 : _MTL_READ_BUF_SZ - uio.uio_resid;
+    if( !r && uio.uio_resid )
+        r = EIO;
+    r = _muttley_step_end( wk, target, mtl_step_write, start, r );
+
+    // even after a failed write, a close is needed, time it along with the
+    // fsync as it may flush on some filesystems (e.g. NFS)
+    start = _muttley_step_begin( wk, target, mtl_step_fsync );
+    e = r ? 0 : VNOP_FSYNC( vp, FWRITE, 0, crp );
+    wk->io_calls += r ? 0 : 1;
+    VNOP_CLOSE( vp, FWRITE, NULL, crp );
+    e = _muttley_step_end( wk, target, mtl_step_fsync, start, e );
+    r = r ? r : e;
+
+    // remove the canary through the vnode the create returned, no lookups
+    // involved either
+    start = _muttley_step_begin( wk, target, mtl_step_unlink );
+    e = VNOP_REMOVE( vp, dvp, _MTL_CANARY_NAME, crp );
+    wk->io_calls++;
+    VNOP_RELE( vp );
+    e = _muttley_step_end( wk, target, mtl_step_unlink, start, e );
+
+    crfree( crp );
+    return( r ? r : e );
+}
+
+
+// perform one monitoring test on a target's scratch block, i.e. write a new
+// sequence numbered block and read it back, so that devices which still
+// read (e.g. from the storage array's cache) but no longer take writes are
+// caught, returns the errno of the failed step (or 0)
+int _muttley_watch_write( struct muttley_worker * wk, int target ) {
+
+    int r, o;
+    long int b;
+    uint64_t start, seq;
+    struct file * fp;
+    struct muttley_scratch * blk = (struct muttley_scratch *)wk->scratch;
+
+    start = _muttley_step_begin( wk, target, mtl_step_open );
+    o = fp_open( _MTL_PATH( target ), O_RDWR | O_DSYNC |
+                 ( _muttley_tconf[ target ].direct ? O_DIRECT : 0 ), 0, 0,
+                 SYS_ADSPACE, &fp );
+    wk->io_calls += o ? 1 : 2;
+    if( ( r = _muttley_step_end( wk, target, mtl_step_open, start, o ) ) ) {
+        if( !o )
+            fp_close( fp );
+        return( r );
+    }
+
+    seq = fetch_and_addlp( (atomic_l)&_muttley_write_seq, 1 ) + 1;
+    bzero( wk->scratch, MTL_SCRATCH_SZ );
+    blk->magic = MTL_SCRATCH_MAGIC;
+    blk->target = target;
+    blk->seq = seq;
+    blk->time = _muttley_now();
+
+    start = _muttley_step_begin( wk, target, mtl_step_write );
+    wk->io_calls++;
+    if( !( r = fp_lseek( fp, _muttley_tconf[ target ].offset, SEEK_SET ) ) ) {
+        r = fp_write( fp, wk->scratch, MTL_SCRATCH_SZ, 0, SYS_ADSPACE, &b );
+        wk->io_calls++;
+        wk->io_bytes += r ? 0 : b;
+        if( !r && ( b != MTL_SCRATCH_SZ ) )
+            r = EIO;
+    }
+    r = _muttley_step_end( wk, target, mtl_step_write, start, r );
+
+    // read it back into a cleared buffer, it must hold what we just wrote
+    if( !r ) {
+        bzero( wk->scratch, MTL_SCRATCH_SZ );
+        start = _muttley_step_begin( wk, target, mtl_step_read );
+        wk->io_calls++;
+        if( !( r = fp_lseek( fp, _muttley_tconf[ target ].offset,
+                             SEEK_SET ) ) ) {
+            r = fp_read( fp, wk->scratch, MTL_SCRATCH_SZ, 0, SYS_ADSPACE,
+                         &b );
+            wk->io_calls++;
+            wk->io_bytes += r ? 0 : b;
+            if( !r && ( ( b != MTL_SCRATCH_SZ ) ||
+                        ( blk->magic != MTL_SCRATCH_MAGIC ) ||
+                        ( blk->seq != seq ) ) )
+                r = EIO;
+        }
+        r = _muttley_step_end( wk, target, mtl_step_read, start, r );
+    }
+
+    fp_close( fp );
+
+    return( r );
+}
+
+
+// perform one monitoring test on a target, according to its type, the errno
+// of the failed step (or 0) is returned in *error
+enum muttley_watch_res _muttley_watch( struct muttley_worker * wk, int target,
+                                       int * error ) {
+
+    switch( _muttley_tconf[ target ].type ) {
+        case mtl_target_canary:
+            *error = _muttley_watch_canary( wk, target );
+            break;
+        case mtl_target_write:
+            *error = _muttley_watch_write( wk, target );
+            break;
+        default:
+            *error = _muttley_watch_tiered( wk, target );
+            break;
+    }
+
+    return( *error ? mtl_watch_res_failure : mtl_watch_res_success );
+}
+
+
+// perform one monitoring test on a target, timing it, accounting it in the
+// target's statistics and appending the outcome to the trace ring and to the
+// flight recorder's current run (if it's part of one)
+enum muttley_watch_res _muttley_probe( struct muttley_worker * wk, int target,
+                                       struct muttley_fr_run * run ) {
+
+    int c, error;
+    uint64_t start, latency;
+    enum muttley_watch_res res;
+    struct muttley_fr_check * check;
+    struct muttley_target_stats * ts = &_muttley_tstats[ target ];
+
+    wk->io_calls = 0;
+    wk->io_bytes = 0;
+    wk->tier = mtl_tier_full;
+    wk->escalated = 0;
+
+    start = _muttley_now();
+    res = _muttley_watch( wk, target, &error );
+    latency = _muttley_now() - start;
+    _muttley_trace_event( target, start, latency, res, error );
+
+    // the check's i/o is counted as it's made, in the worker's own context,
+    // and added along with the rest of its outcome
+    _muttley_target_begin( target );
+    ts->probes++;
+    ts->io_calls += wk->io_calls;
+    ts->io_bytes += wk->io_bytes;
+    ts->tier_probes[ wk->tier ]++;
+    ts->tier_latency[ wk->tier ] += latency;
+    if( latency > ts->tier_max[ wk->tier ] )
+        ts->tier_max[ wk->tier ] = latency;
+    ts->escalations += wk->escalated;
+    if( res == mtl_watch_res_success )
+        ts->successes++;
+    else
+        ts->failures++;
+    ts->latency += latency;
+    if( latency > ts->latency_max )
+        ts->latency_max = latency;
+    ts->last_time = start;
+    ts->last_latency = latency;
+    ts->last_result = res;
+    ts->last_error = error;
+    _muttley_target_end( target );
+
+    _muttley_rollup_add( target, start, latency, res );
+
+    // the workers add their checks to the run at once, each in its own slot
+    if( run && ( ( c = fetch_and_add( &run->checks, 1 ) ) < MTL_FR_CHECKS ) ) {
+        check = &run->check[ c ];
+        check->latency = latency / 1000;
+        check->target = target;
+        check->error = error;
+    }
+
+    return( res );
+}
+
+
+// tick timer handler, runs at interrupt level every _muttley_tick_ms to wake
+// the kernel proc up, as it can't take _muttley_sched_lock a tick may come
+// right before the kernel proc goes to sleep, which delays it by one more
+// tick
+void _muttley_tick( struct trb * t ) {
+
+    e_wakeup( &_muttley_kproc_event );
+
+    t->timeout.it_value.tv_sec = 0;
+    t->timeout.it_value.tv_nsec = _muttley_tick_ms * 1000000;
+    tstart( t );
+}
+
+
+// interval between runs in ns, query_ms when given (tiered checks, runs
+// more than once a second) or else interval seconds
+uint64_t _muttley_run_interval( void ) {
+
+    if( _muttley_conf.query_ms )
+        return( (uint64_t)_muttley_conf.query_ms * 1000000 );
+    return( (uint64_t)_muttley_conf.interval * 1000000000 );
+}
+
+
+// zero a target's counters, keeping its kind and whether it's paused
+void _muttley_reset( int target ) {
+
+    int paused = _muttley_tstats[ target ].paused;
+    int type = _muttley_tstats[ target ].type;
+
+    _muttley_target_begin( target );
+    bzero( (char *)&_muttley_tstats[ target ],
+           sizeof( struct muttley_target_stats ) );
+    _muttley_tstats[ target ].stalled_step = -1;
+    _muttley_tstats[ target ].paused = paused;
+    _muttley_tstats[ target ].type = type;
+    _muttley_target_end( target );
+}
+
+
+// take a target from the workers, to check it for a command, waiting for
+// them to be done with it for up to an interval, returns true if it was,
+// only the command kernel proc waits here, never the kernel proc
+int _muttley_claim( int target ) {
+
+    int i, idle;
+
+    for( i = 0; i <= _muttley_conf.interval * HZ; i++ ) {
+        idle = mtl_sched_idle;
+        if( compare_and_swap( &_muttley_sched[ target ].state, &idle,
+                              mtl_sched_busy ) )
+            return( 1 );
+        delay( 1 );
+    }
+
+    return( 0 );
+}
+
+
+// give a target taken with _muttley_claim() back to the workers
+void _muttley_unclaim( int target ) {
+
+    __lwsync();
+    _muttley_sched[ target ].state = mtl_sched_idle;
+}
+
+
+// change the run time parameters as a tune command asks, every one of them
+// must be in the range main() allows (the system call may be made directly)
+// and valid along with those left unchanged, or none is changed, checks and
+// successes are published together through _muttley_tally, as the workers
+// may begin a run at any time
+void _muttley_tune( struct muttley_command * cmd ) {
+
+    struct muttley_tune * tn = &cmd->tune;
+    int checks = tn->checks ? tn->checks : _muttley_conf.checks;
+    int successes = tn->successes ? tn->successes : _muttley_conf.successes;
+
+    if( ( tn->interval < 0 ) || ( tn->interval > MTL_INTERVAL_MAX ) ||
+        ( tn->runs < 0 ) || ( tn->runs > MTL_RUNS_MAX ) ||
+        ( tn->checks < 0 ) || ( tn->checks > MTL_CHECKS_MAX ) ||
+        ( tn->successes < 0 ) || ( tn->full_every < 0 ) ||
+        ( tn->full_every > MTL_FULL_EVERY_MAX ) || ( tn->alert_rate < 0 ) ||
+        ( tn->alert_rate > MTL_ALERT_RATE_MAX ) || ( successes > checks ) ) {
+        cmd->result = 0;
+        cmd->error = EINVAL;
+        return;
+    }
+
+    _muttley_conf.checks = checks;
+    _muttley_conf.successes = successes;
+    __lwsync();
+    _muttley_tally = _MTL_TALLY( checks, successes );
+    if( tn->interval )
+        _muttley_conf.interval = tn->interval;
+    if( tn->runs )
+        _muttley_conf.runs = tn->runs;
+    if( tn->full_every )
+        _muttley_conf.full_every = tn->full_every;
+    if( tn->alert_rate )
+        _muttley_conf.alert_rate = tn->alert_rate;
+
+    // the flight recorder's runs are recorded with the new ones from now on
+    _muttley_fr.checks = _muttley_conf.checks;
+    _muttley_fr.successes = _muttley_conf.successes;
+    _muttley_fr.interval = _muttley_conf.interval;
+
+    _muttley_stats_begin();
+    _muttley_stats.alert.rate = _muttley_conf.alert_rate;
+    _muttley_stats_end();
+}
+
+
+// carry out a single command, filling in its results
+void _muttley_command( struct muttley_command * cmd ) {
+
+    int t, first, last;
+    struct muttley_target_stats * ts;
+
+    // tuning is about every target at once
+    if( cmd->type == mtl_command_tune ) {
+        cmd->result = 1;
+        cmd->error = 0;
+        cmd->latency = 0;
+        _muttley_tune( cmd );
+        return;
+    }
+
+    first = ( cmd->target == MTL_TARGET_ALL ) ? 0 : cmd->target;
+    last = ( cmd->target == MTL_TARGET_ALL ) ? _muttley_conf.targets :
+        cmd->target + 1;
+
+    cmd->result = 1;
+    cmd->error = 0;
+    cmd->latency = 0;
+
+    for( t = first; t < last; t++ ) {
+
+        ts = &_muttley_tstats[ t ];
+
+        switch( cmd->type ) {
+            case mtl_command_probe:
+                // an extra check, outside of any run, so it only shows in
+                // the target's counters (and trace and rollups), a target a
+                // worker is stuck on can't be checked
+                if( !_muttley_claim( t ) ) {
+                    cmd->result = 0;
+                    if( !cmd->error )
+                        cmd->error = EBUSY;
+                    break;
+                }
+                if( _muttley_probe( &_muttley_worker[ _MTL_COMMAND_CTX ], t,
+                                    NULL ) != mtl_watch_res_success ) {
+                    cmd->result = 0;
+                    if( !cmd->error )
+                        cmd->error = ts->last_error;
+                }
+                _muttley_unclaim( t );
+                if( ts->last_latency > cmd->latency )
+                    cmd->latency = ts->last_latency;
+                break;
+            case mtl_command_pause:
+            case mtl_command_resume:
+                _muttley_target_begin( t );
+                ts->paused = ( cmd->type == mtl_command_pause );
+                _muttley_target_end( t );
+                break;
+            case mtl_command_reset:
+                _muttley_reset( t );
+                // the rollups are only written by whoever claimed the
+                // target, one a worker is stuck on keeps them (they age
+                // out) and fails the command
+                if( !_muttley_claim( t ) ) {
+                    cmd->result = 0;
+                    if( !cmd->error )
+                        cmd->error = EBUSY;
+                    break;
+                }
+                bzero( (char *)&_muttley_rollups[ t ],
+                       sizeof( struct muttley_rollups ) );
+                _muttley_unclaim( t );
+                break;
+        }
+    }
+
+    if( ( cmd->type == mtl_command_reset ) &&
+        ( cmd->target == MTL_TARGET_ALL ) ) {
+        _muttley_stats_begin();
+        _muttley_stats.runs = 0;
+        _muttley_stats.failed_runs_total = 0;
+        _muttley_stats.total_successes = 0;
+        _muttley_stats.total_failures = 0;
+        _muttley_stats.failed_runs = 0;
+        _muttley_stats_end();
+    }
+}
+
+
+// handle the commands queued by muttley_command() callers, as a single batch,
+// in the command kernel proc, the queue's lock is only held to take and to
+// hand back the commands, never while carrying them out
+void _muttley_commands( void ) {
+
+    int c, n = 0;
+    int batch[ _MTL_CMDQ_SZ ];
+
+    simple_lock( &_muttley_cmdq_lock );
+    for( c = 0; ( c < _MTL_CMDQ_SZ ) && _muttley_cmdq_queued; c++ ) {
+        if( _muttley_cmdq[ c ].state == mtl_cmdq_queued ) {
+            _muttley_cmdq[ c ].state = mtl_cmdq_busy;
+            _muttley_cmdq_queued--;
+            batch[ n++ ] = c;
+        }
+    }
+    simple_unlock( &_muttley_cmdq_lock );
+
+    if( !n )
+        return;
+
+    for( c = 0; c < n; c++ )
+        _muttley_command( &_muttley_cmdq[ batch[ c ] ].cmd );
+
+    _muttley_stats_begin();
+    _muttley_stats.commands += n;
+    _muttley_stats_end();
+
+    simple_lock( &_muttley_cmdq_lock );
+    for( c = 0; c < n; c++ )
+        _muttley_cmdq[ batch[ c ] ].state =
+            ( _muttley_cmdq[ batch[ c ] ].state == mtl_cmdq_abandoned ) ?
+            mtl_cmdq_free : mtl_cmdq_done;
+    e_wakeup( &_muttley_cmdq_done );
+    simple_unlock( &_muttley_cmdq_lock );
+}
+
+
+// work out the logical targets' results of a run, at 'time', from those of
+// the targets they're on, i.e. all of them must have passed (any of them for
+// mirrored ones), logical targets on nothing checked in the run (e.g. paused)
+// are left alone, returns the worst logical target's consecutive failed
+// runs and clears *run_result if one failed
+int _muttley_derive( uint64_t time, int * run_result ) {
+
+    int d, t, src, pass, before, failed_runs = 0;
+    struct muttley_derived * dv;
+    struct muttley_target_stats * ts;
+
+    bzero( (char *)_muttley_derived,
+           _muttley_conf.targets * sizeof( struct muttley_derived ) );
+
+    for( d = 0; d < _muttley_conf.deps; d++ ) {
+        src = _muttley_conf.dep[ d ].source;
+        if( _muttley_run_res[ src ] < 0 )
+            continue;
+        dv = &_muttley_derived[ _muttley_conf.dep[ d ].target ];
+        if( _muttley_run_res[ src ] )
+            dv->passed++;
+        else {
+            dv->failed++;
+            if( !dv->error )
+                dv->error = _muttley_tstats[ src ].last_error;
+        }
+        if( _muttley_tstats[ src ].last_latency > dv->latency )
+            dv->latency = _muttley_tstats[ src ].last_latency;
+    }
+
+    for( t = 0; t < _muttley_conf.targets; t++ ) {
+
+        ts = &_muttley_tstats[ t ];
+        dv = &_muttley_derived[ t ];
+        if( ( _muttley_tconf[ t ].type != mtl_target_logical ) || ts->paused ||
+            !( dv->passed + dv->failed ) )
+            continue;
+
+        pass = _muttley_tconf[ t ].mirrored ? ( dv->passed > 0 ) : !dv->failed;
+
+        _muttley_target_begin( t );
+        before = ts->failed_runs;
+        ts->runs++;
+        ts->last_time = time;
+        ts->last_latency = dv->latency;
+        ts->last_result = pass;
+        ts->last_error = pass ? 0 : dv->error;
+        if( !pass ) {
+            ts->failed_runs++;
+            ts->failed_runs_total++;
+            *run_result = 0;
+        } else
+            ts->failed_runs = 0;
+        _muttley_target_end( t );
+
+        _muttley_alert_change( t, before, ts->failed_runs );
+
+        if( ts->failed_runs > failed_runs )
+            failed_runs = ts->failed_runs;
+    }
+
+    return( failed_runs );
+}
+
+
+// write the flight recorder out to its file, this is done with the device
+// still unavailable, so the file must live on another device (the
+// controller checks that), it's opened with O_DSYNC, no sync calls needed
+void _muttley_fr_write( enum muttley_fr_reason reason ) {
+
+    long int b;
+
+    if( !_recorder_fp )
+        return;
+
+    _muttley_fr.reason = reason;
+    _muttley_fr.written = _muttley_now();
+    if( !fp_lseek( _recorder_fp, 0, SEEK_SET ) )
+        fp_write( _recorder_fp, (char *)&_muttley_fr, sizeof( _muttley_fr ),
+                  0, SYS_ADSPACE, &b );
+}
+
+
+// check a target for the current run, i.e. until it reaches the successes
+// threshold or the maximum checks, and account the run in its statistics,
+// called by the worker which moved the target to busy, which is handed back
+// along with the results
+void _muttley_check( struct muttley_worker * wk, int target,
+                     struct muttley_fr_run * run ) {
+
+    int check = 0, success = 0, before, tally = _muttley_tally;
+    int checks = _MTL_TALLY_CHECKS( tally );
+    int successes = _MTL_TALLY_SUCCESSES( tally );
+    struct muttley_target_stats * ts = &_muttley_tstats[ target ];
+
+    // do a full run of checks until we reach _muttley_conf defined success
+    // threshold or we reach the maximum checks per run (as they were when
+    // the target's checks began, they may be tuned meanwhile)
+    while( ( check < checks ) && ( success < successes ) ) {
+        success += _muttley_probe( wk, target, run );
+        check++;
+    }
+
+    // update the target's number of consecutive failed runs (the worst
+    // target decides when to execute 'behaviour')
+    _muttley_target_begin( target );
+    before = ts->failed_runs;
+    ts->runs++;
+    if( success != successes ) {
+        ts->failed_runs++;
+        ts->failed_runs_total++;
+    } else
+        ts->failed_runs = 0;
+    _muttley_target_end( target );
+
+    _muttley_alert_change( target, before, ts->failed_runs );
+
+    _muttley_run_res[ target ] = ( success == successes );
+    _muttley_sched[ target ].checks = check;
+    _muttley_sched[ target ].successes = success;
+
+    __lwsync();
+    _muttley_sched[ target ].state = mtl_sched_idle;
+}
+
+
+// a worker kernel proc, bound to a processor of its own (as far as there are
+// enough of them), checks the targets in its queue as runs are published and,
+// once it ran out of them, those left in the other workers' queues, so that
+// a target stuck in a check only holds up the worker checking it
+int _muttley_worker_kproc( int flag, void * params, int length ) {
+
+    int w = *(int *)params, t, gen, stolen, queued;
+    uint64_t start, late, wakeups = 0;
+    struct muttley_fr_run * run;
+    struct muttley_worker * wk = &_muttley_worker[ w ];
+    struct muttley_worker_stats * ws = &_muttley_stats.worker[ w ];
+
+    ws->cpu = -1;
+    if( ( _system_configuration.ncpus > 0 ) &&
+        !switch_cpu( w % _system_configuration.ncpus, SET_PROCESSOR_ID ) )
+        ws->cpu = w % _system_configuration.ncpus;
+
+    // inform everyone who wants to know that we're running
+    ws->pid = getpid();
+    ws->running = 1;
+
+    while( _muttley_cmd == mtl_cmd_start ) {
+
+        gen = _muttley_sched_gen;
+        __lwsync();
+
+        // nothing left to check anywhere, the run may be done, sleep until
+        // the next one is published (unless it was meanwhile)
+        if( ( t = shard_next( _muttley_queue, _muttley_conf.workers, w,
+                              &stolen ) ) < 0 ) {
+            simple_lock( &_muttley_sched_lock );
+            e_wakeup( &_muttley_kproc_event );
+            if( ( gen == _muttley_sched_gen ) &&
+                ( _muttley_cmd == mtl_cmd_start ) ) {
+                e_sleep_thread( &_muttley_worker_event, &_muttley_sched_lock,
+                                LOCK_SIMPLE );
+                wakeups++;
+            }
+            simple_unlock( &_muttley_sched_lock );
+            continue;
+        }
+
+        // the run may have been closed since it was taken from the queue
+        queued = mtl_sched_queued;
+        if( !compare_and_swap( &_muttley_sched[ t ].state, &queued,
+                               mtl_sched_busy ) )
+            continue;
+
+        run = _muttley_fr_run;
+        start = _muttley_now();
+        late = ( start > run->time ) ? start - run->time : 0;
+
+        _muttley_check( wk, t, run );
+
+        // wakeups are only accounted along with the next check
+        _muttley_shard_begin( w );
+        ws->checked++;
+        ws->wakeups += wakeups;
+        wakeups = 0;
+        if( stolen )
+            ws->stolen++;
+        ws->busy += _muttley_now() - start;
+        ws->lateness += late;
+        if( late > ws->lateness_max )
+            ws->lateness_max = late;
+        sketch_add( &ws->late, late );
+        _muttley_shard_end( w );
+    }
+
+    _muttley_shard_begin( w );
+    ws->wakeups += wakeups;
+    _muttley_shard_end( w );
+
+    // inform everyone who wants to know that we've terminated
+    ws->running = 0;
+    return( 0 );
+}
+
+
+// start a run, sharding its due targets across the workers' queues and
+// waking them up, paused and logical targets aren't due, nor are those
+// still being checked since an earlier run (which are skipped)
+void _muttley_run_publish( struct muttley_fr_run * run ) {
+
+    int t, w, skipped = 0;
+    int n[ MTL_WORKERS_MAX ];
+    struct muttley_sched * sc;
+
+    for( w = 0; w < _muttley_conf.workers; w++ ) {
+        shard_withdraw( &_muttley_queue[ w ] );
+        n[ w ] = 0;
+    }
+    _muttley_fr_run = run;
+
+    // only the kernel proc moves targets out of idle, no one else will
+    // while we're at it
+    for( t = 0; t < _muttley_conf.targets; t++ ) {
+
+        sc = &_muttley_sched[ t ];
+        sc->due = 0;
+        _muttley_run_res[ t ] = -1;
+        if( _muttley_tstats[ t ].paused ||
+            ( _muttley_tconf[ t ].type == mtl_target_logical ) )
+            continue;
+        if( sc->state != mtl_sched_idle ) {
+            skipped++;
+            continue;
+        }
+
+        sc->due = 1;
+        sc->checks = 0;
+        sc->successes = 0;
+        sc->state = mtl_sched_queued;
+        w = shard_owner( t, _muttley_conf.workers );
+        _muttley_queue[ w ].item[ n[ w ]++ ] = t;
+    }
+
+    for( w = 0; w < _muttley_conf.workers; w++ )
+        shard_publish( &_muttley_queue[ w ], n[ w ] );
+
+    if( skipped ) {
+        _muttley_stats_begin();
+        _muttley_stats.skipped += skipped;
+        _muttley_stats_end();
+    }
+
+    simple_lock( &_muttley_sched_lock );
+    _muttley_sched_gen++;
+    e_wakeup( &_muttley_worker_event );
+    simple_unlock( &_muttley_sched_lock );
+}
+
+
+// is every target due in the current run checked
+int _muttley_run_done( void ) {
+
+    int t;
+
+    for( t = 0; t < _muttley_conf.targets; t++ )
+        if( _muttley_sched[ t ].due &&
+            ( _muttley_sched[ t ].state != mtl_sched_idle ) )
+            return( 0 );
+
+    return( 1 );
+}
+
+
+// close the current run, withdrawing the targets no worker got to (which,
+// like those still being checked, are skipped), and account it, returns the
+// worst target's consecutive failed runs and sets *worst to it, a target
+// stuck in a check counts with the failed runs the deadline timer gave it
+int _muttley_run_close( struct muttley_fr_run * run, int * worst ) {
+
+    int t, w, queued, skipped = 0, failed_runs = 0;
+    int run_result = 1, run_successes = 0, run_failures = 0;
+    struct muttley_sched * sc;
+    struct muttley_target_stats * ts;
+
+    for( w = 0; w < _muttley_conf.workers; w++ )
+        shard_withdraw( &_muttley_queue[ w ] );
+
+    for( t = 0; t < _muttley_conf.targets; t++ ) {
+
+        sc = &_muttley_sched[ t ];
+        ts = &_muttley_tstats[ t ];
+        if( ts->paused || ( _muttley_tconf[ t ].type == mtl_target_logical ) )
+            continue;
+
+        if( sc->due ) {
+            sc->due = 0;
+            queued = mtl_sched_queued;
+            if( compare_and_swap( &sc->state, &queued, mtl_sched_idle ) ||
+                ( sc->state != mtl_sched_idle ) ) {
+                skipped++;
+                _muttley_run_res[ t ] = -1;
+            } else {
+                // the results were handed back before the target was
+                __lwsync();
+                run_successes += sc->successes;
+                run_failures += sc->checks - sc->successes;
+                if( !_muttley_run_res[ t ] )
+                    run_result = 0;
+            }
+        }
+
+        if( ts->failed_runs > failed_runs ) {
+            failed_runs = ts->failed_runs;
+            *worst = t;
+        }
+    }
+
+    if( _muttley_conf.deps ) {
+        t = _muttley_derive( run->time, &run_result );
+        if( t > failed_runs )
+            failed_runs = t;
+    }
+
+    // rewrite _muttley_stats to reflect the latest run
+    _muttley_stats_begin();
+    _muttley_stats.runs++;
+    if( !run_result )
+        _muttley_stats.failed_runs_total++;
+    _muttley_stats.last_result = run_result;
+    _muttley_stats.failed_runs = failed_runs;
+    _muttley_stats.last_time = run->time;
+    _muttley_stats.last_successes = run_successes;
+    _muttley_stats.last_failures = run_failures;
+    _muttley_stats.total_successes += run_successes;
+    _muttley_stats.total_failures += run_failures;
+    _muttley_stats.skipped += skipped;
+    _muttley_stats_end();
+
+    // complete the run's flight recorder slot
+    run->result = run_result;
+    run->successes = run_successes;
+    run->failures = run_failures;
+    run->failed_runs = failed_runs;
+    run->runs = _muttley_conf.runs;
+    _muttley_fr.runs++;
+
+    return( failed_runs );
+}
+
+
+// the kernel proc itself, it no longer checks targets for runs, the workers
+// do, nor executes commands, the command kernel proc does, it starts runs,
+// accounts them once they're done and escalates, never doing any i/o of
+// its own but writing the flight recorder out
+int _muttley( int flag, void * params, int length ) {
+
+    int failed_runs, worst = 0, alerted = 0, ipri;
+    uint64_t wakeups = 0, last_time = 0, curr_time, interval;
+    struct muttley_fr_run * run = NULL;
+
+    // inform everyone who wants to know that we're running
+    _muttley_stats.overhead.kproc_pid = getpid();
+    _muttley_stats.running = 1;
+
+    // if no one tell's us to stop, then just keep going
+    while( _muttley_cmd == mtl_cmd_start ) {
+
+        curr_time = _muttley_now();
+        interval = _muttley_run_interval();
+
+        // account the run once every target due in it was checked, or once
+        // the next one is due, whatever's left of it is then skipped
+        if( run && ( ( curr_time - last_time >= interval ) ||
+                     _muttley_run_done() ) ) {
+
+            failed_runs = _muttley_run_close( run, &worst );
+            run = NULL;
+
+            // our wakeups, mostly ticks, are accounted once per run
+            _muttley_stats_begin();
+            _muttley_stats.overhead.kproc_wakeups += wakeups;
+            _muttley_stats_end();
+            wakeups = 0;
+
+            // alert once each time the threshold is reached, and once
+            // every target recovered let the hook be escalated again
+            if( ( failed_runs >= _muttley_conf.runs ) && !alerted ) {
+                alerted = 1;
+                _muttley_fr_write( mtl_fr_reason_threshold );
+                _muttley_alert( mtl_alert_threshold, worst );
+            } else if( !failed_runs ) {
+                alerted = 0;
+                ipri = disable_lock( INTMAX, &_muttley_fence_lock );
+                if( ( _muttley_stats.fence.state == mtl_fence_done ) ||
+                    ( _muttley_stats.fence.state == mtl_fence_failed ) ) {
+                    _muttley_stats_begin();
+                    _muttley_stats.fence.state = mtl_fence_idle;
+                    _muttley_stats_end();
+                }
+                unlock_enable( ipri, &_muttley_fence_lock );
+            }
+        }
+
+        // if the interval since the previous run started has elapsed
+        if( curr_time - last_time >= interval ) {
+
+            // take the flight recorder's next slot for this run
+            run = &_muttley_fr.run[ _muttley_fr.runs % MTL_FR_RUNS ];
+            run->time = curr_time;
+            run->checks = 0;
+
+            _muttley_run_publish( run );
+            last_time = curr_time;
+        }
+
+        // if the allowable failed runs threshold is reached, then execute
+        // the configured behaviour
+
+        _muttley_escalate( worst, _muttley_stats.failed_runs );
+
+        // sleep until the next tick, or until a worker runs out of targets
+        simple_lock( &_muttley_sched_lock );
+        if( _muttley_cmd == mtl_cmd_start ) {
+            e_sleep_thread( &_muttley_kproc_event, &_muttley_sched_lock,
+                            LOCK_SIMPLE );
+            wakeups++;
+        }
+        simple_unlock( &_muttley_sched_lock );
+    }
+
+    _muttley_stats_begin();
+    _muttley_stats.overhead.kproc_wakeups += wakeups;
+    _muttley_stats_end();
+
+    _muttley_fr_write( mtl_fr_reason_stop );
+
+    // inform everyone who wants to know that we've terminated
+    _muttley_stats.running = 0;
+    return( 0 );
+}
+
+
+// the command kernel proc, sleeps until commands are queued and carries
+// them out, waiting for the targets a probe is about to be done with by
+// the workers, so that neither a probe nor a stuck target it's waiting for
+// holds up the runs
+int _muttley_commander( int flag, void * params, int length ) {
+
+    int c;
+    uint64_t wakeups = 0;
+
+    // inform everyone who wants to know that we're running
+    _muttley_stats.overhead.command_pid = getpid();
+    _muttley_stats.command_running = 1;
+
+    while( _muttley_cmd == mtl_cmd_start ) {
+
+        _muttley_commands();
+
+        simple_lock( &_muttley_cmdq_lock );
+        if( !_muttley_cmdq_queued && ( _muttley_cmd == mtl_cmd_start ) ) {
+            e_sleep_thread( &_muttley_cmdq_event, &_muttley_cmdq_lock,
+                            LOCK_SIMPLE );
+            wakeups++;
+        }
+        simple_unlock( &_muttley_cmdq_lock );
+
+        // our wakeups are few, they're accounted as they happen
+        if( wakeups ) {
+            _muttley_stats_begin();
+            _muttley_stats.overhead.command_wakeups += wakeups;
+            _muttley_stats_end();
+            wakeups = 0;
+        }
+    }
+
+    // no more commands will be taken (as we've been told to stop), cancel
+    // those still queued
+    simple_lock( &_muttley_cmdq_lock );
+    for( c = 0; c < _MTL_CMDQ_SZ; c++ ) {
+        if( _muttley_cmdq[ c ].state == mtl_cmdq_queued ) {
+            _muttley_cmdq[ c ].cmd.result = 0;
+            _muttley_cmdq[ c ].cmd.error = ECANCELED;
+            _muttley_cmdq[ c ].state = mtl_cmdq_done;
+        }
+    }
+    _muttley_cmdq_queued = 0;
+    e_wakeup( &_muttley_cmdq_done );
+    simple_unlock( &_muttley_cmdq_lock );
+
+    // inform everyone who wants to know that we've terminated
+    _muttley_stats.command_running = 0;
+    return( 0 );
+}
+
+
+// the heartbeat kernel proc, every hb_interval ms writes our own slot with a
+// new sequence number and reads back the whole region, in a single i/o, to
+// follow every peer's sequence number, it runs apart from the checks so
+// that neither a slow check delays a heartbeat nor the other way around
+int _muttley_hb( int flag, void * params, int length ) {
+
+    int n, w, r, ticks;
+    long int b;
+    uint64_t seq, start, now, interval, timeout;
+    struct hb_slot * own, * region;
+    struct muttley_hb_stats * hs = &_muttley_stats.hb;
+    struct muttley_overhead_stats * os = &_muttley_stats.overhead;
+
+    region = (struct hb_slot *)_muttley_hb_buf;
+    own = (struct hb_slot *)( _muttley_hb_buf + HB_REGION_SZ );
+    interval = (uint64_t)_muttley_conf.hb_interval * 1000000;
+    timeout = (uint64_t)_muttley_conf.hb_timeout * 1000000;
+
+    // seeded with the start time, so that peers never mistake a slot we
+    // wrote before a restart for a new heartbeat
+    seq = _muttley_now();
+
+    // inform everyone who wants to know that we're running
+    os->hb_pid = getpid();
+    hs->running = 1;
+
+    while( _muttley_cmd == mtl_cmd_start ) {
+
+        start = _muttley_now();
+
+        // write our own slot, with O_DSYNC it's on the device once done
+        hb_slot_fill( own, _muttley_conf.hb_node, ++seq, start,
+                      _muttley_conf.hb_interval );
+        if( !( w = fp_lseek( _muttley_hb_fp, _muttley_conf.hb_offset +
+                             _muttley_conf.hb_node * HB_SLOT_SZ, SEEK_SET ) ) ) {
+            w = fp_write( _muttley_hb_fp, (char *)own, HB_SLOT_SZ, 0,
+                          SYS_ADSPACE, &b );
+            if( !w && ( b != HB_SLOT_SZ ) )
+                w = EIO;
+        }
+
+        // and read every slot back at once
+        if( !( r = fp_lseek( _muttley_hb_fp, _muttley_conf.hb_offset,
+                             SEEK_SET ) ) ) {
+            r = fp_read( _muttley_hb_fp, (char *)region, HB_REGION_SZ, 0,
+                         SYS_ADSPACE, &b );
+            if( !r && ( b != HB_REGION_SZ ) )
+                r = EIO;
+        }
+
+        now = _muttley_now();
+
+        _muttley_stats_begin();
+        os->hb_wakeups++;
+        os->hb_io_calls += 4;
+        os->hb_io_bytes += ( w ? 0 : HB_SLOT_SZ ) + ( r ? 0 : HB_REGION_SZ );
+        hs->writes++;
+        if( w )
+            hs->write_errors++;
+        else
+            hs->seq = seq;
+        hs->reads++;
+        if( now - start > hs->latency_max )
+            hs->latency_max = now - start;
+        hs->last_time = now;
+        // when we can't read the region we know nothing new about our peers,
+        // which isn't a reason to find them stalled
+        if( r )
+            hs->read_errors++;
+        else {
+            hs->alive = 0;
+            hs->stalled = 0;
+            for( n = 0; n < HB_SLOTS; n++ ) {
+                if( n == _muttley_conf.hb_node )
+                    continue;
+                hb_peer_update( &hs->peer[ n ], &region[ n ], n, now, timeout );
+                if( hs->peer[ n ].state == hb_state_alive )
+                    hs->alive++;
+                else if( hs->peer[ n ].state == hb_state_stalled )
+                    hs->stalled++;
+            }
+        }
+        _muttley_stats_end();
+
+        // sleep until the next heartbeat is due, right away if we're late
+        now = _muttley_now();
+        if( start + interval > now ) {
+            ticks = ( ( start + interval - now ) * HZ + 999999999 ) /
+                1000000000;
+            delay( ticks );
+        }
+    }
+
+    // inform everyone who wants to know that we've terminated
+    hs->running = 0;
+    return( 0 );
+}
+
+
+// emit an alert message to a sink, unless that would go over its rate limit,
+// 'alerts' is the number of alerts coalesced into it and 'oldest' the
+// detection time of the oldest of them
+void _muttley_alert_emit( int sink, char * msg, int alerts, uint64_t oldest ) {
+
+    int r = 0;
+    long int b;
+    char line[ _MTL_ALERT_MSG_SZ + 32 ];
+    uint64_t now, cost = _MTL_ALERT_CREDIT / _muttley_conf.alert_rate;
+    struct muttley_sink_stats * ss = &_muttley_stats.alert.sink[ sink ];
+
+    if( _muttley_alert_credit[ sink ] < cost ) {
+        _muttley_stats_begin();
+        ss->limited++;
+        _muttley_stats_end();
+        return;
+    }
+    _muttley_alert_credit[ sink ] -= cost;
+
+    switch( sink ) {
+        case mtl_sink_console:
+            sprintf( line, "\n\r%s\n\r", msg );
+            r = fp_write( _console_fp, line, strlen( line ), 0, SYS_ADSPACE,
+                          &b );
+            break;
+        case mtl_sink_syslog:
+            bsdlog( LOG_KERN | LOG_ALERT, "%s\n", msg );
+            break;
+        case mtl_sink_file:
+            sprintf( line, "%lu %s\n",
+                     (unsigned long)( oldest / 1000000000 ), msg );
+            r = fp_write( _muttley_alert_fp, line, strlen( line ), 0,
+                          SYS_ADSPACE, &b );
+            break;
+    }
+
+    now = _muttley_now();
+    _muttley_stats_begin();
+    if( r )
+        ss->errors++;
+    else {
+        ss->messages++;
+        ss->alerts += alerts;
+        ss->latency += now - oldest;
+        if( now - oldest > ss->latency_max )
+            ss->latency_max = now - oldest;
+        if( now - oldest > _muttley_stats.alert.latency_max )
+            _muttley_stats.alert.latency_max = now - oldest;
+    }
+    _muttley_stats_end();
+}
+
+
+// coalesce the alerts of a kind in the n alerts of the batch into a single
+// message, naming up to MTL_ALERT_NAMED targets, returns the number of them
+// (0 for none) and the detection time of the oldest in *oldest
+int _muttley_alert_coalesce( int type, int n, char * msg, uint64_t * oldest ) {
 
-// private data block where the 'run time' parameters are copied to for use by
-// the kernel process
-struct muttley_conf _muttley_conf;
+    int i, alerts = 0;
+    char names[ MTL_ALERT_NAMED * 12 + 32 ];
+    char * p = names;
+    struct muttley_alert * a;
 
-// running info (see _mtl_query_* constants in .h file)
-int _muttley_info[ mtl_query_sz ];
+    *p = '\0';
+    for( i = 0; i < n; i++ ) {
+        a = &_muttley_alert_batch[ i ];
+        if( a->type != type )
+            continue;
+        if( !alerts || ( a->time < *oldest ) )
+            *oldest = a->time;
+        if( alerts++ < MTL_ALERT_NAMED )
+            p += sprintf( p, " %d", a->target );
+    }
+    if( alerts > MTL_ALERT_NAMED )
+        sprintf( p, " and %d more", alerts - MTL_ALERT_NAMED );
 
-// used to write to the console when a threshold occurs
-struct file * _console_fp;
+    switch( type ) {
+        case mtl_alert_failing:
+            sprintf( msg, "muttley: %d target(s) failing:%s", alerts, names );
+            break;
+        case mtl_alert_recovered:
+            sprintf( msg, "muttley: %d target(s) recovered:%s", alerts,
+                     names );
+            break;
+        default:
+            sprintf( msg, "muttley: bark, bark! failed runs threshold "
+                     "reached, by target(s)%s", names );
+            break;
+    }
 
-// the string we send to errpt and to the console
-const char * _panic_str = _MTL_PANIC_STR;
+    return( alerts );
+}
 
 
-// perform one monitoring test, i.e. tries to open, read and close the device,
-// usually /dev/rhd4 which contains the / filesystem
-enum muttley_watch_res _muttley_watch( char * dev_path ) {
+// the alert kernel proc, sleeps until an alert is raised, gathers those
+// raised along with it for alert_coalesce ms and emits a message for each
+// kind of them to every sink, so that a mass failure neither floods the
+// sinks nor holds up the checks, which only queue alerts
+int _muttley_alerter( int flag, void * params, int length ) {
 
-    int r;
-    long int b;
-    struct file * dev_fp;
-    char buf[ _MTL_READ_BUF_SZ ];
+    int n, type, sink, ipri, alerts;
+    uint64_t now, oldest, wakeups = 0;
+    char msg[ _MTL_ALERT_MSG_SZ ];
+    struct muttley_alert_stats * as = &_muttley_stats.alert;
 
-    // open the device for reading, return on failure
-    if( fp_open( dev_path, O_RDONLY, 0, 0, SYS_ADSPACE, &dev_fp ) )
-        return( 0 );
+    // inform everyone who wants to know that we're running
+    _muttley_stats.overhead.alert_pid = getpid();
+    as->running = 1;
 
-    // read _MTL_READ_BUF_SZ bytes into 'buf'
-    r = fp_read( dev_fp, (char *)buf, _MTL_READ_BUF_SZ, 0, SYS_ADSPACE, &b );
+    for( ;; ) {
 
-    fp_close( dev_fp );
+        ipri = disable_lock( INTMAX, &_muttley_alert_lock );
+        if( !_muttley_alert_queued && ( _muttley_cmd == mtl_cmd_start ) ) {
+            e_sleep_thread( &_muttley_alert_event, &_muttley_alert_lock,
+                            LOCK_HANDLER );
+            wakeups++;
+        }
+        n = _muttley_alert_queued;
+        unlock_enable( ipri, &_muttley_alert_lock );
+
+        // once told to stop, whatever's queued is still emitted
+        if( !n ) {
+            if( _muttley_cmd != mtl_cmd_start )
+                break;
+            continue;
+        }
+
+        // let the alerts raised along with the first one come in
+        if( _muttley_conf.alert_coalesce && ( _muttley_cmd == mtl_cmd_start ) )
+            delay( ( _muttley_conf.alert_coalesce * HZ + 999 ) / 1000 );
+
+        // and take every alert queued at once
+        ipri = disable_lock( INTMAX, &_muttley_alert_lock );
+        for( n = 0; n < _muttley_alert_queued; n++ )
+            _muttley_alert_batch[ n ] = _muttley_alert_queue[
+                ( _muttley_alert_head + n ) % MTL_ALERT_QUEUE_SZ ];
+        _muttley_alert_head = ( _muttley_alert_head + n ) % MTL_ALERT_QUEUE_SZ;
+        _muttley_alert_queued = 0;
+        unlock_enable( ipri, &_muttley_alert_lock );
+
+        // refill the sinks' credit for the time gone by
+        now = _muttley_now();
+        for( sink = 0; sink < mtl_sink_sz; sink++ ) {
+            _muttley_alert_credit[ sink ] += now - _muttley_alert_refill;
+            if( _muttley_alert_credit[ sink ] > _MTL_ALERT_CREDIT )
+                _muttley_alert_credit[ sink ] = _MTL_ALERT_CREDIT;
+        }
+        _muttley_alert_refill = now;
+
+        for( type = 0; type < mtl_alert_sz; type++ ) {
+            if( !( alerts = _muttley_alert_coalesce( type, n, msg, &oldest ) ) )
+                continue;
+            if( _console_fp )
+                _muttley_alert_emit( mtl_sink_console, msg, alerts, oldest );
+            _muttley_alert_emit( mtl_sink_syslog, msg, alerts, oldest );
+            if( _muttley_alert_fp )
+                _muttley_alert_emit( mtl_sink_file, msg, alerts, oldest );
+        }
 
-    // return _mtl_watch_res_success if fp_read returned success and the
-    // number of bytes requested matches the number of bytes read
-    r = ( !r ) && ( b == _MTL_READ_BUF_SZ );
-    return( r ? mtl_watch_res_success : mtl_watch_res_failure );
+        _muttley_stats_begin();
+        as->batches++;
+        as->queued = 0;
+        _muttley_stats.overhead.alert_wakeups += wakeups;
+        _muttley_stats_end();
+        wakeups = 0;
+    }
+
+    _muttley_stats_begin();
+    _muttley_stats.overhead.alert_wakeups += wakeups;
+    _muttley_stats_end();
+
+    // inform everyone who wants to know that we've terminated
+    as->running = 0;
+    return( 0 );
 }
 
 
-// the kernel proc itself,
-int _muttley( int flag, void * params, int length ) {
+// is any kernel proc still running, or any muttley_command or muttley_fence
+// caller still in
+int _muttley_busy( void ) {
 
-    int check, success;
-    struct timestruc_t last_time, curr_time;
-    long int b;
+    int w;
 
-    // inform everyone who wants to know that we're running
-    _muttley_info[ mtl_query_running ] = 1;
+    if( _muttley_stats.running || _muttley_stats.hb.running ||
+        _muttley_stats.alert.running || _muttley_stats.command_running ||
+        _muttley_cmdq_waiters || _muttley_fence_waiters || _muttley_callers )
+        return( 1 );
+    for( w = 0; w < MTL_WORKERS_MAX; w++ )
+        if( _muttley_stats.worker[ w ].running )
+            return( 1 );
 
-    last_time.tv_sec = 0;
-    last_time.tv_nsec = 0;
+    return( 0 );
+}
 
-    // if no one tell's us to stop, then just keep going
-    while( _muttley_cmd == mtl_cmd_start ) {
 
-        curtime( &curr_time );
+// allocate len bytes from the pinned heap, zeroed, returns NULL on failure
+void * _muttley_zalloc( long len ) {
 
-        // if the interval since the previous check has elapsed
-        if( curr_time.tv_sec - last_time.tv_sec >= _muttley_conf.interval ) {
+    void * p;
 
-            check = 0;
-            success = 0;
-            // do a full run of checks until we reach _muttley_conf defined
-            // success threshold or we reach the maximum checks per run
-            while( ( check < _muttley_conf.checks ) &&
-                   ( success < _muttley_conf.successes ) ) {
-                success += _muttley_watch( _muttley_conf.device );
-                check++;
-            }
+    if( ( p = xmalloc( len, 3, pinned_heap ) ) )
+        bzero( (char *)p, len );
+    return( p );
+}
 
-            // rewrite _muttley_info to reflect the latest run
-            // update the number of consecutive failed runs (needed to decide
-            // when to execute 'behaviour')
-            if( success != _muttley_conf.successes ) {
-                _muttley_info[ mtl_query_last_result ] = 0;
-                _muttley_info[ mtl_query_failed_runs ]++;
-            } else {
-                _muttley_info[ mtl_query_last_result ] = 1;
-                _muttley_info[ mtl_query_failed_runs ] = 0;
-            }
 
-            _muttley_info[ mtl_query_last_time ] = curr_time.tv_sec;
-            _muttley_info[ mtl_query_last_successes ] = success;
-            _muttley_info[ mtl_query_last_failures ] = check - success;
-            _muttley_info[ mtl_query_total_successes ] += success;
-            _muttley_info[ mtl_query_total_failures ] += check - success;
+// free what *p points to, if anything, back to the pinned heap
+void _muttley_free( void ** p ) {
 
-            last_time = curr_time;
+    if( *p ) {
+        xmfree( (char *)*p, pinned_heap );
+        *p = NULL;
+    }
+}
 
-            if( _console_fp &&
-                ( _muttley_info[ mtl_query_failed_runs ] == _muttley_conf.runs ) )
-                fp_write( _console_fp, (char *)_panic_str, strlen( _panic_str ), 0,
-                          SYS_ADSPACE, &b );
 
+// release everything acquired when starting, i.e. in _muttley_ctrl( CFG_INIT )
+void _muttley_release( void ) {
+
+    int t, w;
+
+    // keep muttley_snapshot and muttley_rollup callers off the per-target
+    // tables from now on, and wait for those reading them to be done, as
+    // well as for muttley_command and muttley_fence callers which may have
+    // seen monitoring running, and be about to take its locks
+    _muttley_stats.targets = 0;
+    __sync();
+    while( _muttley_readers || _muttley_callers )
+        delay( 1 );
+
+    if( _console_fp ) {
+        fp_close( _console_fp );
+        _console_fp = NULL;
+    }
+    if( _recorder_fp ) {
+        fp_close( _recorder_fp );
+        _recorder_fp = NULL;
+    }
+    if( _muttley_alert_fp ) {
+        fp_close( _muttley_alert_fp );
+        _muttley_alert_fp = NULL;
+    }
+    for( t = 0; _muttley_dir_fp && ( t < _muttley_conf.targets ); t++ )
+        if( _muttley_dir_fp[ t ] )
+            fp_close( _muttley_dir_fp[ t ] );
+    for( t = 0; _muttley_held && ( t < _muttley_conf.targets ); t++ )
+        if( _muttley_held[ t ].fp )
+            fp_close( _muttley_held[ t ].fp );
+    for( w = 0; w <= MTL_WORKERS_MAX; w++ ) {
+        if( _muttley_worker[ w ].deadline_trb ) {
+            while( tstop( _muttley_worker[ w ].deadline_trb ) )
+                ;
+            tfree( _muttley_worker[ w ].deadline_trb );
+            _muttley_worker[ w ].deadline_trb = NULL;
         }
+        if( _muttley_worker[ w ].scratch ) {
+            xmfree( _muttley_worker[ w ].scratch, pinned_heap );
+            _muttley_worker[ w ].scratch = NULL;
+        }
+    }
+    if( _muttley_tick_trb ) {
+        while( tstop( _muttley_tick_trb ) )
+            ;
+        tfree( _muttley_tick_trb );
+        _muttley_tick_trb = NULL;
+    }
+    if( _muttley_cmdq_lock_allocated ) {
+        lock_free( &_muttley_cmdq_lock );
+        _muttley_cmdq_lock_allocated = 0;
+    }
+    if( _muttley_fence_trb ) {
+        while( tstop( _muttley_fence_trb ) )
+            ;
+        tfree( _muttley_fence_trb );
+        _muttley_fence_trb = NULL;
+    }
+    if( _muttley_fence_lock_allocated ) {
+        lock_free( &_muttley_fence_lock );
+        _muttley_fence_lock_allocated = 0;
+    }
+    if( _muttley_sched_lock_allocated ) {
+        lock_free( &_muttley_sched_lock );
+        _muttley_sched_lock_allocated = 0;
+    }
+    if( _muttley_alert_lock_allocated ) {
+        lock_free( &_muttley_alert_lock );
+        _muttley_alert_lock_allocated = 0;
+    }
+    if( _muttley_hb_fp ) {
+        fp_close( _muttley_hb_fp );
+        _muttley_hb_fp = NULL;
+    }
+    if( _muttley_hb_buf ) {
+        xmfree( _muttley_hb_buf, pinned_heap );
+        _muttley_hb_buf = NULL;
+    }
+    if( _muttley_stats_lock_allocated ) {
+        lock_free( &_muttley_stats_lock );
+        _muttley_stats_lock_allocated = 0;
+    }
+    for( w = 0; w < _muttley_shard_locks; w++ )
+        lock_free( &_muttley_shard_lock[ w ] );
+    _muttley_shard_locks = 0;
 
-        // if the allowable failed runs threshold is reached, then execute
-        // the configured behaviour
+    // and the per-target tables, once no timer may touch them anymore
+    _muttley_free( (void **)&_muttley_dir_fp );
+    _muttley_free( (void **)&_muttley_held );
+    _muttley_free( (void **)&_muttley_rollups );
+    _muttley_free( (void **)&_muttley_tstats );
+    _muttley_free( (void **)&_muttley_target_gen );
+    _muttley_free( (void **)&_muttley_run_res );
+    _muttley_free( (void **)&_muttley_derived );
+    _muttley_free( (void **)&_muttley_sched );
+    _muttley_free( (void **)&_muttley_queue );
+    _muttley_free( (void **)&_muttley_tconf );
+    _muttley_free( (void **)&_muttley_paths );
+}
 
-        if( ( _muttley_conf.behaviour == mtl_behaviour_panic ) &&
-            ( _muttley_info[ mtl_query_failed_runs ] >= _muttley_conf.runs ) )
-            panic( _panic_str );
 
-        delay( HZ / 4 );
+// tell the kernel procs to stop, and wake them up to notice, along with the
+// hook daemons, then wait for them to stop, and for muttley_command and
+// muttley_fence callers to return, for _MTL_KPROC_TIMEOUT seconds, returns
+// true if anything's still busy
+int _muttley_stop( void ) {
+
+    int i = 0, ipri;
+
+    // tell the kernel proc to stop, and wake it up to notice, along with the
+    // workers, the command kernel proc, the hook daemons and the alert
+    // kernel proc
+    _muttley_cmd = mtl_cmd_stop;
+    if( _muttley_sched_lock_allocated ) {
+        simple_lock( &_muttley_sched_lock );
+        e_wakeup( &_muttley_kproc_event );
+        e_wakeup( &_muttley_worker_event );
+        simple_unlock( &_muttley_sched_lock );
+    }
+    if( _muttley_cmdq_lock_allocated ) {
+        simple_lock( &_muttley_cmdq_lock );
+        e_wakeup( &_muttley_cmdq_event );
+        simple_unlock( &_muttley_cmdq_lock );
+    }
+    if( _muttley_fence_lock_allocated ) {
+        ipri = disable_lock( INTMAX, &_muttley_fence_lock );
+        e_wakeup( &_muttley_fence_event );
+        unlock_enable( ipri, &_muttley_fence_lock );
+    }
+    if( _muttley_alert_lock_allocated ) {
+        ipri = disable_lock( INTMAX, &_muttley_alert_lock );
+        e_wakeup( &_muttley_alert_event );
+        unlock_enable( ipri, &_muttley_alert_lock );
+    }
+
+    // and wait for them
+    while( _muttley_busy() && ( i < _MTL_KPROC_TIMEOUT ) ) {
+        delay( HZ );
+        i++;
+    }
+
+    return( _muttley_busy() );
+}
+
+
+// create and start a kernel proc on func, marked running beforehand so that
+// it's waited for when told to stop even if it didn't get to run yet (it
+// clears the mark once it's done), returns 0 on success or (-1)
+int _muttley_kproc_start( int * running, int ( *func )( int, void *, int ),
+                          void * params, int length, char * name ) {
+
+    pid_t kpid;
+
+    *running = 1;
+    if( ( ( kpid = creatp() ) == -1 ) ||
+        ( initp( kpid, func, params, length, name ) != 0 ) ) {
+        *running = 0;
+        return( -1 );
     }
 
-    // inform everyone who wants to know that we've terminated
-    _muttley_info[ mtl_query_running ] = 0;
     return( 0 );
 }
 
@@ -181,7 +2298,7 @@ int _muttley( int flag, void * params, int length ) {
 int _muttley_ctrl( int cmd, struct uio * uiop ) {
 
     int i = 0, r = 0;
-    pid_t kpid;
+    long len;
     char name[ _MTL_KPROC_NAME_SZ ];
 
 
@@ -195,44 +2312,375 @@ int _muttley_ctrl( int cmd, struct uio * uiop ) {
                          &_console_fp ) )
                 _console_fp = NULL;                 // not used if it's NULL
 
-            // clean up info buffer
-            for( i = 0; i < mtl_query_sz; i++ ) {
-                _muttley_info[ i ] = 0;
+            // get parameters from userland buffer into kernel memory, the
+            // configuration is followed by its targets' and their paths
+            len = uiop->uio_resid;
+            bzero( (char *)&_muttley_conf, sizeof( _muttley_conf ) );
+            if( ( len < sizeof( _muttley_conf ) ) ||
+                uiomove( (char *)&_muttley_conf, sizeof( _muttley_conf ),
+                         UIO_WRITE, uiop ) ||
+                ( _muttley_conf.targets < 1 ) ||
+                ( _muttley_conf.targets > MTL_TARGETS_MAX ) ||
+                ( _muttley_conf.workers < 1 ) ||
+                ( _muttley_conf.workers > MTL_WORKERS_MAX ) ||
+                ( _muttley_conf.checks < 1 ) ||
+                ( _muttley_conf.checks > MTL_CHECKS_MAX ) ||
+                ( _muttley_conf.successes < 1 ) ||
+                ( _muttley_conf.successes > _muttley_conf.checks ) ||
+                ( _muttley_conf.full_every < 1 ) ||
+                ( _muttley_conf.query_ms < 0 ) ||
+                ( _muttley_conf.query_ms &&
+                  ( _muttley_conf.query_ms < MTL_QUERY_MS_MIN ) ) ||
+                ( _muttley_conf.paths_sz < 1 ) ||
+                ( _muttley_conf.paths_sz > MTL_PATHS_SZ ) ||
+                ( len != MTL_CONF_LEN( &_muttley_conf ) ) ) {
+                _muttley_release();
+                unpincode( _muttley_ctrl );
+                return( EINVAL );
+            }
+
+            // allocate the per-target tables, zeroed, for the targets given
+            // only (and the workers' queues for the workers given), what
+            // they take a target is MTL_TARGET_KMEM in .h file
+            _muttley_tconf = _muttley_zalloc( _muttley_conf.targets *
+                                              sizeof( *_muttley_tconf ) );
+            _muttley_paths = _muttley_zalloc( _muttley_conf.paths_sz );
+            _muttley_tstats = _muttley_zalloc( _muttley_conf.targets *
+                                               sizeof( *_muttley_tstats ) );
+            _muttley_target_gen = _muttley_zalloc(
+                _muttley_conf.targets * sizeof( *_muttley_target_gen ) );
+            _muttley_dir_fp = _muttley_zalloc( _muttley_conf.targets *
+                                               sizeof( *_muttley_dir_fp ) );
+            _muttley_held = _muttley_zalloc( _muttley_conf.targets *
+                                             sizeof( *_muttley_held ) );
+            _muttley_run_res = _muttley_zalloc( _muttley_conf.targets *
+                                                sizeof( *_muttley_run_res ) );
+            _muttley_derived = _muttley_zalloc( _muttley_conf.targets *
+                                                sizeof( *_muttley_derived ) );
+            _muttley_sched = _muttley_zalloc( _muttley_conf.targets *
+                                              sizeof( *_muttley_sched ) );
+            _muttley_queue = _muttley_zalloc( _muttley_conf.workers *
+                                              sizeof( *_muttley_queue ) );
+            if( !_muttley_tconf || !_muttley_paths || !_muttley_tstats ||
+                !_muttley_target_gen || !_muttley_dir_fp || !_muttley_held ||
+                !_muttley_run_res || !_muttley_derived || !_muttley_sched ||
+                !_muttley_queue ) {
+                _muttley_release();
+                unpincode( _muttley_ctrl );
+                return( ENOMEM );
+            }
+
+            // and copy the targets' parameters and paths in, the last path
+            // being NUL terminated
+            if( uiomove( (char *)_muttley_tconf, _muttley_conf.targets *
+                         sizeof( *_muttley_tconf ), UIO_WRITE, uiop ) ||
+                uiomove( _muttley_paths, _muttley_conf.paths_sz, UIO_WRITE,
+                         uiop ) ||
+                _muttley_paths[ _muttley_conf.paths_sz - 1 ] ) {
+                _muttley_release();
+                unpincode( _muttley_ctrl );
+                return( EINVAL );
+            }
+
+            // the statistics' locks, every update takes one of them
+            lock_alloc( &_muttley_stats_lock, LOCK_ALLOC_PIN, 0, -1 );
+            simple_lock_init( &_muttley_stats_lock );
+            _muttley_stats_lock_allocated = 1;
+            for( i = 0; i < _muttley_conf.workers; i++ ) {
+                lock_alloc( &_muttley_shard_lock[ i ], LOCK_ALLOC_PIN, 0, -1 );
+                simple_lock_init( &_muttley_shard_lock[ i ] );
+                _muttley_shard_gen[ i ] = 0;
             }
+            _muttley_shard_locks = _muttley_conf.workers;
 
-            // get parameters from userland buffer into kernel memory
-            uiomove( (char *)&_muttley_conf, sizeof( _muttley_conf ),
-                     UIO_WRITE, uiop );
+            // logical targets may only be on targets which are checked
+            if( ( _muttley_conf.deps < 0 ) ||
+                ( _muttley_conf.deps > MTL_DEPS_MAX ) )
+                r = EINVAL;
+            for( i = 0; !r && ( i < _muttley_conf.deps ); i++ ) {
+                if( ( _muttley_conf.dep[ i ].target < 0 ) ||
+                    ( _muttley_conf.dep[ i ].target >= _muttley_conf.targets ) ||
+                    ( _muttley_conf.dep[ i ].source < 0 ) ||
+                    ( _muttley_conf.dep[ i ].source >= _muttley_conf.targets ) ||
+                    ( _muttley_tconf[ _muttley_conf.dep[ i ].target ].type !=
+                      mtl_target_logical ) ||
+                    ( _muttley_tconf[ _muttley_conf.dep[ i ].source ].type ==
+                      mtl_target_logical ) )
+                    r = EINVAL;
+            }
+            // and baselines can't take deadlines away, nor paths be outside
+            // of the arena (its last one is NUL terminated)
+            for( i = 0; !r && ( i < _muttley_conf.targets ); i++ )
+                if( ( _muttley_tconf[ i ].limit < 0 ) ||
+                    ( _muttley_tconf[ i ].query_limit < 0 ) ||
+                    ( _muttley_tconf[ i ].path < 0 ) ||
+                    ( _muttley_tconf[ i ].path >= _muttley_conf.paths_sz ) )
+                    r = EINVAL;
+            if( r ) {
+                _muttley_release();
+                unpincode( _muttley_ctrl );
+                return( r );
+            }
+
+            // hold the directories of canary targets open
+            for( i = 0; i < _muttley_conf.targets; i++ ) {
+                if( ( _muttley_tconf[ i ].type == mtl_target_canary ) &&
+                    ( r = fp_open( _MTL_PATH( i ), O_RDONLY,
+                                   0, 0, SYS_ADSPACE,
+                                   &_muttley_dir_fp[ i ] ) ) ) {
+                    _muttley_dir_fp[ i ] = NULL;
+                    _muttley_release();
+                    unpincode( _muttley_ctrl );
+                    return( r );
+                }
+            }
+
+            // hold the devices of read targets open when checks are tiered,
+            // those which don't open are only read until they do
+            for( i = 0; i < _muttley_conf.targets; i++ )
+                if( ( _muttley_conf.full_every > 1 ) &&
+                    ( _muttley_tconf[ i ].type == mtl_target_read ) )
+                    _muttley_hold( i );
+
+            // set up what the workers (and the command kernel proc)
+            // check targets with, i.e. a scratch block buffer, page aligned,
+            // and a deadline timer, only armed while a step with a deadline
+            // is in progress
+            for( i = 0; i <= MTL_WORKERS_MAX; i++ ) {
+                if( ( i < _muttley_conf.workers ) ||
+                    ( i == _MTL_COMMAND_CTX ) ) {
+                    _muttley_worker[ i ].id = i;
+                    _muttley_worker[ i ].scratch = (char *)xmalloc(
+                        MTL_SCRATCH_SZ, 12, pinned_heap );
+                    if( !_muttley_worker[ i ].scratch ||
+                        !( _muttley_worker[ i ].deadline_trb = talloc() ) ) {
+                        _muttley_release();
+                        unpincode( _muttley_ctrl );
+                        return( ENOMEM );
+                    }
+                    _muttley_worker[ i ].deadline_trb->flags = 0;
+                    _muttley_worker[ i ].deadline_trb->func = _muttley_deadline;
+                    _muttley_worker[ i ].deadline_trb->func_data = i;
+                    _muttley_worker[ i ].deadline_trb->ipri = INTTIMER;
+                }
+            }
+            _muttley_write_seq = _muttley_now();
+
+            // hold the heartbeat device open, and allocate its buffer (the
+            // region followed by our own slot), page aligned
+            if( _muttley_conf.hb_device[ 0 ] ) {
+                if( ( _muttley_conf.hb_node < 0 ) ||
+                    ( _muttley_conf.hb_node >= HB_SLOTS ) ||
+                    ( _muttley_conf.hb_interval < 1 ) ||
+                    ( _muttley_conf.hb_timeout < 1 ) ) {
+                    _muttley_release();
+                    unpincode( _muttley_ctrl );
+                    return( EINVAL );
+                }
+                if( ( r = fp_open( _muttley_conf.hb_device, O_RDWR | O_DSYNC |
+                                   ( _muttley_conf.hb_direct ? O_DIRECT : 0 ),
+                                   0, 0, SYS_ADSPACE, &_muttley_hb_fp ) ) ) {
+                    _muttley_hb_fp = NULL;
+                    _muttley_release();
+                    unpincode( _muttley_ctrl );
+                    return( r );
+                }
+                _muttley_hb_buf = (char *)xmalloc( HB_REGION_SZ + HB_SLOT_SZ,
+                                                   12, pinned_heap );
+                if( !_muttley_hb_buf ) {
+                    _muttley_release();
+                    unpincode( _muttley_ctrl );
+                    return( ENOMEM );
+                }
+            }
+
+            // set up the tick timer, started along with the kernel proc,
+            // ticking at least twice between runs
+            _muttley_tick_ms = _MTL_TICK_MS;
+            if( _muttley_conf.query_ms &&
+                ( _muttley_conf.query_ms / 2 < _muttley_tick_ms ) )
+                _muttley_tick_ms = _muttley_conf.query_ms / 2;
+            if( ( _muttley_tick_trb = talloc() ) == NULL ) {
+                _muttley_release();
+                unpincode( _muttley_ctrl );
+                return( ENOMEM );
+            }
+            _muttley_tick_trb->flags = 0;              // relative timeout
+            _muttley_tick_trb->func = _muttley_tick;
+            _muttley_tick_trb->func_data = 0;
+            _muttley_tick_trb->ipri = INTTIMER;
+            _muttley_tick_trb->timeout.it_value.tv_sec = 0;
+            _muttley_tick_trb->timeout.it_value.tv_nsec =
+                _muttley_tick_ms * 1000000;
+
+            // and the command queue, empty
+            lock_alloc( &_muttley_cmdq_lock, LOCK_ALLOC_PIN, 0, -1 );
+            simple_lock_init( &_muttley_cmdq_lock );
+            _muttley_cmdq_lock_allocated = 1;
+            bzero( (char *)_muttley_cmdq, sizeof( _muttley_cmdq ) );
+            _muttley_cmdq_queued = 0;
+            _muttley_cmdq_waiters = 0;
+
+            // and the workers' queues, empty (as allocated), with every
+            // target idle
+            lock_alloc( &_muttley_sched_lock, LOCK_ALLOC_PIN, 0, -1 );
+            simple_lock_init( &_muttley_sched_lock );
+            _muttley_sched_lock_allocated = 1;
+            _muttley_sched_gen = 0;
+
+            // and the fencing hook's deadline timer and lock, only armed
+            // when the hook is triggered
+            if( ( _muttley_conf.behaviour < 0 ) ||
+                ( _muttley_conf.behaviour >= mtl_behaviour_sz ) ||
+                ( _muttley_conf.hook_timeout < 0 ) ) {
+                _muttley_release();
+                unpincode( _muttley_ctrl );
+                return( EINVAL );
+            }
+            if( ( _muttley_fence_trb = talloc() ) == NULL ) {
+                _muttley_release();
+                unpincode( _muttley_ctrl );
+                return( ENOMEM );
+            }
+            _muttley_fence_trb->flags = 0;             // relative timeout
+            _muttley_fence_trb->func = _muttley_fence_expired;
+            _muttley_fence_trb->func_data = 0;
+            _muttley_fence_trb->ipri = INTTIMER;
+            lock_alloc( &_muttley_fence_lock, LOCK_ALLOC_PIN, 0, -1 );
+            simple_lock_init( &_muttley_fence_lock );
+            _muttley_fence_lock_allocated = 1;
+            _muttley_fence_waiters = 0;
+
+            // and the alert queue, empty, every sink with a minute's worth
+            // of credit, and the alert file (if any) held open
+            if( ( _muttley_conf.alert_rate < 1 ) ||
+                ( _muttley_conf.alert_coalesce < 0 ) ) {
+                _muttley_release();
+                unpincode( _muttley_ctrl );
+                return( EINVAL );
+            }
+            if( _muttley_conf.alert_file[ 0 ] &&
+                ( r = fp_open( _muttley_conf.alert_file, O_WRONLY | O_CREAT |
+                               O_APPEND, 0600, 0, SYS_ADSPACE,
+                               &_muttley_alert_fp ) ) ) {
+                _muttley_alert_fp = NULL;
+                _muttley_release();
+                unpincode( _muttley_ctrl );
+                return( r );
+            }
+            lock_alloc( &_muttley_alert_lock, LOCK_ALLOC_PIN, 0, -1 );
+            simple_lock_init( &_muttley_alert_lock );
+            _muttley_alert_lock_allocated = 1;
+            _muttley_alert_head = 0;
+            _muttley_alert_queued = 0;
+            for( i = 0; i < mtl_sink_sz; i++ )
+                _muttley_alert_credit[ i ] = _MTL_ALERT_CREDIT;
+            _muttley_alert_refill = _muttley_now();
+
+            // allocate the rollup windows, zeroed so that no slot holds a
+            // period yet
+            _muttley_rollups = _muttley_zalloc(
+                _muttley_conf.targets * sizeof( struct muttley_rollups ) );
+            if( !_muttley_rollups ) {
+                _muttley_release();
+                unpincode( _muttley_ctrl );
+                return( ENOMEM );
+            }
+
+            // clean up statistics
+            _muttley_stats_begin();
+            bzero( (char *)&_muttley_stats, sizeof( _muttley_stats ) );
+            _muttley_stats.version = MTL_STATS_VERSION;
+            _muttley_stats.size = sizeof( _muttley_stats ) +
+                _muttley_conf.targets * sizeof( struct muttley_target_stats );
+            _muttley_stats.start = _muttley_now();
+            _muttley_stats.targets = _muttley_conf.targets;
+            _muttley_stats.workers = _muttley_conf.workers;
+            for( i = 0; i < MTL_WORKERS_MAX; i++ )
+                _muttley_stats.worker[ i ].cpu = -1;
+            for( i = 0; i < _muttley_conf.targets; i++ ) {
+                _muttley_tstats[ i ].stalled_step = -1;
+                _muttley_tstats[ i ].type = _muttley_tconf[ i ].type;
+            }
+            _muttley_stats.hb.node = _muttley_hb_fp ?
+                _muttley_conf.hb_node : -1;
+            _muttley_stats.hb.interval = _muttley_conf.hb_interval;
+            _muttley_stats.hb.timeout = _muttley_conf.hb_timeout;
+            _muttley_stats.fence.timeout = _muttley_conf.hook_timeout;
+            _muttley_stats.fence.target = -1;
+            _muttley_stats.alert.rate = _muttley_conf.alert_rate;
+            _muttley_stats.alert.coalesce = _muttley_conf.alert_coalesce;
+            _muttley_stats_end();
+            // and restart the trace sequence
+            _muttley_trace_head = 0;
+
+            // set up the flight recorder, the file was preallocated by the
+            // controller so writing it out won't need to allocate blocks
+            bzero( (char *)&_muttley_fr, sizeof( _muttley_fr ) );
+            _muttley_fr.magic = MTL_FR_MAGIC;
+            _muttley_fr.version = MTL_FR_VERSION;
+            _muttley_fr.start = _muttley_now();
+            _muttley_fr.behaviour = _muttley_conf.behaviour;
+            _muttley_fr.checks = _muttley_conf.checks;
+            _muttley_fr.successes = _muttley_conf.successes;
+            _muttley_fr.interval = _muttley_conf.interval;
+            _muttley_tally = _MTL_TALLY( _muttley_conf.checks,
+                                         _muttley_conf.successes );
+            _muttley_fr.query_ms = _muttley_conf.query_ms;
+            if( !_muttley_conf.recorder[ 0 ] ||
+                fp_open( _muttley_conf.recorder, O_WRONLY | O_DSYNC, 0, 0,
+                         SYS_ADSPACE, &_recorder_fp ) )
+                _recorder_fp = NULL;                // not used if it's NULL
 
             // set up the kernel proc's name to 'muttley:/device'
             strcpy( name, "muttley:" );
-            strncat( name, _muttley_conf.device,
+            strncat( name, _MTL_PATH( 0 ),
                      _MTL_KPROC_NAME_SZ - strlen( name ) - 1 );
 
             // initialize the control channel to run
             _muttley_cmd = mtl_cmd_start;
+            tstart( _muttley_tick_trb );
             // create and start the kernel proc on the '_mutley' function
-            if( ( kpid = creatp() ) != -1 )
-                if( initp( kpid, _muttley, NULL, 0, name ) != 0 )
-                    r = ( -1 );
+            r = _muttley_kproc_start( &_muttley_stats.running, _muttley, NULL,
+                                      0, name );
+            // and the workers, each given its index
+            for( i = 0; !r && ( i < _muttley_conf.workers ); i++ ) {
+                sprintf( name, _MTL_WORKER_KPROC_NAME, i );
+                r = _muttley_kproc_start( &_muttley_stats.worker[ i ].running,
+                                          _muttley_worker_kproc,
+                                          (void *)&_muttley_worker[ i ].id,
+                                          sizeof( int ), name );
+            }
+            // and the heartbeat's, if there's one
+            if( !r && _muttley_hb_fp )
+                r = _muttley_kproc_start( &_muttley_stats.hb.running,
+                                          _muttley_hb, NULL, 0,
+                                          _MTL_HB_KPROC_NAME );
+            // and the alert kernel proc
+            if( !r )
+                r = _muttley_kproc_start( &_muttley_stats.alert.running,
+                                          _muttley_alerter, NULL, 0,
+                                          _MTL_ALERT_KPROC_NAME );
+            // and the command kernel proc
+            if( !r )
+                r = _muttley_kproc_start( &_muttley_stats.command_running,
+                                          _muttley_commander, NULL, 0,
+                                          _MTL_COMMAND_KPROC_NAME );
+
+            // any of them failing to start stops those which did, and only
+            // once they all did is everything released, otherwise it's left
+            // for the stop action to wait for them again
+            if( r && !_muttley_stop() ) {
+                _muttley_release();
+                unpincode( _muttley_ctrl );
+            }
         }
 
     } else if( cmd == CFG_TERM ) { // from muttley comand line stop command
 
-        // tell the kernel proc to stop
-        _muttley_cmd = mtl_cmd_stop;
-
-        // wait for the kernel proc to stop for _MTL_KPROC_TIMEOUT seconds
-        while( _muttley_info[ mtl_query_running ] &&
-               ( i < _MTL_KPROC_TIMEOUT ) ) {
-            delay( HZ );
-            i++;
-        }
-
         // upon successfull termination, unpin code pages from physical memory
-        if( !_muttley_info[ mtl_query_running ] ) {
-            if( _console_fp )
-                fp_close( _console_fp );
+        if( !_muttley_stop() ) {
+            _muttley_release();
             r = unpincode( _muttley_ctrl );
         } else
             r = ( -1 );
@@ -248,9 +2696,501 @@ int _muttley_ctrl( int cmd, struct uio * uiop ) {
 // userland processes from the kernel
 int muttley_query( enum muttley_query query ) {
 
-    // return the requested info value from _mtl_info
-    if( ( query >= 0 ) && ( query < mtl_query_sz ) )
-        return( _muttley_info[ query ] );
+    _MTL_SYSCALL();
+
+    // return the requested info value from _muttley_stats
+    switch( query ) {
+        case mtl_query_running:
+            return( _muttley_stats.running );
+        case mtl_query_last_result:
+            return( _muttley_stats.last_result );
+        case mtl_query_last_time:
+            return( (int)( _muttley_stats.last_time / 1000000000 ) );
+        case mtl_query_last_successes:
+            return( _muttley_stats.last_successes );
+        case mtl_query_last_failures:
+            return( _muttley_stats.last_failures );
+        case mtl_query_failed_runs:
+            return( _muttley_stats.failed_runs );
+        case mtl_query_total_successes:
+            return( (int)_muttley_stats.total_successes );
+        case mtl_query_total_failures:
+            return( (int)_muttley_stats.total_failures );
+        default:
+            break;
+    }
     return( -1 );
 
 }
+
+
+// copy len bytes at src, guarded by the generation *gen, out to dst in
+// userland, trying again while an update is in progress or happened while
+// copying, right away at first and then once a tick, so that neither an
+// update nor a copy is held up for long, returns 0 on success or an errno
+int _muttley_snap_copy( volatile uint64_t * gen, char * src, char * dst,
+                        int len ) {
+
+    int i;
+    uint64_t g;
+
+    for( i = 0; i < _MTL_SNAP_SPINS + _MTL_SNAP_RETRIES; i++ ) {
+
+        if( i >= _MTL_SNAP_SPINS )
+            delay( 1 );
+
+        // don't bother copying while an update is in progress
+        if( ( g = *gen ) & 1 )
+            continue;
+        __lwsync();
+
+        if( copyout( src, dst, len ) )
+            return( EFAULT );
+
+        // it's only good if no update happened while copying
+        __lwsync();
+        if( g == *gen )
+            return( 0 );
+    }
+
+    return( EAGAIN );
+}
+
+
+// exported system call to collect all statistics at once from userland,
+// copies up to size bytes of a snapshot into stats (only the monitored
+// targets are copied, and only whole ones), the header, each worker and
+// each target are consistent on their own, returns the number of bytes
+// copied or (-1) on error
+int muttley_snapshot( struct muttley_stats * stats, int size ) {
+
+    int w, t, n, r, len;
+    uint64_t now;
+
+    _MTL_SYSCALL();
+
+    len = (int)sizeof( struct muttley_stats );
+    if( size < len ) {
+        setuerror( EINVAL );
+        return( -1 );
+    }
+
+    // the header, then each worker over its copy in it, and each target
+    r = _muttley_snap_copy( &_muttley_stats_gen, (char *)&_muttley_stats,
+                            (char *)stats, len );
+    for( w = 0; !r && ( w < _muttley_stats.workers ); w++ )
+        r = _muttley_snap_copy( &_muttley_shard_gen[ w ],
+                                (char *)&_muttley_stats.worker[ w ],
+                                (char *)&stats->worker[ w ],
+                                sizeof( struct muttley_worker_stats ) );
+    // the targets follow the header, and are only read while they aren't
+    // being freed (see _muttley_release)
+    fetch_and_add( &_muttley_readers, 1 );
+    __sync();
+    n = ( size - len ) / (int)sizeof( struct muttley_target_stats );
+    if( n > _muttley_stats.targets )
+        n = _muttley_stats.targets;
+    for( t = 0; !r && ( t < n ); t++ )
+        r = _muttley_snap_copy( &_muttley_target_gen[ t ],
+                                (char *)&_muttley_tstats[ t ],
+                                (char *)stats + len + t *
+                                (int)sizeof( struct muttley_target_stats ),
+                                sizeof( struct muttley_target_stats ) );
+    fetch_and_add( &_muttley_readers, -1 );
+    if( r ) {
+        setuerror( r );
+        return( -1 );
+    }
+
+    now = _muttley_now();
+    if( copyout( (char *)&now, (char *)&stats->time, sizeof( now ) ) ) {
+        setuerror( EFAULT );
+        return( -1 );
+    }
+    return( len + n * (int)sizeof( struct muttley_target_stats ) );
+
+}
+
+
+// exported system call to query a target's rolling window, merges the slots
+// still within the window into a single rollup, copied into *rollup, returns
+// 0 on success or (-1) on error, the kernel proc isn't held back while
+// merging so the most recent check may or may not be included
+int muttley_rollup( int target, int window, struct muttley_rollup * rollup ) {
+
+    int s, slot_len;
+    uint32_t epoch;
+    struct muttley_slot * slot;
+    struct muttley_rollup r;
+
+    _MTL_SYSCALL();
+
+    // the rollups are only read while they aren't being freed (see
+    // _muttley_release)
+    fetch_and_add( &_muttley_readers, 1 );
+    __sync();
+    if( !_muttley_stats.running || !_muttley_rollups ||
+        ( target < 0 ) || ( target >= _muttley_stats.targets ) ||
+        ( window < 0 ) || ( window >= mtl_window_sz ) ) {
+        fetch_and_add( &_muttley_readers, -1 );
+        setuerror( EINVAL );
+        return( -1 );
+    }
+
+    slot_len = _muttley_window_len[ window ] / MTL_WINDOW_SLOTS;
+    epoch = _muttley_now() / 1000000000 / slot_len;
+
+    bzero( (char *)&r, sizeof( r ) );
+    r.start = (uint64_t)( epoch - MTL_WINDOW_SLOTS + 1 ) * slot_len *
+        1000000000;
+
+    for( s = 0; s < MTL_WINDOW_SLOTS; s++ ) {
+        slot = &_muttley_rollups[ target ].slot[ window ][ s ];
+        if( epoch - slot->epoch >= MTL_WINDOW_SLOTS )
+            continue;                       // too old, or never used
+        r.probes += slot->probes;
+        r.failures += slot->failures;
+        if( (uint64_t)slot->latency_max * 1000 > r.latency_max )
+            r.latency_max = (uint64_t)slot->latency_max * 1000;
+        sketch_merge( &r.latency, &slot->latency );
+    }
+    fetch_and_add( &_muttley_readers, -1 );
+
+    if( copyout( (char *)&r, (char *)rollup, sizeof( r ) ) ) {
+        setuerror( EFAULT );
+        return( -1 );
+    }
+    return( 0 );
+
+}
+
+
+// exported system call to stream the probe trace ring to userland, copies
+// up to count events following *pos into events, and updates *pos, returns
+// the number of events copied or (-1) on error
+int muttley_trace( struct muttley_trace_pos * pos,
+                   struct muttley_event * events, int count ) {
+
+    int n = 0;
+    uint64_t head, seq;
+    struct muttley_event * e;
+    struct muttley_event ev;
+    struct muttley_trace_pos p;
+
+    _MTL_SYSCALL();
+
+    if( copyin( (char *)pos, (char *)&p, sizeof( p ) ) ) {
+        setuerror( EFAULT );
+        return( -1 );
+    }
+
+    head = _muttley_trace_head;
+    __lwsync();
+
+    // a reader ahead of the head is left over from a previous start, begin
+    // again from the oldest event still in the ring
+    if( p.next > head )
+        p.next = 0;
+    // a reader that fell more than a ring behind lost the events in between,
+    // a new reader (next == 0) simply starts with the oldest event
+    if( ( head > MTL_TRACE_SZ ) && ( p.next < head - MTL_TRACE_SZ ) ) {
+        if( p.next )
+            p.overruns += head - MTL_TRACE_SZ - p.next;
+        p.next = head - MTL_TRACE_SZ;
+    }
+
+    while( ( p.next < head ) && ( n < count ) ) {
+
+        e = &_muttley_trace_ring[ p.next & ( MTL_TRACE_SZ - 1 ) ];
+
+        // an event claimed but not written yet (the slot still holds an
+        // older one, or is being written) is left for the next call
+        seq = e->seq;
+        if( ( seq == _MTL_TRACE_INVALID ) || ( seq < p.next ) )
+            break;
+
+        // copy the event, it is only valid if its slot wasn't rewritten
+        // while we were at it
+        __lwsync();
+        ev = *e;
+        __lwsync();
+        if( ( seq != p.next ) || ( e->seq != p.next ) ) {
+            p.overruns++;
+            p.next++;
+            continue;
+        }
+
+        if( copyout( (char *)&ev, (char *)&events[ n ], sizeof( ev ) ) ) {
+            setuerror( EFAULT );
+            return( -1 );
+        }
+        n++;
+        p.next++;
+    }
+
+    if( copyout( (char *)&p, (char *)pos, sizeof( p ) ) ) {
+        setuerror( EFAULT );
+        return( -1 );
+    }
+    return( n );
+
+}
+
+
+// muttley_command, once its caller is counted in _muttley_callers
+int _muttley_command_call( struct muttley_command * cmds, int count ) {
+
+    int c, n, done;
+    int slot[ MTL_COMMAND_BATCH ];
+    struct muttley_command cmd[ MTL_COMMAND_BATCH ];
+
+    _MTL_SYSCALL();
+
+    if( ( count < 1 ) || ( count > MTL_COMMAND_BATCH ) ) {
+        setuerror( EINVAL );
+        return( -1 );
+    }
+    if( copyin( (char *)cmds, (char *)cmd, count * sizeof( cmd[ 0 ] ) ) ) {
+        setuerror( EFAULT );
+        return( -1 );
+    }
+    if( !_muttley_stats.running ) {
+        setuerror( ESRCH );
+        return( -1 );
+    }
+    for( c = 0; c < count; c++ ) {
+        if( ( cmd[ c ].type < 0 ) || ( cmd[ c ].type >= mtl_command_sz ) ||
+            ( ( cmd[ c ].target != MTL_TARGET_ALL ) &&
+              ( ( cmd[ c ].target < 0 ) ||
+                ( cmd[ c ].target >= _muttley_stats.targets ) ) ) ) {
+            setuerror( EINVAL );
+            return( -1 );
+        }
+    }
+
+    simple_lock( &_muttley_cmdq_lock );
+
+    // the kernel proc may have been told to stop meanwhile
+    if( _muttley_cmd != mtl_cmd_start ) {
+        simple_unlock( &_muttley_cmdq_lock );
+        setuerror( ESRCH );
+        return( -1 );
+    }
+
+    // take queue entries for all of the commands, or for none
+    for( c = 0, n = 0; ( n < _MTL_CMDQ_SZ ) && ( c < count ); n++ )
+        if( _muttley_cmdq[ n ].state == mtl_cmdq_free )
+            slot[ c++ ] = n;
+    if( c < count ) {
+        simple_unlock( &_muttley_cmdq_lock );
+        setuerror( EAGAIN );
+        return( -1 );
+    }
+    for( c = 0; c < count; c++ ) {
+        _muttley_cmdq[ slot[ c ] ].cmd = cmd[ c ];
+        _muttley_cmdq[ slot[ c ] ].state = mtl_cmdq_queued;
+    }
+    _muttley_cmdq_queued += count;
+    _muttley_cmdq_waiters++;
+    e_wakeup( &_muttley_cmdq_event );
+
+    // and wait for all of them to be done
+    for( ;; ) {
+        for( c = 0, done = 0; c < count; c++ )
+            if( _muttley_cmdq[ slot[ c ] ].state == mtl_cmdq_done )
+                done++;
+        if( done == count )
+            break;
+        if( e_sleep_thread( &_muttley_cmdq_done, &_muttley_cmdq_lock,
+                            LOCK_SIMPLE | INTERRUPTIBLE ) == THREAD_INTERRUPTED ) {
+            // give up, commands not taken yet are dropped, the command
+            // kernel proc frees those it's carrying out once it's done
+            for( c = 0; c < count; c++ ) {
+                switch( _muttley_cmdq[ slot[ c ] ].state ) {
+                    case mtl_cmdq_queued:
+                        _muttley_cmdq_queued--;
+                        _muttley_cmdq[ slot[ c ] ].state = mtl_cmdq_free;
+                        break;
+                    case mtl_cmdq_busy:
+                        _muttley_cmdq[ slot[ c ] ].state = mtl_cmdq_abandoned;
+                        break;
+                    default:
+                        _muttley_cmdq[ slot[ c ] ].state = mtl_cmdq_free;
+                        break;
+                }
+            }
+            _muttley_cmdq_waiters--;
+            simple_unlock( &_muttley_cmdq_lock );
+            setuerror( EINTR );
+            return( -1 );
+        }
+    }
+
+    for( c = 0; c < count; c++ ) {
+        cmd[ c ] = _muttley_cmdq[ slot[ c ] ].cmd;
+        _muttley_cmdq[ slot[ c ] ].state = mtl_cmdq_free;
+    }
+    _muttley_cmdq_waiters--;
+    simple_unlock( &_muttley_cmdq_lock );
+
+    if( copyout( (char *)cmd, (char *)cmds, count * sizeof( cmd[ 0 ] ) ) ) {
+        setuerror( EFAULT );
+        return( -1 );
+    }
+    return( count );
+
+}
+
+
+// exported system call to send commands to the kernel procs, the count
+// commands in cmds are queued as a whole and handled by the command kernel
+// proc, which they wake up, the caller sleeps until they're done
+// and gets the results back in cmds, returns count or (-1) on error
+int muttley_command( struct muttley_command * cmds, int count ) {
+
+    int r;
+
+    // counted before checking monitoring runs (see _muttley_release)
+    fetch_and_add( &_muttley_callers, 1 );
+    __sync();
+    r = _muttley_command_call( cmds, count );
+    fetch_and_add( &_muttley_callers, -1 );
+    return( r );
+}
+
+
+// muttley_fence, once its caller is counted in _muttley_callers
+int _muttley_fence_call( int op, struct muttley_fence * fence ) {
+
+    int ipri, failed = 0;
+    uint64_t now;
+    struct muttley_fence f;
+    struct muttley_fence_stats * fs = &_muttley_stats.fence;
+
+    _MTL_SYSCALL();
+
+    if( ( op < 0 ) || ( op >= mtl_fence_op_sz ) ) {
+        setuerror( EINVAL );
+        return( -1 );
+    }
+    if( copyin( (char *)fence, (char *)&f, sizeof( f ) ) ) {
+        setuerror( EFAULT );
+        return( -1 );
+    }
+    if( !_muttley_stats.running || !_muttley_conf.hook_timeout ) {
+        setuerror( ESRCH );
+        return( -1 );
+    }
+
+    ipri = disable_lock( INTMAX, &_muttley_fence_lock );
+
+    // the kernel proc may have been told to stop meanwhile
+    if( _muttley_cmd != mtl_cmd_start ) {
+        unlock_enable( ipri, &_muttley_fence_lock );
+        setuerror( ESRCH );
+        return( -1 );
+    }
+
+    switch( op ) {
+
+        case mtl_fence_wait:
+            _muttley_fence_waiters++;
+            fs->daemons = _muttley_fence_waiters;
+            while( ( fs->state != mtl_fence_triggered ) &&
+                   ( _muttley_cmd == mtl_cmd_start ) ) {
+                if( e_sleep_thread( &_muttley_fence_event,
+                                    &_muttley_fence_lock, LOCK_HANDLER |
+                                    INTERRUPTIBLE ) == THREAD_INTERRUPTED )
+                    break;
+            }
+            _muttley_fence_waiters--;
+            fs->daemons = _muttley_fence_waiters;
+            if( _muttley_cmd != mtl_cmd_start ) {
+                unlock_enable( ipri, &_muttley_fence_lock );
+                setuerror( ESRCH );
+                return( -1 );
+            }
+            if( fs->state != mtl_fence_triggered ) {
+                unlock_enable( ipri, &_muttley_fence_lock );
+                setuerror( EINTR );
+                return( -1 );
+            }
+            now = _muttley_now();
+            _muttley_stats_begin();
+            if( !fs->woken ) {
+                fs->woken = now;
+                if( now - fs->detected > fs->wakeup_max )
+                    fs->wakeup_max = now - fs->detected;
+            }
+            _muttley_stats_end();
+            f.seq = fs->seq;
+            f.detected = fs->detected;
+            f.target = fs->target;
+            f.failed_runs = _muttley_tstats[ fs->target ].failed_runs;
+            f.status = 0;
+            break;
+
+        case mtl_fence_started:
+            if( ( f.seq == fs->seq ) && ( fs->state == mtl_fence_triggered ) ) {
+                now = _muttley_now();
+                _muttley_stats_begin();
+                fs->started = now;
+                if( now - fs->detected > fs->start_max )
+                    fs->start_max = now - fs->detected;
+                fs->state = mtl_fence_running;
+                _muttley_stats_end();
+            }
+            break;
+
+        case mtl_fence_finished:
+            // a hook finishing past its deadline has already been failed
+            if( ( f.seq == fs->seq ) && ( fs->state == mtl_fence_running ) ) {
+                _muttley_stats_begin();
+                fs->finished = _muttley_now();
+                fs->status = f.status;
+                _muttley_stats_end();
+                if( f.status )
+                    failed = _muttley_fence_fail();
+                else {
+                    _muttley_stats_begin();
+                    fs->state = mtl_fence_done;
+                    _muttley_stats_end();
+                }
+            }
+            break;
+    }
+
+    unlock_enable( ipri, &_muttley_fence_lock );
+
+    // the deadline timer is left alone if it's expiring right now, it only
+    // fails hooks which are still pending
+    if( op == mtl_fence_finished )
+        tstop( _muttley_fence_trb );
+    if( failed && ( _muttley_conf.behaviour == mtl_behaviour_panic ) )
+        panic( _panic_str );
+
+    if( ( op == mtl_fence_wait ) &&
+        copyout( (char *)&f, (char *)fence, sizeof( f ) ) ) {
+        setuerror( EFAULT );
+        return( -1 );
+    }
+    return( 0 );
+}
+
+
+// the fencing hook daemon's system call, with 'op':
+// - mtl_fence_wait, sleeps until the hook is needed and fills in 'fence'
+// - mtl_fence_started, tells the hook of 'fence' was started
+// - mtl_fence_finished, tells it finished with fence->status (0 success)
+// returns 0 on success, or -1 setting errno to ESRCH once monitoring stops
+int muttley_fence( int op, struct muttley_fence * fence ) {
+
+    int r;
+
+    // counted before checking monitoring runs (see _muttley_release)
+    fetch_and_add( &_muttley_callers, 1 );
+    __sync();
+    r = _muttley_fence_call( op, fence );
+    fetch_and_add( &_muttley_callers, -1 );
+    return( r );
+}
@@ -25,15 +25,170 @@
 #define MUTTLEY_KEX_H
 
 #include <limits.h>
+#include <sys/types.h>
 
-// defines allowable behaviours when the check thresholds are exceeded
+#include "sketch.h"
+#include "heartbeat.h"
+#include "shard.h"
+
+// maximum number of targets (devices or files) monitored at once
+#define MTL_TARGETS_MAX 10240
+
+// size of the string arena the targets' paths are interned in, which allows
+// for an average path of 64 bytes (device paths are far shorter)
+#define MTL_PATHS_SZ ( 64 * MTL_TARGETS_MAX )
+
+// version of the statistics schema returned by muttley_snapshot
+#define MTL_STATS_VERSION 14
+
+// number of slots each rollup window is made of, a window slides in steps
+// of 1/MTL_WINDOW_SLOTS of its length
+#define MTL_WINDOW_SLOTS 6
+
+// size of the scratch block write targets write and read back, offsets of
+// scratch blocks must be aligned to it (suits direct i/o on jfs2 as well)
+#define MTL_SCRATCH_SZ    4096
+#define MTL_SCRATCH_MAGIC 0x4d544c57   // 'MTLW'
+
+// maximum number of worker kernel procs the targets are sharded across
+#define MTL_WORKERS_MAX SHARD_WORKERS_MAX
+
+// maximum number of dependencies of logical targets on physical ones
+#define MTL_DEPS_MAX 4096
+
+// shortest interval between runs in ms, when they're more than once a
+// second (see query_ms)
+#define MTL_QUERY_MS_MIN 10
+
+// upper bounds of the run time parameters, as given at start or tuned
+#define MTL_CHECKS_MAX     10
+#define MTL_RUNS_MAX       1000
+#define MTL_INTERVAL_MAX   60
+#define MTL_FULL_EVERY_MAX 1000
+#define MTL_ALERT_RATE_MAX 600
+
+// num of bytes a read target's full check reads, from its start
+#define MTL_READ_SZ 512
+
+// maximum number of commands passed to muttley_command at once
+#define MTL_COMMAND_BATCH 32
+
+// target of a command meaning every target
+#define MTL_TARGET_ALL    ( -1 )
+
+// number of probe events kept in the kernel extension's trace ring (must be
+// a power of two), older events are overwritten by newer ones
+#define MTL_TRACE_SZ 2048
+
+// number of alerts queued for the alert kernel proc, alerts raised while
+// it's full are dropped (and counted)
+#define MTL_ALERT_QUEUE_SZ 1024
+
+// max number of targets named in a coalesced alert message
+#define MTL_ALERT_NAMED   8
+
+// number of runs kept by the flight recorder, and number of checks kept for
+// each of those runs (checks beyond that are counted but not kept)
+#define MTL_FR_RUNS    64
+#define MTL_FR_CHECKS  32
+
+// flight recorder file identification
+#define MTL_FR_MAGIC   0x4d544c46      // 'MTLF'
+#define MTL_FR_VERSION 1
+
+// defines allowable behaviours when the check thresholds are exceeded, all
+// of them alert first (see muttley_alert_sink)
 enum muttley_behaviour {
-    mtl_behaviour_none = 0,     // do nothing
-    mtl_behaviour_panic,        // force a kernel panic
+    mtl_behaviour_none = 0,     // do nothing else
+    mtl_behaviour_panic,        // run the fencing hook (if any) and force a
+                                // kernel panic, unless it succeeds in time
+    mtl_behaviour_fence,        // run the fencing hook, never panic
     mtl_behaviour_sz
 };
 
-// defines the list of possible querys to make to the kernel extension
+// states of the fencing hook, escalated once the threshold is reached and
+// back to idle once every target recovers
+enum muttley_fence_state {
+    mtl_fence_idle = 0,         // threshold not reached
+    mtl_fence_triggered,        // waiting for the hook daemon to start it
+    mtl_fence_running,          // started, waiting for it to finish
+    mtl_fence_done,             // succeeded in time
+    mtl_fence_failed,           // failed, or missed its deadline
+    mtl_fence_sz
+};
+
+// what the hook daemon asks or tells muttley_fence
+enum muttley_fence_op {
+    mtl_fence_wait = 0,         // wait for the hook to be needed
+    mtl_fence_started,          // the hook was started
+    mtl_fence_finished,         // the hook finished (with 'status')
+    mtl_fence_op_sz
+};
+
+// defines what's alerted on, alerts are queued as they're detected and
+// emitted, those of a kind raised together coalesced into a single message,
+// by the alert kernel proc
+enum muttley_alert_type {
+    mtl_alert_failing = 0,      // a target failed a run, after passing
+    mtl_alert_recovered,        // a target passed a run, after failing
+    mtl_alert_threshold,        // the failed runs threshold was reached
+    mtl_alert_sz
+};
+
+// defines where alerts are emitted to, each sink is rate limited on its own
+enum muttley_alert_sink {
+    mtl_sink_console = 0,       // the system console
+    mtl_sink_syslog,            // syslog (through bsdlog)
+    mtl_sink_file,              // the alert file, if there's one
+    mtl_sink_sz
+};
+
+// defines the kinds of targets and how each one is checked
+enum muttley_target_type {
+    mtl_target_read = 0,        // open and read a device (or file)
+    mtl_target_canary,          // statfs, then create, write, fsync and
+                                // unlink a canary file in a directory
+    mtl_target_write,           // write a scratch block of a device (or
+                                // file) and read it back
+    mtl_target_logical,         // not checked in runs, passes or fails with
+                                // the targets it's on (see muttley_dep)
+    mtl_target_sz
+};
+
+// defines the steps a check is made of, each one is timed on its own and
+// may have its own deadline
+enum muttley_step {
+    mtl_step_open = 0,          // open the device
+    mtl_step_read,              // read from the device
+    mtl_step_statfs,            // statfs on the directory's filesystem
+    mtl_step_create,            // create the canary file
+    mtl_step_write,             // write to the canary file
+    mtl_step_fsync,             // fsync and close the canary file
+    mtl_step_unlink,            // unlink the canary file
+    mtl_step_query,             // query the held device (or stat the file)
+    mtl_step_sz
+};
+
+// defines the tiers of the checks, read targets' checks only query their
+// held device, but every full_every-th one and those whose query looks
+// wrong, other targets' checks are always full
+enum muttley_tier {
+    mtl_tier_query = 0,         // query the held device, no data transfer
+    mtl_tier_full,              // open, read and close it (or the whole check
+                                // of other kinds of targets)
+    mtl_tier_sz
+};
+
+// defines the rolling windows kept for each target
+enum muttley_window {
+    mtl_window_minute = 0,      // the last minute
+    mtl_window_hour,            // the last hour
+    mtl_window_day,             // the last 24 hours
+    mtl_window_sz
+};
+
+// defines the list of possible querys to make to the kernel extension, the
+// values are truncated to int, use muttley_snapshot for the full statistics
 enum muttley_query {
     mtl_query_running = 0,         // is the kernel process running (0 no, 1 yes)
     mtl_query_last_result,         // result of the last run (0 fail, 1 pass)
@@ -46,21 +201,489 @@ enum muttley_query {
     mtl_query_sz
 };
 
-// structure prototype for the kernel extension's parameters
+// defines the commands which may be sent to the command kernel proc
+// through muttley_command, to act on a target (or on every target)
+enum muttley_command_type {
+    mtl_command_probe = 0,      // check the target now, returning the result
+    mtl_command_pause,          // stop checking the target in runs
+    mtl_command_resume,         // check the target in runs again
+    mtl_command_reset,          // zero the target's counters (and, for every
+                                // target, the totals as well)
+    mtl_command_tune,           // change the run time parameters (see
+                                // muttley_tune), for every target
+    mtl_command_sz
+};
+
+// defines why the flight recorder was written out to its file
+enum muttley_fr_reason {
+    mtl_fr_reason_none = 0,     // never written out (file just created)
+    mtl_fr_reason_threshold,    // failed runs threshold was reached
+    mtl_fr_reason_stop,         // monitoring was stopped
+    mtl_fr_reason_sz
+};
+
+// a single check as kept by the flight recorder
+struct muttley_fr_check {
+    uint32_t latency;                    // check duration in us
+    int16_t target;                      // index of the checked target
+    int16_t error;                       // errno of the failed operation
+};
+
+// a single run as kept by the flight recorder
+struct muttley_fr_run {
+    uint64_t time;                       // run start time in ns since epoch
+    int result;                          // run result (0 fail, 1 pass)
+    int successes;                       // num of successful checks
+    int failures;                        // num of failed checks
+    int failed_runs;                     // consecutive failed runs, this included
+    int runs;                            // failed runs threshold at the time
+    int checks;                          // checks performed (may be > kept)
+    struct muttley_fr_check check[ MTL_FR_CHECKS ];
+};
+
+// the flight recorder, a ring of the latest runs, which is also the layout
+// of the file it's written to
+struct muttley_fr {
+    uint32_t magic;                      // MTL_FR_MAGIC
+    uint32_t version;                    // MTL_FR_VERSION
+    uint64_t start;                      // monitoring start time in ns
+    uint64_t written;                    // time it was written out in ns
+    uint64_t runs;                       // runs recorded since start, the
+                                         // latest being at (runs - 1) % sz
+    int reason;                          // why it was written out
+    int behaviour;                       // configured behaviour
+    int checks;                          // configured checks per run
+    int successes;                       // configured successes per run
+    int interval;                        // configured interval in seconds
+    int query_ms;                        // configured interval in ms, when
+                                         // runs are more often (0 none)
+    struct muttley_fr_run run[ MTL_FR_RUNS ];
+};
+
+// the scratch block of a write target, every write carries a new sequence
+// number so a read back served by a stale cache doesn't pass
+struct muttley_scratch {
+    uint32_t magic;                      // MTL_SCRATCH_MAGIC
+    int target;                          // index of the written target
+    uint64_t seq;                        // write sequence number
+    uint64_t time;                       // write time in ns since epoch
+};
+
+// run time parameters a tune command changes while monitoring, the others
+// need a restart, a parameter left 0 is left unchanged
+struct muttley_tune {
+    int interval;                        // interval between runs in seconds
+    int runs;                            // num of failed runs to execute
+                                         // behaviour
+    int checks;                          // num of checks per run
+    int successes;                       // num of successes per run
+    int full_every;                      // num of checks of a read target
+                                         // per full one
+    int alert_rate;                      // messages per minute per sink
+};
+
+// a command to the command kernel proc, the results are filled in once
+// it's done
+struct muttley_command {
+    int type;                            // what to do (see above)
+    int target;                          // target index or MTL_TARGET_ALL
+    int result;                          // probe result (0 fail, 1 pass), for
+                                         // every target all must pass
+    int error;                           // errno of the failed probe (or of
+                                         // the command itself)
+    uint64_t latency;                    // probe duration in ns (the longest
+                                         // one, for every target)
+    struct muttley_tune tune;            // new parameters (tune only)
+};
+
+// an escalation, as handed to the hook daemon by muttley_fence, which is
+// given back to report on the hook
+struct muttley_fence {
+    uint64_t seq;                        // escalation sequence number
+    uint64_t detected;                   // time the threshold was reached in ns
+    int target;                          // target which reached it
+    int failed_runs;                     // its consecutive failed runs
+    int status;                          // hook's exit status (finished)
+    int pad;
+};
+
+// a dependency of a logical target (e.g. a logical volume) on a target
+// which is checked (e.g. a physical volume it's on), so a physical target
+// shared by several logical ones is only checked once
+struct muttley_dep {
+    int16_t target;                      // index of the logical target
+    int16_t source;                      // index of the target it's on
+};
+
+// a target's parameters, 'targets' of them follow the kernel extension's
+// parameters when they're passed in (see MTL_CONF_LEN)
+struct muttley_target_conf {
+    uint64_t offset;                     // scratch block offset (write targets)
+    int path;                            // offset of its path in the paths
+                                         // (see MTL_PATH)
+    int type;                            // kind of target (see above)
+    int direct;                          // use direct i/o (files)
+    int mirrored;                        // logical target passes if any of
+                                         // the targets it's on does (not all)
+    int limit;                           // deadline in ms of its steps which
+                                         // have none of their own, from its
+                                         // baseline (0 none)
+    int query_limit;                     // deadline in ms of its query steps
+                                         // when they have none of their own,
+                                         // from its baseline (0 limit)
+};
+
+// structure prototype for the kernel extension's parameters, which are
+// passed in followed by 'targets' struct muttley_target_conf and then by the
+// paths_sz bytes of the targets' paths, NUL terminated and each one there
+// once, so that the kernel extension only allocates as much as the targets
+// given need
 struct muttley_conf {
-    char device[ PATH_MAX ];     // path name of device to monitor
-    int behaviour;                       // behaviour on failure (none, panic)
+    int deps;                            // num of dependencies
+    struct muttley_dep dep[ MTL_DEPS_MAX ]; // logical targets' dependencies
+    char recorder[ PATH_MAX ];   // flight recorder file ('' for none)
+    char alert_file[ PATH_MAX ];         // alert file ('' for none)
+    int alert_rate;                      // messages per minute each sink
+                                         // emits, at most (also its burst)
+    int alert_coalesce;                  // time in ms alerts are gathered
+                                         // for before being emitted
+    char hb_device[ PATH_MAX ];          // heartbeat device ('' for none)
+    uint64_t hb_offset;                  // heartbeat region offset
+    int hb_direct;                       // use direct i/o (heartbeat)
+    int hb_node;                         // our node, i.e. slot, number
+    int hb_interval;                     // interval between heartbeats in ms
+    int hb_timeout;                      // time for a peer to stall in ms
+    int targets;                         // num of devices to monitor
+    int workers;                         // num of worker kernel procs
+    int deadline[ mtl_step_sz ];         // deadline of each step in ms (0 none)
+    int behaviour;                       // behaviour on failure (none, panic,
+                                         // fence)
+    int hook_timeout;                    // time for the fencing hook to
+                                         // succeed in ms (0 for no hook)
     int runs;                            // num of failed runs to execute behaviour
     int checks;                          // num of checks per run
     int successes;                       // num of successes to consider a run successful
     int interval;                        // interval between runs in seconds
+    int full_every;                      // num of checks of a read target
+                                         // per full one, the others only
+                                         // query it (1 for all full)
+    int query_ms;                        // interval between runs in ms,
+                                         // instead of interval, when tiered
+                                         // (0 none)
+    int paths_sz;                        // num of bytes of paths in use
+};
+
+// path of target t, given the targets' parameters and their paths
+#define MTL_PATH( paths, tconf, t ) ( (paths) + (tconf)[ t ].path )
+
+// length of a configuration as it's passed in, with its targets and paths
+#define MTL_CONF_LEN( conf ) \
+    ( sizeof( struct muttley_conf ) + \
+      (conf)->targets * sizeof( struct muttley_target_conf ) + \
+      (conf)->paths_sz )
+
+// max length of a configuration as it's passed in
+#define MTL_CONF_MAX \
+    ( sizeof( struct muttley_conf ) + \
+      MTL_TARGETS_MAX * sizeof( struct muttley_target_conf ) + MTL_PATHS_SZ )
+
+// statistics of a single target, counters are monotonic since start and
+// times are in ns (since epoch, for points in time)
+struct muttley_target_stats {
+    uint64_t probes;                     // num of checks performed
+    uint64_t successes;                  // num of successful checks
+    uint64_t failures;                   // num of failed checks
+    uint64_t latency;                    // sum of check durations
+    uint64_t latency_max;                // longest check duration
+    uint64_t last_time;                  // start time of the last check
+    uint64_t last_latency;               // duration of the last check
+    uint64_t runs;                       // num of runs
+    uint64_t failed_runs_total;          // num of failed runs
+    uint64_t timeouts;                   // num of steps past their deadline
+    uint64_t stalls;                     // num of intervals a step was stuck
+    uint64_t io_calls;                   // num of i/o kernel services called
+    uint64_t io_bytes;                   // num of bytes read and written
+    uint64_t tier_probes[ mtl_tier_sz ]; // num of checks of each tier
+    uint64_t tier_latency[ mtl_tier_sz ]; // sum of their durations
+    uint64_t tier_max[ mtl_tier_sz ];    // longest of them
+    uint64_t escalations;                // num of full checks made at once
+                                         // as a query looked wrong
+    uint64_t step_latency[ mtl_step_sz ]; // duration of each step's last run
+    uint64_t step_max[ mtl_step_sz ];    // longest duration of each step
+    int last_result;                     // result of the last check
+    int last_error;                      // errno of the last check
+    int failed_runs;                     // num of consecutive failed runs
+    int stalled_step;                    // step stuck past its deadline (or -1)
+    int paused;                          // not checked in runs (by command)
+    int type;                            // kind of target (see above)
+};
+
+// heartbeat statistics, peer[] is indexed by node (our own node's entry is
+// unused), times are in ns (since epoch, for points in time)
+struct muttley_hb_stats {
+    uint64_t seq;                        // sequence number last written
+    uint64_t writes;                     // num of heartbeats written
+    uint64_t write_errors;               // num of failed writes
+    uint64_t reads;                      // num of region reads
+    uint64_t read_errors;                // num of failed reads
+    uint64_t last_time;                  // time of the latest heartbeat
+    uint64_t latency_max;                // longest write and read back
+    int running;                         // is the heartbeat kernel proc running
+    int node;                            // our node number (-1 if disabled)
+    int interval;                        // interval between heartbeats in ms
+    int timeout;                         // time for a peer to stall in ms
+    int alive;                           // num of peers alive
+    int stalled;                         // num of peers stalled
+    struct hb_peer peer[ HB_SLOTS ];
+};
+
+// fencing hook statistics, times are in ns (since epoch, for points in time)
+// and are those of the latest escalation
+struct muttley_fence_stats {
+    uint64_t seq;                        // num of escalations
+    uint64_t detected;                   // time the threshold was reached
+    uint64_t woken;                      // time the hook daemon woke up
+    uint64_t started;                    // time the hook was started
+    uint64_t finished;                   // time the hook finished
+    uint64_t wakeup_max;                 // longest detection to wake up
+    uint64_t start_max;                  // longest detection to hook start
+    uint64_t failures;                   // num of hooks failed or too late
+    int state;                           // enum muttley_fence_state
+    int target;                          // target which reached the threshold
+    int status;                          // hook's exit status
+    int daemons;                         // num of hook daemons waiting
+    int timeout;                         // hook deadline in ms (0 no hook)
+    int pad;
+};
+
+// statistics of a worker kernel proc, times are in ns, the lateness of a
+// target's check is the time from its run's start to the check's start
+struct muttley_worker_stats {
+    uint64_t checked;                    // num of targets checked for runs
+    uint64_t stolen;                     // num of them taken from another
+                                         // worker's queue
+    uint64_t busy;                       // time spent checking them
+    uint64_t lateness;                   // sum of their lateness
+    uint64_t lateness_max;               // longest lateness
+    uint64_t wakeups;                    // num of times it woke up
+    int running;                         // is the worker kernel proc running
+    int cpu;                             // processor it's bound to (or -1)
+    int pid;                             // its process id
+    int pad;
+    struct sketch late;                  // lateness of its checks
+};
+
+// what monitoring costs, besides the workers' (see above) and each target's
+// i/o (see muttley_target_stats), the kernel procs' cpu time and context
+// switches are found by the controller through their process ids
+struct muttley_overhead_stats {
+    uint64_t syscalls;                   // num of system calls made into
+                                         // the kernel extension
+    uint64_t kproc_wakeups;              // num of times the kernel proc
+                                         // woke up
+    uint64_t hb_wakeups;                 // num of heartbeats, i.e. times the
+                                         // heartbeat kernel proc woke up
+    uint64_t hb_io_calls;                // num of heartbeat i/o kernel
+                                         // services called
+    uint64_t hb_io_bytes;                // num of heartbeat bytes read and
+                                         // written
+    uint64_t alert_wakeups;              // num of times the alert kernel
+                                         // proc woke up
+    uint64_t command_wakeups;            // num of times the command kernel
+                                         // proc woke up
+    int kproc_pid;                       // the kernel proc's process id
+    int hb_pid;                          // the heartbeat's (0 if none)
+    int alert_pid;                       // the alert kernel proc's
+    int command_pid;                     // the command kernel proc's
+};
+
+// statistics of an alert sink, times are in ns, the latency of a message is
+// the time from the detection of the oldest alert in it to its emission
+struct muttley_sink_stats {
+    uint64_t messages;                   // num of messages emitted
+    uint64_t alerts;                     // num of alerts in them
+    uint64_t limited;                    // num of messages dropped by the
+                                         // rate limit
+    uint64_t errors;                     // num of messages it failed to take
+    uint64_t latency;                    // sum of the messages' latency
+    uint64_t latency_max;                // longest latency
+};
+
+// alert statistics
+struct muttley_alert_stats {
+    uint64_t raised;                     // num of alerts raised
+    uint64_t dropped;                    // num of them dropped, as the queue
+                                         // was full
+    uint64_t batches;                    // num of times the queue was drained
+    uint64_t latency_max;                // longest detection to emission of
+                                         // any alert, by any sink
+    int running;                         // is the alert kernel proc running
+    int queued;                          // num of alerts queued
+    int rate;                            // configured messages per minute
+    int coalesce;                        // configured gathering time in ms
+    struct muttley_sink_stats sink[ mtl_sink_sz ];
+};
+
+// statistics snapshot, as returned by muttley_snapshot, target[] is only
+// filled up to 'targets', times are in ns (since epoch, for points in time),
+// the header, each worker and each target are consistent on their own but
+// may be a few checks apart from each other, the kernel extension keeps the
+// targets' statistics apart, allocated for the targets given, so its
+// struct muttley_stats is the header only
+struct muttley_stats {
+    uint32_t version;                    // MTL_STATS_VERSION
+    uint32_t size;                       // size of a snapshot of every target
+    uint64_t time;                       // time the snapshot was taken
+    uint64_t start;                      // monitoring start time
+    uint64_t last_time;                  // start time of the last run
+    uint64_t runs;                       // num of runs
+    uint64_t failed_runs_total;          // num of failed runs
+    uint64_t total_successes;            // num of successful checks
+    uint64_t total_failures;             // num of failed checks
+    uint64_t commands;                   // num of commands handled
+    uint64_t skipped;                    // num of targets due in a run which
+                                         // no worker got to (or finished)
+                                         // before the next one
+    int running;                         // is the kernel proc running
+    int targets;                         // num of monitored targets
+    int last_result;                     // result of the last run
+    int last_successes;                  // num of successes in the last run
+    int last_failures;                   // num of failures in the last run
+    int failed_runs;                     // worst target's consecutive failed runs
+    int workers;                         // num of worker kernel procs
+    int command_running;                 // is the command kernel proc running
+    struct muttley_hb_stats hb;          // shared disk heartbeat
+    struct muttley_fence_stats fence;    // fencing hook
+    struct muttley_overhead_stats overhead; // monitoring's own cost
+    struct muttley_alert_stats alert;    // alert pipeline
+    struct muttley_worker_stats worker[ MTL_WORKERS_MAX ];
+#ifndef _KERNEL
+    struct muttley_target_stats target[ MTL_TARGETS_MAX ];
+#endif
+};
+
+// a target's rolling window, as returned by muttley_rollup, counters and the
+// latency sketch cover the checks done since 'start'
+struct muttley_rollup {
+    uint64_t start;                      // oldest time covered in ns
+    uint64_t latency_max;                // longest check duration in ns
+    uint32_t probes;                     // num of checks performed
+    uint32_t failures;                   // num of failed checks
+    struct sketch latency;               // check durations
+};
+
+// a single probe event, as recorded in the trace ring
+struct muttley_event {
+    uint64_t seq;                        // event sequence number since start
+    uint64_t start;                      // probe start time in ns since epoch
+    uint64_t latency;                    // probe duration in ns
+    int target;                          // index of the probed target
+    int result;                          // probe result (0 fail, 1 pass)
+    int error;                           // errno of the failed operation
+    int pad;
+};
+
+// a trace ring reader's position, kept by the reader between calls to
+// muttley_trace, must be zeroed before the first call
+struct muttley_trace_pos {
+    uint64_t next;                       // sequence number of the next event
+    uint64_t overruns;                   // events lost before being read
+};
+
+// one slot of a rollup window, holding the checks of a single period of
+// length / MTL_WINDOW_SLOTS seconds
+struct muttley_slot {
+    uint32_t epoch;                      // period (time / slot length) held
+    uint32_t probes;                     // num of checks performed
+    uint32_t failures;                   // num of failed checks
+    uint32_t latency_max;                // longest check duration in us
+    struct sketch latency;               // check durations
+};
+
+// per target rollup windows, a slot is reused (and cleared) once its
+// period has gone by, so the memory used per target is fixed
+struct muttley_rollups {
+    struct muttley_slot slot[ mtl_window_sz ][ MTL_WINDOW_SLOTS ];
+};
+
+// held open device of a read target, when checks are tiered, which the
+// query tier's checks query, along with a fingerprint of what it returned
+// when the device was opened (a device which looks different since then
+// gets a full check right away) and the num of query checks since the last
+// full one
+struct muttley_held {
+    struct file * fp;                    // held device (NULL for none)
+    uint64_t print;                      // fingerprint of its query
+    int queries;                         // num of queries since a full check
+    int pad;
+};
+
+// what a logical target's result is worked out from, in a run
+struct muttley_derived {
+    int passed;                          // num of targets it's on which passed
+    int failed;                          // num of targets it's on which failed
+    int error;                           // errno of the first one which failed
+    int pad;
+    uint64_t latency;                    // longest last check of them
 };
 
+// where a target is at with respect to the workers, and what its check for
+// the current run came to
+struct muttley_sched {
+    int state;                           // enum muttley_sched_state
+    int due;                             // is it due in the current run
+    int checks;                          // num of checks performed
+    int successes;                       // num of them successful
+};
+
+// pinned memory the kernel extension allocates for each target when
+// monitoring starts, besides its path: its parameters, statistics and
+// their generation, rollup windows, held device, canary directory, run
+// result, derived result and schedule
+#define MTL_TARGET_KMEM \
+    ( sizeof( struct muttley_target_conf ) + \
+      sizeof( struct muttley_target_stats ) + sizeof( uint64_t ) + \
+      sizeof( struct muttley_rollups ) + sizeof( struct muttley_held ) + \
+      sizeof( struct file * ) + sizeof( int ) + \
+      sizeof( struct muttley_derived ) + sizeof( struct muttley_sched ) )
+
 // type for the muttley query system call when using run time linking to
 // the kernel
 typedef int ( *muttley_query_syscall_t )( enum muttley_query query );
 
+// type for the muttley trace system call when using run time linking to
+// the kernel
+typedef int ( *muttley_trace_syscall_t )( struct muttley_trace_pos * pos,
+                                          struct muttley_event * events,
+                                          int count );
+
+// type for the muttley snapshot system call when using run time linking to
+// the kernel
+typedef int ( *muttley_snapshot_syscall_t )( struct muttley_stats * stats,
+                                             int size );
+
+// type for the muttley rollup system call when using run time linking to
+// the kernel
+typedef int ( *muttley_rollup_syscall_t )( int target, int window,
+                                           struct muttley_rollup * rollup );
+
+// type for the muttley command system call when using run time linking to
+// the kernel
+typedef int ( *muttley_command_syscall_t )( struct muttley_command * cmds,
+                                            int count );
+
+// type for the muttley fence system call when using run time linking to
+// the kernel
+typedef int ( *muttley_fence_syscall_t )( int op,
+                                          struct muttley_fence * fence );
+
 // system call prototypes
 int muttley_query( enum muttley_query query );
+int muttley_snapshot( struct muttley_stats * stats, int size );
+int muttley_rollup( int target, int window, struct muttley_rollup * rollup );
+int muttley_trace( struct muttley_trace_pos * pos,
+                   struct muttley_event * events, int count );
+int muttley_command( struct muttley_command * cmds, int count );
+int muttley_fence( int op, struct muttley_fence * fence );
 
 #endif // ifndef MUTTLEY_KEX_H
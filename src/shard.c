@@ -0,0 +1,117 @@
+// shard.c
+// Sharded probe queues with work stealing
+//
+// Copyright (C) 2010 Ricardo Gameiro
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+
+
+// note that this is built into both the kernel extension and the controller
+// so it must stick to the atomic operations both of them have
+
+#include <sys/types.h>
+#include <sys/atomic_op.h>
+
+#include "shard.h"
+
+// fields packed in a queue's pos
+#define SHARD_GEN( pos )   ( (unsigned long)( pos ) >> 32 )
+#define SHARD_TAIL( pos )  ( (int)( ( ( pos ) >> 16 ) & 0xffff ) )
+#define SHARD_HEAD( pos )  ( (int)( ( pos ) & 0xffff ) )
+
+
+// empty a queue, moving it to the next generation
+int shard_withdraw( struct shard_queue * q ) {
+
+    long old, new;
+
+    old = q->pos;
+    do {
+        new = (long)( ( SHARD_GEN( old ) + 1 ) << 32 );
+    } while( !compare_and_swaplp( (atomic_l)&q->pos, &old, new ) );
+
+    return( SHARD_TAIL( old ) - SHARD_HEAD( old ) );
+}
+
+
+// make the items available, only the publisher changes an empty queue, so
+// a plain store does once the items themselves are visible
+void shard_publish( struct shard_queue * q, int n ) {
+
+    if( n > SHARD_ITEMS_MAX )
+        n = SHARD_ITEMS_MAX;
+
+    __lwsync();
+    q->pos = q->pos + ( (long)n << 16 );
+}
+
+
+// claim the item at the head, a failed claim means someone else took it or
+// the queue moved on, in which case old was refreshed and we try again
+int shard_take( struct shard_queue * q ) {
+
+    int item;
+    long old;
+
+    old = q->pos;
+    __lwsync();
+    while( SHARD_HEAD( old ) < SHARD_TAIL( old ) ) {
+        item = q->item[ SHARD_HEAD( old ) ];
+        if( compare_and_swaplp( (atomic_l)&q->pos, &old, old + 1 ) )
+            return( item );
+        __lwsync();
+    }
+
+    return( -1 );
+}
+
+
+// own queue first, then steal from whoever has the most items left
+int shard_next( struct shard_queue * queue, int workers, int self,
+                int * stolen ) {
+
+    int w, n, item, most, busiest;
+    long pos;
+
+    *stolen = 0;
+    if( ( item = shard_take( &queue[ self ] ) ) >= 0 )
+        return( item );
+
+    for( ;; ) {
+
+        most = 0;
+        busiest = -1;
+        for( w = 0; w < workers; w++ ) {
+            pos = queue[ w ].pos;
+            n = SHARD_TAIL( pos ) - SHARD_HEAD( pos );
+            if( ( w != self ) && ( n > most ) ) {
+                most = n;
+                busiest = w;
+            }
+        }
+        if( busiest < 0 )
+            return( -1 );
+
+        // it may have been emptied since, look again if so
+        if( ( item = shard_take( &queue[ busiest ] ) ) >= 0 ) {
+            *stolen = 1;
+            return( item );
+        }
+    }
+}
@@ -0,0 +1,66 @@
+// shard.h
+// Sharded probe queues with work stealing
+//
+// Copyright (C) 2010 Ricardo Gameiro
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+
+
+#ifndef SHARD_H
+#define SHARD_H
+
+#include <sys/types.h>
+
+// max number of workers, each owning a queue
+#define SHARD_WORKERS_MAX  16
+// max number of items queued at once in a queue (must fit in 16 bits)
+#define SHARD_ITEMS_MAX    10240
+
+// a worker's queue of due items (targets), filled by a single publisher and
+// taken from by its owner and, once they run out of their own, by the other
+// workers, pos packs the queue's generation (upper 32 bits), tail and head
+// (16 bits each), so that a taker only claims an item with a compare and
+// swap of pos, which fails if the queue was withdrawn and published again
+// meanwhile (i.e. the item it read may be a stale one)
+struct shard_queue {
+    volatile long pos;                   // generation, tail and head
+    int16_t item[ SHARD_ITEMS_MAX ];     // items, from head to tail
+};
+
+// empty a queue, returns the number of items withdrawn (never taken), its
+// items may be filled in for shard_publish() once this returned
+int shard_withdraw( struct shard_queue * q );
+
+// make the first n items filled in since shard_withdraw() available
+void shard_publish( struct shard_queue * q, int n );
+
+// take the next item of a queue, returns it or -1 if the queue is empty
+int shard_take( struct shard_queue * q );
+
+// take the next item of worker self, from its own queue or else from the
+// busiest of the other workers' queues (setting *stolen), returns it or -1
+// if every queue is empty
+int shard_next( struct shard_queue * queue, int workers, int self,
+                int * stolen );
+
+// worker owning an item, items are sharded round robin
+#define shard_owner( item, workers ) ( ( item ) % ( workers ) )
+
+
+#endif // ifndef SHARD_H
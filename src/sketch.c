@@ -0,0 +1,116 @@
+// sketch.c
+// Bounded memory, mergeable latency sketches
+//
+// Copyright (C) 2010 Ricardo Gameiro
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+
+// note that this is built into both the kernel extension and the controller
+// so it must stick to plain integer arithmetic
+
+#include <sys/types.h>
+
+#include "sketch.h"
+
+
+// bin holding a latency of 'us' microseconds
+int sketch_bin( uint64_t us ) {
+
+    int octave = 0;
+
+    if( !us )
+        return( 0 );
+
+    // the power of two just below us
+    while( ( octave < SKETCH_OCTAVES ) && ( us >> ( octave + 1 ) ) )
+        octave++;
+    if( octave >= SKETCH_OCTAVES )
+        return( SKETCH_BINS - 1 );
+
+    // the two bits following the leading one select the bin in the octave
+    if( octave >= 2 )
+        return( octave * SKETCH_SUB + (int)( ( us >> ( octave - 2 ) ) & 3 ) );
+    return( octave * SKETCH_SUB + (int)( ( us << ( 2 - octave ) ) & 3 ) );
+}
+
+
+// midpoint, in ns, of a bin's range
+uint64_t sketch_value( int bin ) {
+
+    int octave = bin / SKETCH_SUB, sub = bin % SKETCH_SUB;
+    uint64_t low, width;
+
+    low = ( (uint64_t)( SKETCH_SUB + sub ) << octave ) / SKETCH_SUB;
+    width = ( (uint64_t)1 << octave ) / SKETCH_SUB;
+    return( ( low * 1000 ) + ( width * 1000 / 2 ) );
+}
+
+
+// empty a sketch
+void sketch_clear( struct sketch * s ) {
+
+    int b;
+
+    s->count = 0;
+    for( b = 0; b < SKETCH_BINS; b++ )
+        s->bin[ b ] = 0;
+}
+
+
+// add a latency, in ns, to a sketch
+void sketch_add( struct sketch * s, uint64_t ns ) {
+
+    s->bin[ sketch_bin( ns / 1000 ) ]++;
+    s->count++;
+}
+
+
+// merge the src sketch into dst
+void sketch_merge( struct sketch * dst, struct sketch * src ) {
+
+    int b;
+
+    for( b = 0; b < SKETCH_BINS; b++ )
+        dst->bin[ b ] += src->bin[ b ];
+    dst->count += src->count;
+}
+
+
+// the latency, in ns, at the given quantile (in 1/1000), 0 for an empty
+// sketch
+uint64_t sketch_quantile( struct sketch * s, int permille ) {
+
+    int b;
+    uint64_t rank, seen = 0;
+
+    if( !s->count )
+        return( 0 );
+
+    // the rank (1 based) of the value we're looking for
+    rank = ( (uint64_t)s->count * permille + 999 ) / 1000;
+    if( !rank )
+        rank = 1;
+
+    for( b = 0; b < SKETCH_BINS; b++ ) {
+        seen += s->bin[ b ];
+        if( seen >= rank )
+            return( sketch_value( b ) );
+    }
+    return( sketch_value( SKETCH_BINS - 1 ) );
+}
@@ -0,0 +1,57 @@
+// sketch.h
+// Bounded memory, mergeable latency sketches
+//
+// Copyright (C) 2010 Ricardo Gameiro
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+
+#ifndef SKETCH_H
+#define SKETCH_H
+
+#include <sys/types.h>
+
+// a sketch is a log-linear histogram of latencies, with SKETCH_SUB bins per
+// power of two microseconds, from 1 us up to 2^SKETCH_OCTAVES us (about 16 s,
+// longer latencies go into the last bin), each bin spans at most 1/4 of its
+// lower bound, so quantiles are within 12.5% of the real value
+#define SKETCH_SUB      4
+#define SKETCH_OCTAVES  24
+#define SKETCH_BINS     ( SKETCH_SUB * SKETCH_OCTAVES )
+
+// the sketch itself, fixed size and merged by adding up the bins
+struct sketch {
+    uint32_t count;                      // num of values added
+    uint32_t bin[ SKETCH_BINS ];         // num of values per bin
+};
+
+// empty a sketch
+void sketch_clear( struct sketch * s );
+
+// add a latency, in ns, to a sketch
+void sketch_add( struct sketch * s, uint64_t ns );
+
+// merge the src sketch into dst
+void sketch_merge( struct sketch * dst, struct sketch * src );
+
+// the latency, in ns, at the given quantile (in 1/1000, e.g. 990 for the
+// 99th percentile), 0 for an empty sketch
+uint64_t sketch_quantile( struct sketch * s, int permille );
+
+
+#endif // ifndef SKETCH_H